@@ -18,11 +18,15 @@
  */
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
 #include <pthread.h>
 
 #define LOG_TAG "RIL"
 #include <utils/Log.h>
 
+#include <telephony/librilutils.h>
+
 #include <samsung-ril.h>
 
 struct ril_client *ril_client_find_id(int id)
@@ -213,6 +217,43 @@ int ril_client_loop(struct ril_client *client)
 	return 0;
 }
 
+int ril_client_start(struct ril_client *client)
+{
+	uint64_t start;
+	int failures = 0;
+	int rc;
+
+	if (client == NULL)
+		return -1;
+
+	start = ril_nano_time();
+
+	do {
+		rc = ril_client_open(client);
+		if (rc < 0) {
+			failures++;
+			usleep(RIL_CLIENT_RETRY_DELAY);
+		}
+	} while (rc < 0 && failures < RIL_CLIENT_RETRY_COUNT);
+
+	if (rc < 0)
+		return -1;
+
+	rc = ril_client_loop(client);
+	if (rc < 0)
+		return -1;
+
+	RIL_LOGD("Started %s client in %llu ms", client->name,
+		(unsigned long long) (ril_nano_time() - start) / 1000000);
+
+	return 0;
+}
+
+void *ril_client_start_thread(void *data)
+{
+	return (void *) (intptr_t) ril_client_start((struct ril_client *) data);
+}
+
 int ril_client_request_register(struct ril_client *client, int request,
 	RIL_Token token)
 {
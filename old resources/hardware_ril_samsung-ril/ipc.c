@@ -23,7 +23,7 @@
 
 #define LOG_TAG "RIL-IPC"
 #include <utils/Log.h>
-#include <hardware_legacy/power.h>
+#include <telephony/librilutils.h>
 
 #include <samsung-ril.h>
 #include <utils.h>
@@ -62,7 +62,7 @@ int ipc_fmt_send(unsigned char mseq, unsigned short command, unsigned char type,
 	}
 
 	RIL_CLIENT_LOCK(client);
-	acquire_wake_lock(PARTIAL_WAKE_LOCK, RIL_VERSION_STRING);
+	ril_wake_lock_acquire();
 
 	rc = ipc_client_send(ipc_fmt_data->ipc_client, mseq, command, type, data, size);
 	if (rc < 0) {
@@ -79,7 +79,7 @@ error:
 	rc = -1;
 
 complete:
-	release_wake_lock(RIL_VERSION_STRING);
+	ril_wake_lock_release();
 	RIL_CLIENT_UNLOCK(client);
 
 	return rc;
@@ -448,24 +448,29 @@ int ipc_fmt_loop(struct ril_client *client)
 
 		RIL_LOCK();
 		RIL_CLIENT_LOCK(client);
-		acquire_wake_lock(PARTIAL_WAKE_LOCK, RIL_VERSION_STRING);
+		ril_wake_lock_acquire();
 
 		rc = ipc_client_recv(data->ipc_client, &message);
 		if (rc < 0) {
 			RIL_LOGE("Receiving from %s client failed", client->name);
 
-			release_wake_lock(RIL_VERSION_STRING);
+			ril_wake_lock_release();
 			RIL_CLIENT_UNLOCK(client);
 			RIL_UNLOCK();
 
 			goto error;
 		}
 
-		release_wake_lock(RIL_VERSION_STRING);
 		RIL_CLIENT_UNLOCK(client);
 		RIL_UNLOCK();
 
+		/*
+		 * Keep the reference through dispatch: unsolicited responses
+		 * sent from it extend libril's wake deadline, so a burst of
+		 * messages does not take and drop the kernel lock per message.
+		 */
 		rc = ipc_fmt_dispatch(client, &message);
+		ril_wake_lock_release();
 		if (rc < 0) {
 			RIL_LOGE("Dispatching %s message failed", client->name);
 
@@ -731,7 +736,7 @@ int ipc_rfs_send(unsigned char mseq, unsigned short command, const void *data,
 	}
 
 	RIL_CLIENT_LOCK(client);
-	acquire_wake_lock(PARTIAL_WAKE_LOCK, RIL_VERSION_STRING);
+	ril_wake_lock_acquire();
 
 	rc = ipc_client_send(ipc_rfs_data->ipc_client, mseq, command, 0x00, data, size);
 	if (rc < 0) {
@@ -748,7 +753,7 @@ error:
 	rc = -1;
 
 complete:
-	release_wake_lock(RIL_VERSION_STRING);
+	ril_wake_lock_release();
 	RIL_CLIENT_UNLOCK(client);
 
 	return rc;
@@ -1037,24 +1042,29 @@ int ipc_rfs_loop(struct ril_client *client)
 
 		RIL_LOCK();
 		RIL_CLIENT_LOCK(client);
-		acquire_wake_lock(PARTIAL_WAKE_LOCK, RIL_VERSION_STRING);
+		ril_wake_lock_acquire();
 
 		rc = ipc_client_recv(data->ipc_client, &message);
 		if (rc < 0) {
 			RIL_LOGE("Receiving from %s client failed", client->name);
 
-			release_wake_lock(RIL_VERSION_STRING);
+			ril_wake_lock_release();
 			RIL_CLIENT_UNLOCK(client);
 			RIL_UNLOCK();
 
 			return -1;
 		}
 
-		release_wake_lock(RIL_VERSION_STRING);
 		RIL_CLIENT_UNLOCK(client);
 		RIL_UNLOCK();
 
+		/*
+		 * Keep the reference through dispatch: unsolicited responses
+		 * sent from it extend libril's wake deadline, so a burst of
+		 * messages does not take and drop the kernel lock per message.
+		 */
 		rc = ipc_rfs_dispatch(client, &message);
+		ril_wake_lock_release();
 		if (rc < 0) {
 			RIL_LOGE("Dispatching %s message failed", client->name);
 
@@ -19,11 +19,13 @@
  */
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <ctype.h>
 
 #define LOG_TAG "RIL"
 #include <utils/Log.h>
 #include <telephony/ril.h>
+#include <telephony/librilutils.h>
 
 #include <samsung-ril.h>
 #include <utils.h>
@@ -1462,13 +1464,17 @@ const RIL_RadioFunctions *RIL_Init(const struct RIL_Env *env, int argc,
 {
 	RIL_RadioFunctions *radio_functions;
 	pthread_attr_t attr;
-	int failures;
+	uint64_t start;
+	void *result;
+	int failed = 0;
 	unsigned int i;
 	int rc;
 
 	if (env == NULL)
 		return NULL;
 
+	start = ril_nano_time();
+
 	rc = ril_data_create();
 	if (rc < 0) {
 		RIL_LOGE("Creating RIL data failed");
@@ -1488,28 +1494,43 @@ const RIL_RadioFunctions *RIL_Init(const struct RIL_Env *env, int argc,
 			goto error;
 	}
 
+	/*
+	 * Independent clients start in their own thread while the others
+	 * start in order, since each of those may need the modem booted by
+	 * the one before.
+	 */
 	for (i = 0; i < ril_clients_count; i++) {
-		if (ril_clients[i] == NULL)
+		if (ril_clients[i] == NULL || !ril_clients[i]->independent)
 			continue;
 
-		failures = 0;
+		rc = pthread_create(&ril_clients[i]->start_thread, NULL, ril_client_start_thread, (void *) ril_clients[i]);
+		if (rc != 0) {
+			RIL_LOGE("Starting %s client thread failed", ril_clients[i]->name);
+			ril_clients[i]->independent = 0;
+		}
+	}
 
-		do {
-			rc = ril_client_open(ril_clients[i]);
-			if (rc < 0) {
-				failures++;
-				usleep(RIL_CLIENT_RETRY_DELAY);
-			}
-		} while (rc < 0 && failures < RIL_CLIENT_RETRY_COUNT);
+	for (i = 0; i < ril_clients_count && !failed; i++) {
+		if (ril_clients[i] == NULL || ril_clients[i]->independent)
+			continue;
 
+		rc = ril_client_start(ril_clients[i]);
 		if (rc < 0)
-			goto error;
+			failed = 1;
+	}
 
-		rc = ril_client_loop(ril_clients[i]);
-		if (rc < 0)
-			goto error;
+	for (i = 0; i < ril_clients_count; i++) {
+		if (ril_clients[i] == NULL || !ril_clients[i]->independent)
+			continue;
+
+		pthread_join(ril_clients[i]->start_thread, &result);
+		if ((intptr_t) result < 0)
+			failed = 1;
 	}
 
+	if (failed)
+		goto error;
+
 	pthread_attr_init(&attr);
 	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
 
@@ -1519,6 +1540,8 @@ const RIL_RadioFunctions *RIL_Init(const struct RIL_Env *env, int argc,
 		goto error;
 	}
 
+	RIL_LOGD("Initialized in %llu ms", (unsigned long long) (ril_nano_time() - start) / 1000000);
+
 	radio_functions = &ril_radio_functions;
 	goto complete;
 
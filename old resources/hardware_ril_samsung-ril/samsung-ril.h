@@ -110,7 +110,11 @@ struct ril_client {
 	int available;
 	void *data;
 
+	/* Opened alongside the other clients, without RIL_LOCK */
+	int independent;
+
 	pthread_t thread;
+	pthread_t start_thread;
 	pthread_mutex_t mutex;
 };
 
@@ -130,6 +134,8 @@ int ril_client_destroy(struct ril_client *client);
 int ril_client_open(struct ril_client *client);
 int ril_client_close(struct ril_client *client);
 int ril_client_loop(struct ril_client *client);
+int ril_client_start(struct ril_client *client);
+void *ril_client_start_thread(void *data);
 int ril_client_request_register(struct ril_client *client, int request,
 	RIL_Token token);
 int ril_client_request_unregister(struct ril_client *client, int request,
@@ -33,7 +33,7 @@
 
 #define LOG_TAG "RIL-SRS"
 #include <utils/Log.h>
-#include <hardware_legacy/power.h>
+#include <telephony/librilutils.h>
 
 #include <samsung-ril.h>
 #include <utils.h>
@@ -151,18 +151,20 @@ int srs_send(unsigned short command, const void *data, size_t size)
 	message.data = (void *) data;
 	message.size = size;
 
-	acquire_wake_lock(PARTIAL_WAKE_LOCK, RIL_VERSION_STRING);
+	ril_wake_lock_acquire();
 
 	rc = srs_client_send(ril_client, &message);
 	if (rc < 0) {
 		RIL_LOGE("Sending to %s client failed", ril_client->name);
 
-		release_wake_lock(RIL_VERSION_STRING);
+		ril_wake_lock_release();
 
 		eventfd_send(srs_data->event_fd, SRS_CLIENT_IO_ERROR);
 		return -1;
 	}
 
+	ril_wake_lock_release();
+
 	return 0;
 }
 
@@ -1104,13 +1106,13 @@ int srs_loop(struct ril_client *ril_client)
 			memset(&message, 0, sizeof(message));
 
 			RIL_LOCK();
-			acquire_wake_lock(PARTIAL_WAKE_LOCK, RIL_VERSION_STRING);
+			ril_wake_lock_acquire();
 
 			rc = srs_client_recv(ril_client, &message);
 			if (rc < 0) {
 				RIL_LOGE("Receiving from %s client failed", ril_client->name);
 
-				release_wake_lock(RIL_VERSION_STRING);
+				ril_wake_lock_release();
 				RIL_UNLOCK();
 
 				if (client->fd >= 0)
@@ -1125,6 +1127,7 @@ int srs_loop(struct ril_client *ril_client)
 			RIL_UNLOCK();
 
 			rc = srs_dispatch(ril_client, &message);
+			ril_wake_lock_release();
 			if (rc < 0) {
 				RIL_LOGE("Dispatching %s message failed", ril_client->name);
 
@@ -1174,4 +1177,5 @@ struct ril_client srs_client = {
 	.name = "SRS",
 	.handlers = &srs_handlers,
 	.callbacks = &srs_callbacks,
+	.independent = 1,
 };
@@ -31,6 +31,42 @@ extern "C" {
  */
 uint64_t ril_nano_time();
 
+#define RIL_WAKE_LOCK_NAME "radio-interface"
+
+struct ril_wake_lock_stats {
+    uint32_t refs;          // references held now
+    uint32_t maxRefs;
+    uint32_t acquisitions;  // times the kernel lock was taken
+    uint32_t references;    // ril_wake_lock_acquire() calls
+    uint32_t holds;         // ril_wake_lock_hold() calls
+    uint64_t heldNs;        // total time the kernel lock was held
+    uint64_t maxHeldNs;
+};
+
+/**
+ * Reference counted partial wake lock shared by libril and the vendor
+ * RIL. The kernel wake lock is only acquired and released when the
+ * count moves between 0 and 1.
+ */
+void ril_wake_lock_acquire(void);
+void ril_wake_lock_release(void);
+
+/**
+ * Keep the wake lock held for at least ms from now, extending the
+ * pending deadline if there is one. Returns 1 when no deadline was
+ * pending, in which case the caller must arrange for
+ * ril_wake_lock_expire() to run when ms have passed.
+ */
+int ril_wake_lock_hold(uint32_t ms);
+
+/**
+ * Release the deadline's reference if it has passed. Otherwise returns
+ * the nanoseconds left, after which it must be called again.
+ */
+uint64_t ril_wake_lock_expire(void);
+
+void ril_wake_lock_get_stats(struct ril_wake_lock_stats *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -4651,6 +4651,7 @@ typedef struct {
 #define RIL_UNSOL_DC_RT_INFO_CHANGED 1041
 
 /* SAMSUNG RESPONSE */
+#define SAMSUNG_REQUEST_BASE 10000
 #define SAMSUNG_UNSOL_RESPONSE_BASE 11000
 
 #define RIL_REQUEST_SET_CELL_BROADCAST_CONFIG 10001
@@ -4838,8 +4839,9 @@ struct RIL_Env {
     void (*OnUnsolicitedResponse)(int unsolResponse, const void *data, size_t datalen);
 #endif
     /**
-     * Call user-specifed "callback" function on on the same thread that
-     * RIL_RequestFunc is called. If "relativeTime" is specified, then it specifies
+     * Call user-specifed "callback" function, never at the same time as
+     * RIL_RequestFunc unless libril is built with BOARD_RIL_CONCURRENT_DISPATCH
+     * or BOARD_RIL_REQUEST_WORKERS. If "relativeTime" is specified, then it specifies
      * a relative time value at which the callback is invoked. If relativeTime is
      * NULL or points to a 0-filled structure, the callback will be invoked as
      * soon as possible
@@ -4910,8 +4912,9 @@ void RIL_onUnsolicitedResponse(int unsolResponse, const void *data,
 #endif
 
 /**
- * Call user-specifed "callback" function on on the same thread that
- * RIL_RequestFunc is called. If "relativeTime" is specified, then it specifies
+ * Call user-specifed "callback" function, never at the same time as
+ * RIL_RequestFunc unless libril is built with BOARD_RIL_CONCURRENT_DISPATCH
+ * or BOARD_RIL_REQUEST_WORKERS. If "relativeTime" is specified, then it specifies
  * a relative time value at which the callback is invoked. If relativeTime is
  * NULL or points to a 0-filled structure, the callback will be invoked as
  * soon as possible
@@ -7,7 +7,10 @@ include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES:= \
     ril.cpp \
-    ril_event.cpp
+    ril_event.cpp \
+    ril_pool.cpp \
+    ril_trace.cpp \
+    ril_histogram.cpp
 
 LOCAL_SHARED_LIBRARIES := \
     liblog \
@@ -29,6 +32,30 @@ ifeq ($(BOARD_USES_LEGACY_RIL),true)
 LOCAL_CFLAGS += -DLEGACY_RIL
 endif
 
+# ril_event backend: epoll unless the board asks for the legacy select() loop
+ifneq ($(BOARD_RIL_EVENT_USES_SELECT),true)
+LOCAL_CFLAGS += -DRIL_EVENT_USE_EPOLL
+ifeq ($(BOARD_RIL_EVENT_EPOLL_EDGE_TRIGGERED),true)
+LOCAL_CFLAGS += -DRIL_EVENT_EPOLL_EDGE_TRIGGERED
+endif
+endif
+
+# Run requests on a pool of this many workers; the vendor onRequest must be reentrant
+ifneq ($(BOARD_RIL_REQUEST_WORKERS),)
+LOCAL_CFLAGS += -DRIL_REQUEST_WORKERS=$(BOARD_RIL_REQUEST_WORKERS)
+endif
+
+# Let onRequest run on each socket's dispatch thread while timed callbacks run;
+# the vendor RIL must lock its own state
+ifeq ($(BOARD_RIL_CONCURRENT_DISPATCH),true)
+LOCAL_CFLAGS += -DRIL_CONCURRENT_DISPATCH
+endif
+
+# Fail and cancel requests the vendor RIL has not completed after this many ms
+ifneq ($(BOARD_RIL_REQUEST_DEADLINE_MS),)
+LOCAL_CFLAGS += -DRIL_REQUEST_DEADLINE_MS=$(BOARD_RIL_REQUEST_DEADLINE_MS)
+endif
+
 include $(BUILD_SHARED_LIBRARY)
 
 
@@ -38,7 +65,10 @@ ifneq ($(ANDROID_BIONIC_TRANSITION),)
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES:= \
-    ril.cpp
+    ril.cpp \
+    ril_pool.cpp \
+    ril_trace.cpp \
+    ril_histogram.cpp
 
 LOCAL_STATIC_LIBRARIES := \
     libutils_static \
@@ -17,13 +17,12 @@
 
 #define LOG_TAG "RILC"
 
-#include <hardware_legacy/power.h>
-
 #include <telephony/ril.h>
 #include <telephony/ril_cdma_sms.h>
 #include <cutils/sockets.h>
 #include <cutils/jstring.h>
 #include <telephony/record_stream.h>
+#include <telephony/librilutils.h>
 #include <utils/Log.h>
 #include <utils/SystemClock.h>
 #include <pthread.h>
@@ -46,11 +45,15 @@
 #include <ctype.h>
 #include <alloca.h>
 #include <sys/un.h>
+#include <sys/uio.h>
 #include <assert.h>
 #include <netinet/in.h>
 #include <cutils/properties.h>
 
 #include <ril_event.h>
+#include <ril_pool.h>
+#include <ril_trace.h>
+#include <ril_histogram.h>
 
 namespace android {
 
@@ -63,14 +66,59 @@ namespace android {
 
 #define SOCKET_NAME_RIL_DEBUG "rild-debug"
 
-#define ANDROID_WAKE_LOCK_NAME "radio-interface"
-
 
 #define PROPERTY_RIL_IMPL "gsm.version.ril-impl"
 
+// "ssss", "dsds", "dsda" or "tsts"; sockets beyond SIM_COUNT are never served
+#define PROPERTY_MULTISIM_CONFIG "persist.radio.multisim.config"
+
 // match with constant in RIL.java
 #define MAX_COMMAND_BYTES (8 * 1024)
 
+// Decoded request strings live in a per-request arena. UTF-8 needs at
+// most 3 bytes per UTF-16 unit and every string costs at least a 4 byte
+// length plus a 2 byte terminator in the Parcel, so 3/2 of the largest
+// record always fits.
+#define STRING_ARENA_BYTES (MAX_COMMAND_BYTES * 3 / 2)
+
+// Responses queued for a slow reader beyond this are dropped
+#define OUT_QUEUE_MAX_BYTES (256 * 1024)
+// Max queued records flushed per writev()
+#define OUT_QUEUE_MAX_IOV 32
+// Unsolicited responses kept for replay while no client is connected
+#define REPLAY_MAX_BYTES (64 * 1024)
+
+// Reading a command socket pauses while this much waits for its dispatch thread
+#define COMMAND_QUEUE_MAX_BYTES (8 * MAX_COMMAND_BYTES)
+
+// Threads calling onRequest concurrently; 0 calls it from the socket's own
+// dispatch thread. Only for vendor RILs whose onRequest is reentrant.
+#ifndef RIL_REQUEST_WORKERS
+#define RIL_REQUEST_WORKERS 0
+#endif
+
+// Unless the board opts in, onRequest, onCancel and RIL_requestTimedCallback
+// callbacks never overlap, as when they all ran on the event loop
+#if RIL_REQUEST_WORKERS == 0 && !defined(RIL_CONCURRENT_DISPATCH)
+#define RIL_SERIALIZE_VENDOR 1
+#endif
+
+// A request the vendor RIL has not completed this long after onRequest is
+// failed and cancelled; 0 disables deadlines. Network scans get at least
+// NETWORK_REQUEST_DEADLINE_MS.
+#ifndef RIL_REQUEST_DEADLINE_MS
+#define RIL_REQUEST_DEADLINE_MS 0
+#endif
+#define NETWORK_REQUEST_DEADLINE_MS (180 * 1000)
+
+// Response Parcels kept for reuse, and the largest buffer worth keeping
+#define PARCEL_POOL_SIZE 8
+#define PARCEL_POOL_MAX_CAPACITY MAX_COMMAND_BYTES
+
+// Preallocated control blocks; bursts beyond these fall back to the heap
+#define REQUEST_POOL_SIZE 64
+#define USER_CALLBACK_POOL_SIZE 32
+
 // Basically: memset buffers that the client library
 // shouldn't be using anymore in an attempt to find
 // memory usage issues sooner.
@@ -79,6 +127,7 @@ namespace android {
 #define NUM_ELEMS(a)     (sizeof (a) / sizeof (a)[0])
 
 #define MIN(a,b) ((a)<(b) ? (a) : (b))
+#define MAX(a,b) ((a)>(b) ? (a) : (b))
 
 /* Constants for response types */
 #define RESPONSE_SOLICITED 0
@@ -118,32 +167,167 @@ namespace android {
     #define appendPrintBuf(x...)
 #endif
 
-#define MAX_RIL_SOL     RIL_REQUEST_SET_UNSOL_CELL_INFO_LIST_RATE
-#define MAX_RIL_UNSOL   RIL_UNSOL_CELL_INFO_LIST
+// Last entry of ril_commands.h, ril_unsol_commands.h and the Samsung tables
+#define MAX_RIL_SOL         RIL_REQUEST_SHUTDOWN
+#define MAX_RIL_UNSOL       RIL_UNSOL_DC_RT_INFO_CHANGED
+#define MAX_SAMSUNG_SOL     RIL_REQUEST_HANGUP_VT
+#define MAX_SAMSUNG_UNSOL   RIL_UNSOL_HSDPA_STATE_CHANGED
 
 enum WakeType {DONT_WAKE, WAKE_PARTIAL};
 
+/**
+ * What happens to an unsolicited response the client cannot take yet:
+ *
+ * DONT_KEEP      queued for a slow reader, dropped while disconnected
+ * KEEP_LATEST    a newer copy replaces one still queued for a slow reader
+ * REPLAY_LATEST  as KEEP_LATEST, and the latest copy is kept while
+ *                disconnected and sent on the next connection
+ * REPLAY_ALL     every copy is kept while disconnected, up to
+ *                REPLAY_MAX_BYTES, and sent on the next connection
+ */
+enum UnsolPolicy {DONT_KEEP, KEEP_LATEST, REPLAY_LATEST, REPLAY_ALL};
+
+/**
+ * COLLAPSE marks read-only requests with no side effects. One that arrives
+ * while an identical one (same code and arguments) is in flight on the same
+ * socket is not passed to the vendor RIL; it gets a copy of that response.
+ */
+enum CollapsePolicy {DONT_COLLAPSE, COLLAPSE};
+
 typedef struct {
     int requestNumber;
     void (*dispatchFunction) (Parcel &p, struct RequestInfo *pRI);
     int(*responseFunction) (Parcel &p, void *response, size_t responselen);
+    CollapsePolicy collapse;
 } CommandInfo;
 
 typedef struct {
     int requestNumber;
     int (*responseFunction) (Parcel &p, void *response, size_t responselen);
     WakeType wakeType;
+    UnsolPolicy policy;
 } UnsolResponseInfo;
 
+typedef struct StringArena {
+    char *buf;
+    size_t size;
+    size_t used;
+    void *overflow;     // heap blocks for strings that did not fit, linked
+} StringArena;
+
 typedef struct RequestInfo {
     int32_t token;      //this is not RIL_Token
     CommandInfo *pCI;
-    struct RequestInfo *p_next;
+    StringArena *arena; // valid until the dispatch function calls onRequest
+    uint32_t handle;    // RIL_Token handed to the vendor RIL, see PendingRequests
+    uint64_t startNs;   // ril_nano_time() when the request was read
+    uint64_t dispatchNs; // ril_nano_time() when it was handed to onRequest
+    uint32_t cacheGeneration; // of its response cache entry when it missed
+    uint32_t connection; // of the client that sent it, see OutQueue
+    struct ril_event deadline_event; // armed by dispatchToken(), func NULL if not
     char cancelled;
     char local;         // responses to local commands do not go back to command process
+    char collapsible;   // on PendingRequests.collapsible, others may collapse into it
     RIL_SOCKET_ID socket_id;
+    // Collapsed requests: the next on the collapsible list for an in-flight
+    // request, or the next follower for one waiting on it
+    struct RequestInfo *p_next;
+    struct RequestInfo *followers;
+    uint8_t *args;      // request arguments of a collapsible request
+    size_t argsLen;
 } RequestInfo;
 
+/**
+ * Outstanding requests of one socket, indexed by slot.
+ *
+ * The RIL_Token given to the vendor RIL is not the RequestInfo pointer but
+ * a handle packing the socket, the slot and the slot's generation:
+ *
+ *   bits 31..28 socket id, 27..16 generation, 15..0 slot
+ *
+ * so RIL_onRequestComplete() validates and removes a token in O(1). The
+ * generation is bumped each time a slot is released, which rejects stale
+ * or duplicate completions, and never wraps to 0 so a handle is never NULL.
+ */
+#define PENDING_SLOT_BITS       16
+#define PENDING_GEN_BITS        12
+#define PENDING_SLOT_MASK       ((1 << PENDING_SLOT_BITS) - 1)
+#define PENDING_GEN_MASK        ((1 << PENDING_GEN_BITS) - 1)
+#define PENDING_SOCKET_SHIFT    (PENDING_SLOT_BITS + PENDING_GEN_BITS)
+#define PENDING_NO_SLOT         PENDING_SLOT_MASK
+#define PENDING_INITIAL_SIZE    32
+
+typedef struct PendingSlot {
+    RequestInfo *pRI;   // NULL when free
+    uint16_t generation;
+    uint16_t nextFree;
+    uint16_t expired;   // generation of the last handle to miss its deadline, 0 if none
+} PendingSlot;
+
+typedef struct PendingRequests {
+    pthread_mutex_t mutex;
+    PendingSlot *slots;
+    uint32_t size;
+    uint32_t freeHead;
+    uint32_t count;     // requests in flight
+    uint32_t highWater;
+    RequestInfo *collapsible; // in flight with COLLAPSE, linked by p_next
+} PendingRequests;
+
+#define PENDING_REQUESTS_INITIALIZER \
+    { PTHREAD_MUTEX_INITIALIZER, NULL, 0, PENDING_NO_SLOT }
+
+/**
+ * Records waiting for a command socket to become writable.
+ *
+ * sendResponseRaw() writes header and payload with one writev() while the
+ * queue is empty. Whatever the socket does not take is copied here and the
+ * event loop watches for writability, then flushes several records per
+ * writev(). fd is a dup() of the command socket so that the epoll backend
+ * can watch it for output alongside the reader's input watch.
+ */
+typedef struct OutRecord {
+    struct OutRecord *p_next;
+    size_t len;         // header + payload
+    size_t offset;      // bytes already written
+    int unsolResponse;  // 0 for a solicited response
+    uint8_t *data;
+} OutRecord;
+
+typedef struct OutQueue {
+    pthread_mutex_t mutex;
+    int fd;             // -1 while no client is connected
+    // bumped when the client disconnects, so a response to a request it
+    // sent never reaches the next client
+    uint32_t connection;
+    OutRecord *head;
+    OutRecord *tail;
+    size_t bytes;
+    size_t highWater;
+    struct ril_event write_event;
+    // unsolicited responses waiting for the next connection, see UnsolPolicy
+    OutRecord *replayHead;
+    OutRecord *replayTail;
+    size_t replayBytes;
+    uint32_t coalesced;
+} OutQueue;
+
+#define OUT_QUEUE_INITIALIZER \
+    { PTHREAD_MUTEX_INITIALIZER, -1, 0, NULL, NULL, 0 }
+
+/**
+ * Per request code: time from onRequest to RIL_onRequestComplete, which is
+ * spent in the vendor RIL and the modem, and the time libril itself spends
+ * decoding the request and marshalling and sending the response.
+ */
+typedef struct RequestStats {
+    struct ril_histogram vendor;
+    uint64_t librilSumUs;
+    uint32_t librilMaxUs;
+    uint32_t deadlineMisses;
+    uint32_t collapsed; // answered with the response of an identical request
+} RequestStats;
+
 typedef struct UserCallbackInfo {
     RIL_TimedCallback p_callback;
     void *userParam;
@@ -151,17 +335,80 @@ typedef struct UserCallbackInfo {
     struct UserCallbackInfo *p_next;
 } UserCallbackInfo;
 
+typedef struct CommandRecord {
+    struct CommandRecord *p_next;
+    size_t len;
+    int32_t request;    // -1 if the record is too short to hold one
+    int priority;       // RequestPriority
+    uint32_t connection; // OutQueue.connection when it was read
+    uint8_t *data;
+} CommandRecord;
+
+/**
+ * One command socket. The event loop accepts the connection and reads
+ * records into the command queue; the socket's own dispatch thread
+ * decodes them and calls onRequest, or hands them to the request workers,
+ * so a request blocking in the vendor RIL holds up neither the event loop
+ * nor the other SIMs. fdCommand,
+ * p_rs and the events belong to the event loop.
+ */
 typedef struct SocketListenParam {
     RIL_SOCKET_ID socket_id;
     int fdListen;
     int fdCommand;
     char* processName;
-    struct ril_event* commands_event;
-    struct ril_event* listen_event;
+    struct ril_event commands_event;
+    struct ril_event listen_event;
     void (*processCommandsCallback)(int fd, short flags, void *param);
     RecordStream *p_rs;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    CommandRecord *head;
+    CommandRecord *tail;
+    size_t bytes;
+    bool paused;        // commands_event removed until the queue drains
+    bool connectPending; // accepted before RIL_register(), see s_registerDone
+    pthread_t tid_dispatch;
 } SocketListenParam;
 
+// Request classes of the worker pool, highest priority first
+enum RequestClass {
+    REQUEST_CLASS_CALL,         // call control and DTMF
+    REQUEST_CLASS_SMS,
+    REQUEST_CLASS_SIM,          // SIM IO, PINs, STK
+    REQUEST_CLASS_DATA,
+    REQUEST_CLASS_OTHER,
+    REQUEST_CLASS_NETWORK,      // network scans and selection, may take minutes
+    REQUEST_CLASS_COUNT
+};
+
+typedef struct RequestQueue {
+    CommandRecord *head;
+    CommandRecord *tail;
+    bool busy;                  // a worker is running a request from it
+} RequestQueue;
+
+/**
+ * Worker pool used when RIL_REQUEST_WORKERS > 0. Socket dispatch threads
+ * sort commands into a queue per socket and request class. A worker takes
+ * the first command of the highest priority queue with nothing running,
+ * so one class runs in order while a 30s network scan leaves the other
+ * classes, and HANGUP, to the remaining workers.
+ */
+typedef struct RequestWorkers {
+    pthread_mutex_t mutex;
+    pthread_cond_t workCond;    // a queue may have become runnable
+    pthread_cond_t spaceCond;   // bytes[] went down
+    RequestQueue queues[SIM_COUNT][REQUEST_CLASS_COUNT];
+    size_t bytes[SIM_COUNT];    // queued, waiting for a worker
+    int count;                  // workers started
+    int busy;
+    int nextSocket;             // round robin between sockets of one class
+    uint32_t started[REQUEST_CLASS_COUNT];
+    uint32_t stalls;            // socket dispatch threads made to wait
+} RequestWorkers;
+
 extern "C" const char * requestToString(int request);
 extern "C" const char * failCauseToString(RIL_Errno);
 extern "C" const char * callStateToString(RIL_CallState);
@@ -175,6 +422,56 @@ char rild[MAX_SOCKET_NAME_LENGTH] = SOCKET_NAME_RIL;
 RIL_RadioFunctions s_callbacks = {0, NULL, NULL, NULL, NULL, NULL};
 static int s_registerCalled = 0;
 
+/**
+ * The command sockets listen from RIL_startEventLoop() on, so the client
+ * can connect while the vendor RIL initializes. Until RIL_register() is
+ * done the dispatch threads hold the commands read and RIL_CONNECTED is
+ * not sent.
+ */
+static pthread_mutex_t s_registerMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_registerCond = PTHREAD_COND_INITIALIZER;
+static bool s_registerDone = false;
+
+// Startup timeline, see RIL_bootPhase()
+#define BOOT_PHASES_MAX 16
+static const char *s_bootPhaseNames[BOOT_PHASES_MAX];
+static uint64_t s_bootPhaseNs[BOOT_PHASES_MAX];
+static uint32_t s_bootPhaseCount;
+static int s_bootFirstConnect;
+static int s_bootFirstRequest;
+static int s_bootFirstConnected;
+
+/**
+ * Record a step of startup, logged with the time since the first one.
+ * phase must be a string constant. rild marks its own steps; libril adds
+ * listening, the first connection and request, RIL_register and the
+ * first RIL_CONNECTED. The debug port prints the timeline with the stats.
+ */
+extern "C" void
+RIL_bootPhase(const char *phase) {
+    uint32_t n = __atomic_fetch_add(&s_bootPhaseCount, 1, __ATOMIC_RELAXED);
+    uint64_t now = ril_nano_time();
+    uint64_t first;
+
+    if (n >= BOOT_PHASES_MAX) {
+        return;
+    }
+    s_bootPhaseNs[n] = now;
+    __atomic_store_n(&s_bootPhaseNames[n], phase, __ATOMIC_RELEASE);
+
+    first = __atomic_load_n(&s_bootPhaseNames[0], __ATOMIC_ACQUIRE) != NULL
+            ? s_bootPhaseNs[0] : now;
+    RLOGI("boot: %s at +%llums", phase, (unsigned long long)(now - first) / 1000000);
+}
+
+// RIL_bootPhase() the first time only
+static void
+bootPhaseOnce(int *p_done, const char *phase) {
+    if (__atomic_exchange_n(p_done, 1, __ATOMIC_RELAXED) == 0) {
+        RIL_bootPhase(phase);
+    }
+}
+
 static pthread_t s_tid_dispatch;
 static pthread_t s_tid_reader;
 static int s_started = 0;
@@ -185,48 +482,61 @@ static int s_fdDebug_socket2 = -1;
 static int s_fdWakeupRead;
 static int s_fdWakeupWrite;
 
-static struct ril_event s_commands_event;
 static struct ril_event s_wakeupfd_event;
-static struct ril_event s_listen_event;
-static SocketListenParam s_ril_param_socket;
 
-static pthread_mutex_t s_pendingRequestsMutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t s_writeMutex = PTHREAD_MUTEX_INITIALIZER;
-static RequestInfo *s_pendingRequests = NULL;
+// Sockets actually served, set by startCommandSockets(); at most SIM_COUNT
+static int s_simCount = SIM_COUNT;
+static SocketListenParam s_ril_param_socket[SIM_COUNT];
 
-#if (SIM_COUNT >= 2)
-static struct ril_event s_commands_event_socket2;
-static struct ril_event s_listen_event_socket2;
-static SocketListenParam s_ril_param_socket2;
+static RequestWorkers s_requestWorkers = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER
+};
 
-static pthread_mutex_t s_pendingRequestsMutex_socket2  = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t s_writeMutex_socket2            = PTHREAD_MUTEX_INITIALIZER;
-static RequestInfo *s_pendingRequests_socket2          = NULL;
+#ifdef RIL_SERIALIZE_VENDOR
+static pthread_mutex_t s_vendorMutex = PTHREAD_MUTEX_INITIALIZER;
+#define VENDOR_LOCK() pthread_mutex_lock(&s_vendorMutex)
+#define VENDOR_UNLOCK() pthread_mutex_unlock(&s_vendorMutex)
+#else
+#define VENDOR_LOCK()
+#define VENDOR_UNLOCK()
 #endif
 
+static OutQueue s_outQueue[SIM_COUNT] = {
+    OUT_QUEUE_INITIALIZER,
+#if (SIM_COUNT >= 2)
+    OUT_QUEUE_INITIALIZER,
+#endif
 #if (SIM_COUNT >= 3)
-static struct ril_event s_commands_event_socket3;
-static struct ril_event s_listen_event_socket3;
-static SocketListenParam s_ril_param_socket3;
-
-static pthread_mutex_t s_pendingRequestsMutex_socket3  = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t s_writeMutex_socket3            = PTHREAD_MUTEX_INITIALIZER;
-static RequestInfo *s_pendingRequests_socket3          = NULL;
+    OUT_QUEUE_INITIALIZER,
 #endif
-
 #if (SIM_COUNT >= 4)
-static struct ril_event s_commands_event_socket4;
-static struct ril_event s_listen_event_socket4;
-static SocketListenParam s_ril_param_socket4;
+    OUT_QUEUE_INITIALIZER,
+#endif
+};
 
-static pthread_mutex_t s_pendingRequestsMutex_socket4  = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t s_writeMutex_socket4            = PTHREAD_MUTEX_INITIALIZER;
-static RequestInfo *s_pendingRequests_socket4          = NULL;
+static PendingRequests s_pendingRequests[SIM_COUNT] = {
+    PENDING_REQUESTS_INITIALIZER,
+#if (SIM_COUNT >= 2)
+    PENDING_REQUESTS_INITIALIZER,
+#endif
+#if (SIM_COUNT >= 3)
+    PENDING_REQUESTS_INITIALIZER,
+#endif
+#if (SIM_COUNT >= 4)
+    PENDING_REQUESTS_INITIALIZER,
 #endif
+};
 
 static struct ril_event s_wake_timeout_event;
 static struct ril_event s_debug_event;
 
+static struct ril_pool s_requestInfoPool;
+static struct ril_pool s_userCallbackPool;
+
+static pthread_mutex_t s_parcelPoolMutex = PTHREAD_MUTEX_INITIALIZER;
+static Parcel *s_parcelPool[PARCEL_POOL_SIZE];
+static int s_parcelPoolCount = 0;
+
 
 static const struct timeval TIMEVAL_WAKE_TIMEOUT = {1,0};
 
@@ -240,17 +550,17 @@ static pthread_cond_t s_dispatchCond = PTHREAD_COND_INITIALIZER;
 static RequestInfo *s_toDispatchHead = NULL;
 static RequestInfo *s_toDispatchTail = NULL;
 
-static UserCallbackInfo *s_last_wake_timeout_info = NULL;
-
-static void *s_lastNITZTimeData = NULL;
-static size_t s_lastNITZTimeDataSize;
 
 #if RILC_LOG
     static char printBuf[PRINTBUF_SIZE];
 #endif
 
 /*******************************************************************/
-static int sendResponse (Parcel &p, RIL_SOCKET_ID socket_id);
+static int sendResponse (Parcel &p, RIL_SOCKET_ID socket_id, uint32_t connection);
+static uint32_t outQueueConnection(RIL_SOCKET_ID socket_id);
+static void rilEventAddWakeup(struct ril_event *ev);
+static void rilTimerAddWakeup(struct ril_event *ev, struct timeval *tv);
+static void requestDeadlineCallback(int fd, short flags, void *param);
 
 static void dispatchVoid (Parcel& p, RequestInfo *pRI);
 static void dispatchString (Parcel& p, RequestInfo *pRI);
@@ -323,25 +633,114 @@ extern "C" void RIL_onUnsolicitedResponse(int unsolResponse, void *data,
 
 #if defined(ANDROID_MULTI_SIM)
 #define RIL_UNSOL_RESPONSE(a, b, c, d) RIL_onUnsolicitedResponse((a), (b), (c), (d))
-#define CALL_ONREQUEST(a, b, c, d, e) s_callbacks.onRequest((a), (b), (c), (d), (e))
+#define CALL_ONREQUEST(a, b, c, d, e) s_callbacks.onRequest((a), (b), (c), dispatchToken(d), (e))
 #define CALL_ONSTATEREQUEST(a) s_callbacks.onStateRequest(a)
 #else
 #define RIL_UNSOL_RESPONSE(a, b, c, d) RIL_onUnsolicitedResponse((a), (b), (c))
-#define CALL_ONREQUEST(a, b, c, d, e) s_callbacks.onRequest((a), (b), (c), (d))
+#define CALL_ONREQUEST(a, b, c, d, e) s_callbacks.onRequest((a), (b), (c), dispatchToken(d))
 #define CALL_ONSTATEREQUEST(a) s_callbacks.onStateRequest()
 #endif
 
-static UserCallbackInfo * internalRequestTimedCallback
+static void internalRequestTimedCallback
     (RIL_TimedCallback callback, void *param,
         const struct timeval *relativeTime);
+static void wakeTimeoutCallback(int fd, short flags, void *param);
 
-/** Index == requestNumber */
+/**
+ * Index == requestNumber for AOSP requests, followed by the Samsung range
+ * starting at SAMSUNG_REQUEST_BASE. Codes without a dispatchFunction
+ * (or responseFunction) are unsupported. See lookupCommand().
+ */
 static CommandInfo s_commands[] = {
 #include "ril_commands.h"
+#include "ril_commands_samsung.h"
 };
 
 static UnsolResponseInfo s_unsolResponses[] = {
 #include "ril_unsol_commands.h"
+#include "ril_unsol_commands_samsung.h"
+};
+
+/**
+ * Recent response sizes per solicited request and unsolicited response,
+ * used to size a Parcel before marshalling so it does not grow by repeated
+ * reallocation. Updated without locking; a lost update only costs a resize.
+ */
+static uint32_t s_solicitedSizeHint[NUM_ELEMS(s_commands)];
+static uint32_t s_unsolSizeHint[NUM_ELEMS(s_unsolResponses)];
+static uint32_t s_otherSizeHint;
+
+static RequestStats s_requestStats[NUM_ELEMS(s_commands)];
+static uint32_t s_unsolCount[NUM_ELEMS(s_unsolResponses)];
+// Snapshot at the previous stats dump, for unsolicited rates
+static uint32_t s_unsolCountAtDump[NUM_ELEMS(s_unsolResponses)];
+static uint64_t s_statsDumpNs;
+
+#define CACHE_MAX_INVALIDATORS 4
+
+/**
+ * Responses libril answers from its cache without calling onRequest. An
+ * entry is kept per socket until one of the codes listed arrives on that
+ * socket, as an unsolicited response or a completed request, or for ttlMs
+ * if that is not 0. Only successful responses are stored. Cached requests
+ * must be COLLAPSE, which keeps their arguments for the cache key.
+ */
+typedef struct CachePolicy {
+    int requestNumber;
+    uint32_t ttlMs;
+    int invalidatedBy[CACHE_MAX_INVALIDATORS];  // 0 terminated
+} CachePolicy;
+
+static const CachePolicy s_cachePolicies[] = {
+    {RIL_REQUEST_GET_IMEI, 0, {RIL_UNSOL_RESPONSE_RADIO_STATE_CHANGED}},
+    {RIL_REQUEST_GET_IMEISV, 0, {RIL_UNSOL_RESPONSE_RADIO_STATE_CHANGED}},
+    {RIL_REQUEST_DEVICE_IDENTITY, 0, {RIL_UNSOL_RESPONSE_RADIO_STATE_CHANGED}},
+    {RIL_REQUEST_BASEBAND_VERSION, 0, {RIL_UNSOL_RESPONSE_RADIO_STATE_CHANGED}},
+    {RIL_REQUEST_GET_IMSI, 0, {RIL_UNSOL_RESPONSE_RADIO_STATE_CHANGED,
+            RIL_UNSOL_RESPONSE_SIM_STATUS_CHANGED, RIL_UNSOL_SIM_REFRESH}},
+    {RIL_REQUEST_OPERATOR, 3000, {RIL_UNSOL_RESPONSE_RADIO_STATE_CHANGED,
+            RIL_UNSOL_RESPONSE_VOICE_NETWORK_STATE_CHANGED}},
+    {RIL_REQUEST_VOICE_REGISTRATION_STATE, 3000, {RIL_UNSOL_RESPONSE_RADIO_STATE_CHANGED,
+            RIL_UNSOL_RESPONSE_VOICE_NETWORK_STATE_CHANGED,
+            RIL_UNSOL_VOICE_RADIO_TECH_CHANGED}},
+    {RIL_REQUEST_DATA_REGISTRATION_STATE, 3000, {RIL_UNSOL_RESPONSE_RADIO_STATE_CHANGED,
+            RIL_UNSOL_RESPONSE_VOICE_NETWORK_STATE_CHANGED}},
+    {RIL_REQUEST_QUERY_NETWORK_SELECTION_MODE, 3000, {RIL_UNSOL_RESPONSE_RADIO_STATE_CHANGED,
+            RIL_UNSOL_RESPONSE_VOICE_NETWORK_STATE_CHANGED,
+            RIL_REQUEST_SET_NETWORK_SELECTION_AUTOMATIC,
+            RIL_REQUEST_SET_NETWORK_SELECTION_MANUAL}},
+};
+
+typedef struct CacheEntry {
+    uint8_t *args;      // key arguments followed by the data, one allocation
+    size_t argsLen;
+    uint8_t *data;      // marshalled error and payload, NULL if empty
+    size_t len;
+    uint64_t storedNs;
+    uint32_t generation; // bumped by each invalidation
+    uint32_t hits;
+    uint32_t misses;
+} CacheEntry;
+
+static pthread_mutex_t s_responseCacheMutex = PTHREAD_MUTEX_INITIALIZER;
+static CacheEntry s_responseCache[SIM_COUNT][NUM_ELEMS(s_cachePolicies)];
+
+/**
+ * Uncached COLLAPSE requests whose in-flight response goes stale when one
+ * of the codes listed arrives on the socket. Their leaders then stop
+ * taking followers, so a request sent after the change gets its own
+ * onRequest. Cached requests use their s_cachePolicies codes instead.
+ */
+typedef struct CollapseInvalidation {
+    int requestNumber;
+    int invalidatedBy[CACHE_MAX_INVALIDATORS];  // 0 terminated
+} CollapseInvalidation;
+
+static const CollapseInvalidation s_collapseInvalidations[] = {
+    {RIL_REQUEST_GET_CURRENT_CALLS, {RIL_UNSOL_RESPONSE_RADIO_STATE_CHANGED,
+            RIL_UNSOL_RESPONSE_CALL_STATE_CHANGED}},
+    {RIL_REQUEST_GET_SIM_STATUS, {RIL_UNSOL_RESPONSE_RADIO_STATE_CHANGED,
+            RIL_UNSOL_RESPONSE_SIM_STATUS_CHANGED, RIL_UNSOL_SIM_REFRESH}},
 };
 
 /* For older RILs that do not support new commands RIL_REQUEST_VOICE_RADIO_TECH and
@@ -373,14 +772,55 @@ void RIL_setRilSocketName(char * s) {
     strncpy(rild, s, MAX_SOCKET_NAME_LENGTH);
 }
 
+/**
+ * Reads a string from the request Parcel into the request's arena, or
+ * into a heap block freed with it should the arena ever run out.
+ * The result stays valid until processCommandBuffer() returns, so the
+ * dispatch functions never free it. Returns NULL for a null string.
+ */
 static char *
-strdupReadString(Parcel &p) {
+readString(Parcel &p, RequestInfo *pRI) {
+    StringArena *arena = pRI->arena;
     size_t stringlen;
+    size_t len8;
     const char16_t *s16;
+    char *s8;
 
     s16 = p.readString16Inplace(&stringlen);
+    if (s16 == NULL) {
+        return NULL;
+    }
+
+    len8 = strnlen16to8(s16, stringlen);
+    if (len8 >= arena->size - arena->used) {
+        void **block = (void **)malloc(sizeof(void *) + len8 + 1);
+
+        RLOGW("string arena exhausted for request %s",
+                requestToString(pRI->pCI->requestNumber));
+        if (block == NULL) {
+            RLOGE("out of memory reading a string for request %s",
+                    requestToString(pRI->pCI->requestNumber));
+            return NULL;
+        }
+        block[0] = arena->overflow;
+        arena->overflow = block;
+        return strncpy16to8((char *)(block + 1), s16, stringlen);
+    }
+
+    s8 = strncpy16to8(arena->buf + arena->used, s16, stringlen);
+    arena->used += len8 + 1;
 
-    return strndup16to8(s16, stringlen);
+    return s8;
+}
+
+static void
+freeArenaOverflow(StringArena *arena) {
+    while (arena->overflow != NULL) {
+        void **block = (void **)arena->overflow;
+
+        arena->overflow = block[0];
+        free(block);
+    }
 }
 
 static void writeStringToParcel(Parcel &p, const char *s) {
@@ -392,19 +832,411 @@ static void writeStringToParcel(Parcel &p, const char *s) {
 }
 
 
-static void
-memsetString (char *s) {
-    if (s != NULL) {
-        memset (s, 0, strlen(s));
-    }
-}
-
 void   nullParcelReleaseFunction (const uint8_t* data, size_t dataSize,
                                     const size_t* objects, size_t objectsSize,
                                         void* cookie) {
     // do nothing -- the data reference lives longer than the Parcel object
 }
 
+/**
+ * Returns a pooled, empty Parcel with room for at least *sizeHint bytes.
+ * Give it back with recycleParcel().
+ */
+static Parcel *
+obtainParcel(uint32_t *sizeHint) {
+    Parcel *p = NULL;
+    uint32_t hint;
+
+    pthread_mutex_lock(&s_parcelPoolMutex);
+    if (s_parcelPoolCount > 0) {
+        p = s_parcelPool[--s_parcelPoolCount];
+    }
+    pthread_mutex_unlock(&s_parcelPoolMutex);
+
+    if (p == NULL) {
+        p = new Parcel();
+    }
+
+    hint = __atomic_load_n(sizeHint, __ATOMIC_RELAXED);
+    if (hint > p->dataCapacity()) {
+        p->setDataCapacity(hint);
+    }
+
+    return p;
+}
+
+static void
+recycleParcel(Parcel *p, uint32_t *sizeHint) {
+    uint32_t size = p->dataSize();
+    uint32_t hint = __atomic_load_n(sizeHint, __ATOMIC_RELAXED);
+
+    // follow the largest recent size, decaying slowly towards smaller ones
+    if (size > hint) {
+        hint = size;
+    } else {
+        hint -= (hint - size) / 8;
+    }
+    __atomic_store_n(sizeHint, hint, __ATOMIC_RELAXED);
+
+    if (p->dataCapacity() <= PARCEL_POOL_MAX_CAPACITY) {
+        // shrinking the size keeps the buffer
+        p->setDataSize(0);
+        p->setDataPosition(0);
+
+        pthread_mutex_lock(&s_parcelPoolMutex);
+        if (s_parcelPoolCount < PARCEL_POOL_SIZE) {
+            s_parcelPool[s_parcelPoolCount++] = p;
+            p = NULL;
+        }
+        pthread_mutex_unlock(&s_parcelPoolMutex);
+    }
+
+    delete p;
+}
+
+static uint32_t *
+solicitedSizeHint(CommandInfo *pCI) {
+    size_t index = pCI - s_commands;
+
+    return index < NUM_ELEMS(s_commands) ? &s_solicitedSizeHint[index] : &s_otherSizeHint;
+}
+
+static RequestClass
+requestClassOf(int32_t request) {
+    switch (request) {
+        case RIL_REQUEST_GET_CURRENT_CALLS:
+        case RIL_REQUEST_DIAL:
+        case RIL_REQUEST_HANGUP:
+        case RIL_REQUEST_HANGUP_WAITING_OR_BACKGROUND:
+        case RIL_REQUEST_HANGUP_FOREGROUND_RESUME_BACKGROUND:
+        case RIL_REQUEST_SWITCH_WAITING_OR_HOLDING_AND_ACTIVE:
+        case RIL_REQUEST_CONFERENCE:
+        case RIL_REQUEST_UDUB:
+        case RIL_REQUEST_LAST_CALL_FAIL_CAUSE:
+        case RIL_REQUEST_DTMF:
+        case RIL_REQUEST_ANSWER:
+        case RIL_REQUEST_DTMF_START:
+        case RIL_REQUEST_DTMF_STOP:
+        case RIL_REQUEST_SEPARATE_CONNECTION:
+        case RIL_REQUEST_SET_MUTE:
+        case RIL_REQUEST_GET_MUTE:
+        case RIL_REQUEST_EXPLICIT_CALL_TRANSFER:
+        case RIL_REQUEST_CDMA_FLASH:
+        case RIL_REQUEST_CDMA_BURST_DTMF:
+        case RIL_REQUEST_DIAL_EMERGENCY_CALL:
+        case RIL_REQUEST_DIAL_VIDEO_CALL:
+        case RIL_REQUEST_CALL_DEFLECTION:
+        case RIL_REQUEST_HANGUP_VT:
+            return REQUEST_CLASS_CALL;
+
+        case RIL_REQUEST_SEND_SMS:
+        case RIL_REQUEST_SEND_SMS_EXPECT_MORE:
+        case RIL_REQUEST_SMS_ACKNOWLEDGE:
+        case RIL_REQUEST_WRITE_SMS_TO_SIM:
+        case RIL_REQUEST_DELETE_SMS_ON_SIM:
+        case RIL_REQUEST_CDMA_SEND_SMS:
+        case RIL_REQUEST_CDMA_SMS_ACKNOWLEDGE:
+        case RIL_REQUEST_CDMA_WRITE_SMS_TO_RUIM:
+        case RIL_REQUEST_CDMA_DELETE_SMS_ON_RUIM:
+        case RIL_REQUEST_GET_SMSC_ADDRESS:
+        case RIL_REQUEST_SET_SMSC_ADDRESS:
+        case RIL_REQUEST_REPORT_SMS_MEMORY_STATUS:
+        case RIL_REQUEST_ACKNOWLEDGE_INCOMING_GSM_SMS_WITH_PDU:
+        case RIL_REQUEST_IMS_SEND_SMS:
+            return REQUEST_CLASS_SMS;
+
+        case RIL_REQUEST_GET_SIM_STATUS:
+        case RIL_REQUEST_ENTER_SIM_PIN:
+        case RIL_REQUEST_ENTER_SIM_PUK:
+        case RIL_REQUEST_ENTER_SIM_PIN2:
+        case RIL_REQUEST_ENTER_SIM_PUK2:
+        case RIL_REQUEST_CHANGE_SIM_PIN:
+        case RIL_REQUEST_CHANGE_SIM_PIN2:
+        case RIL_REQUEST_ENTER_NETWORK_DEPERSONALIZATION:
+        case RIL_REQUEST_GET_IMSI:
+        case RIL_REQUEST_SIM_IO:
+        case RIL_REQUEST_QUERY_FACILITY_LOCK:
+        case RIL_REQUEST_SET_FACILITY_LOCK:
+        case RIL_REQUEST_STK_GET_PROFILE:
+        case RIL_REQUEST_STK_SET_PROFILE:
+        case RIL_REQUEST_STK_SEND_ENVELOPE_COMMAND:
+        case RIL_REQUEST_STK_SEND_TERMINAL_RESPONSE:
+        case RIL_REQUEST_STK_HANDLE_CALL_SETUP_REQUESTED_FROM_SIM:
+        case RIL_REQUEST_REPORT_STK_SERVICE_IS_RUNNING:
+        case RIL_REQUEST_ISIM_AUTHENTICATION:
+        case RIL_REQUEST_STK_SEND_ENVELOPE_WITH_STATUS:
+        case RIL_REQUEST_SIM_TRANSMIT_APDU_BASIC:
+        case RIL_REQUEST_SIM_OPEN_CHANNEL:
+        case RIL_REQUEST_SIM_CLOSE_CHANNEL:
+        case RIL_REQUEST_SIM_TRANSMIT_APDU_CHANNEL:
+        case RIL_REQUEST_SIM_AUTHENTICATION:
+            return REQUEST_CLASS_SIM;
+
+        case RIL_REQUEST_SETUP_DATA_CALL:
+        case RIL_REQUEST_DEACTIVATE_DATA_CALL:
+        case RIL_REQUEST_LAST_DATA_CALL_FAIL_CAUSE:
+        case RIL_REQUEST_DATA_CALL_LIST:
+        case RIL_REQUEST_SET_INITIAL_ATTACH_APN:
+        case RIL_REQUEST_ALLOW_DATA:
+        case RIL_REQUEST_SET_DATA_PROFILE:
+            return REQUEST_CLASS_DATA;
+
+        case RIL_REQUEST_SET_NETWORK_SELECTION_AUTOMATIC:
+        case RIL_REQUEST_SET_NETWORK_SELECTION_MANUAL:
+        case RIL_REQUEST_QUERY_AVAILABLE_NETWORKS:
+            return REQUEST_CLASS_NETWORK;
+
+        default:
+            return REQUEST_CLASS_OTHER;
+    }
+}
+
+static const char *
+requestClassToString(int requestClass) {
+    switch (requestClass) {
+        case REQUEST_CLASS_CALL: return "call";
+        case REQUEST_CLASS_SMS: return "sms";
+        case REQUEST_CLASS_SIM: return "sim";
+        case REQUEST_CLASS_DATA: return "data";
+        case REQUEST_CLASS_OTHER: return "other";
+        case REQUEST_CLASS_NETWORK: return "network";
+        default: return "<unknown>";
+    }
+}
+
+// Where a command goes in a dispatch queue: ahead of any lower priority
+enum RequestPriority {
+    REQUEST_PRIORITY_BACKGROUND,    // polling the framework repeats anyway
+    REQUEST_PRIORITY_NORMAL,
+    REQUEST_PRIORITY_URGENT         // emergency dial and hangup
+};
+
+static RequestPriority
+requestPriorityOf(int32_t request) {
+    switch (request) {
+        case RIL_REQUEST_HANGUP:
+        case RIL_REQUEST_HANGUP_WAITING_OR_BACKGROUND:
+        case RIL_REQUEST_HANGUP_FOREGROUND_RESUME_BACKGROUND:
+        case RIL_REQUEST_ANSWER:
+        case RIL_REQUEST_DIAL_EMERGENCY_CALL:
+        case RIL_REQUEST_HANGUP_VT:
+            return REQUEST_PRIORITY_URGENT;
+
+        case RIL_REQUEST_SIGNAL_STRENGTH:
+        case RIL_REQUEST_VOICE_REGISTRATION_STATE:
+        case RIL_REQUEST_DATA_REGISTRATION_STATE:
+        case RIL_REQUEST_OPERATOR:
+        case RIL_REQUEST_QUERY_NETWORK_SELECTION_MODE:
+        case RIL_REQUEST_GET_NEIGHBORING_CELL_IDS:
+        case RIL_REQUEST_VOICE_RADIO_TECH:
+        case RIL_REQUEST_GET_CELL_INFO_LIST:
+        case RIL_REQUEST_IMS_REGISTRATION_STATE:
+        case RIL_REQUEST_GET_DC_RT_INFO:
+            return REQUEST_PRIORITY_BACKGROUND;
+
+        default:
+            return REQUEST_PRIORITY_NORMAL;
+    }
+}
+
+// Time allowed from onRequest to RIL_onRequestComplete, 0 for none
+static uint32_t
+requestDeadlineMs(int32_t request) {
+    if (RIL_REQUEST_DEADLINE_MS == 0) {
+        return 0;
+    }
+    if (requestClassOf(request) == REQUEST_CLASS_NETWORK) {
+        return MAX(RIL_REQUEST_DEADLINE_MS, NETWORK_REQUEST_DEADLINE_MS);
+    }
+    return RIL_REQUEST_DEADLINE_MS;
+}
+
+static inline RIL_Token
+requestToken(RequestInfo *pRI) {
+    return (RIL_Token)(uintptr_t)pRI->handle;
+}
+
+/**
+ * Token for onRequest; also marks the end of request decoding and starts
+ * the deadline. The timer holds the handle rather than pRI, which may be
+ * completed and freed before it fires.
+ */
+static inline RIL_Token
+dispatchToken(RequestInfo *pRI) {
+    uint32_t deadlineMs = pRI->local ? 0 : requestDeadlineMs(pRI->pCI->requestNumber);
+
+    pRI->dispatchNs = ril_nano_time();
+    if (deadlineMs > 0) {
+        struct timeval tv = {(time_t)(deadlineMs / 1000),
+                (suseconds_t)(deadlineMs % 1000 * 1000)};
+
+        ril_event_set(&pRI->deadline_event, -1, false, requestDeadlineCallback,
+                (void *)(uintptr_t)pRI->handle);
+        rilTimerAddWakeup(&pRI->deadline_event, &tv);
+    }
+    return requestToken(pRI);
+}
+
+static RequestStats *
+requestStats(CommandInfo *pCI) {
+    size_t index = pCI - s_commands;
+
+    return index < NUM_ELEMS(s_commands) ? &s_requestStats[index] : NULL;
+}
+
+// Map a request number to its table entry, NULL if it is unsupported
+static CommandInfo *
+lookupCommand(int32_t request) {
+    CommandInfo *pCI;
+
+    if ((uint32_t)request <= MAX_RIL_SOL) {
+        pCI = &s_commands[request];
+    } else if ((uint32_t)(request - SAMSUNG_REQUEST_BASE)
+            <= MAX_SAMSUNG_SOL - SAMSUNG_REQUEST_BASE) {
+        pCI = &s_commands[request - SAMSUNG_REQUEST_BASE + MAX_RIL_SOL + 1];
+    } else {
+        return NULL;
+    }
+
+    return pCI->dispatchFunction != NULL ? pCI : NULL;
+}
+
+// Map an unsolicited response number to its table entry, NULL if unsupported
+static UnsolResponseInfo *
+lookupUnsolResponse(int unsolResponse) {
+    UnsolResponseInfo *pUI;
+
+    if ((uint32_t)(unsolResponse - RIL_UNSOL_RESPONSE_BASE)
+            <= MAX_RIL_UNSOL - RIL_UNSOL_RESPONSE_BASE) {
+        pUI = &s_unsolResponses[unsolResponse - RIL_UNSOL_RESPONSE_BASE];
+    } else if ((uint32_t)(unsolResponse - SAMSUNG_UNSOL_RESPONSE_BASE)
+            <= MAX_SAMSUNG_UNSOL - SAMSUNG_UNSOL_RESPONSE_BASE) {
+        pUI = &s_unsolResponses[unsolResponse - SAMSUNG_UNSOL_RESPONSE_BASE
+                + MAX_RIL_UNSOL - RIL_UNSOL_RESPONSE_BASE + 1];
+    } else {
+        return NULL;
+    }
+
+    return pUI->responseFunction != NULL ? pUI : NULL;
+}
+
+// An in-flight request pRI can collapse into, or NULL. Called with the lock held.
+static RequestInfo *
+findCollapsible(PendingRequests *pending, RequestInfo *pRI,
+        const uint8_t *args, size_t argsLen) {
+    for (RequestInfo *leader = pending->collapsible; leader != NULL;
+            leader = leader->p_next) {
+        if (leader->pCI == pRI->pCI && leader->connection == pRI->connection
+                && leader->argsLen == argsLen
+                && memcmp(leader->args, args, argsLen) == 0) {
+            return leader;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Adds pRI to its socket's pending table and assigns pRI->handle.
+ *
+ * args holds the request arguments if pRI may collapse, NULL otherwise.
+ * Then if an identical request is in flight pRI joins its followers
+ * instead, and is answered when that request completes.
+ *
+ * Returns 0 if pRI is to be dispatched, 1 if it collapsed, -1 if the
+ * table cannot grow or the client that sent pRI has disconnected.
+ */
+static int
+enqueueRequestInfo(RequestInfo *pRI, const uint8_t *args, size_t argsLen) {
+    PendingRequests *pending = &s_pendingRequests[pRI->socket_id];
+    uint32_t slot;
+    int ret;
+
+    if (pRI->local == 0 && pRI->connection != outQueueConnection(pRI->socket_id)) {
+        RLOGD("%s: dropping [%04d] %s, its client disconnected",
+                rilSocketIdToString(pRI->socket_id), pRI->token,
+                requestToString(pRI->pCI->requestNumber));
+        return -1;
+    }
+
+    ret = pthread_mutex_lock(&pending->mutex);
+    assert (ret == 0);
+
+    if (args != NULL) {
+        RequestInfo *leader = findCollapsible(pending, pRI, args, argsLen);
+
+        if (leader != NULL) {
+            RequestInfo **pp = &leader->followers;
+
+            while (*pp != NULL) {
+                pp = &(*pp)->p_next;
+            }
+            *pp = pRI;
+            pthread_mutex_unlock(&pending->mutex);
+            return 1;
+        }
+    }
+
+    if (pending->freeHead == PENDING_NO_SLOT) {
+        uint32_t newSize = pending->size ? pending->size * 2 : PENDING_INITIAL_SIZE;
+        PendingSlot *slots;
+
+        if (newSize > PENDING_NO_SLOT) {
+            newSize = PENDING_NO_SLOT;
+        }
+        if (newSize <= pending->size) {
+            pthread_mutex_unlock(&pending->mutex);
+            RLOGE("too many pending requests on %s",
+                    rilSocketIdToString(pRI->socket_id));
+            return -1;
+        }
+        slots = (PendingSlot *)realloc(pending->slots, newSize * sizeof(PendingSlot));
+        if (slots == NULL) {
+            pthread_mutex_unlock(&pending->mutex);
+            RLOGE("out of memory growing pending requests");
+            return -1;
+        }
+        // chain the new slots onto the free list, lowest index first
+        for (uint32_t i = pending->size; i < newSize; i++) {
+            slots[i].pRI = NULL;
+            slots[i].generation = 1;
+            slots[i].expired = 0;
+            slots[i].nextFree = (i + 1 < newSize) ? i + 1 : PENDING_NO_SLOT;
+        }
+        pending->freeHead = pending->size;
+        pending->slots = slots;
+        pending->size = newSize;
+    }
+
+    slot = pending->freeHead;
+    pending->freeHead = pending->slots[slot].nextFree;
+    if (++pending->count > pending->highWater) {
+        pending->highWater = pending->count;
+    }
+    pending->slots[slot].pRI = pRI;
+    pRI->handle = ((uint32_t)pRI->socket_id << PENDING_SOCKET_SHIFT)
+            | ((uint32_t)pending->slots[slot].generation << PENDING_SLOT_BITS)
+            | slot;
+
+    // Let identical requests collapse into this one while it is in flight
+    if (args != NULL) {
+        pRI->args = argsLen > 0 ? (uint8_t *)malloc(argsLen) : NULL;
+        if (argsLen == 0 || pRI->args != NULL) {
+            if (argsLen > 0) {
+                memcpy(pRI->args, args, argsLen);
+            }
+            pRI->argsLen = argsLen;
+            pRI->collapsible = 1;
+            pRI->p_next = pending->collapsible;
+            pending->collapsible = pRI;
+        }
+    }
+
+    ret = pthread_mutex_unlock(&pending->mutex);
+    assert (ret == 0);
+
+    return 0;
+}
+
 /**
  * To be called from dispatch thread
  * Issue a single local request, ensuring that the response
@@ -413,67 +1245,230 @@ void   nullParcelReleaseFunction (const uint8_t* data, size_t dataSize,
 static void
 issueLocalRequest(int request, void *data, int len, RIL_SOCKET_ID socket_id) {
     RequestInfo *pRI;
-    int index;
-    int ret;
-    /* Hook for current context */
-    /* pendingRequestsMutextHook refer to &s_pendingRequestsMutex */
-    pthread_mutex_t* pendingRequestsMutexHook = &s_pendingRequestsMutex;
-    /* pendingRequestsHook refer to &s_pendingRequests */
-    RequestInfo**    pendingRequestsHook = &s_pendingRequests;
+    CommandInfo *pCI;
 
-#if (SIM_COUNT == 2)
-    if (socket_id == RIL_SOCKET_2) {
-        pendingRequestsMutexHook = &s_pendingRequestsMutex_socket2;
-        pendingRequestsHook = &s_pendingRequests_socket2;
+    pCI = lookupCommand(request);
+    if (pCI == NULL) {
+        RLOGE("unsupported local request code %d", request);
+        return;
     }
-#endif
 
-    pRI = (RequestInfo *)calloc(1, sizeof(RequestInfo));
+    pRI = (RequestInfo *)ril_pool_alloc(&s_requestInfoPool);
 
     pRI->local = 1;
     pRI->token = 0xffffffff;        // token is not used in this context
+    pRI->startNs = ril_nano_time();
+    pRI->pCI = pCI;
+    pRI->socket_id = socket_id;
+
+    if (enqueueRequestInfo(pRI, NULL, 0) < 0) {
+        ril_pool_free(&s_requestInfoPool, pRI);
+        return;
+    }
+
+    ril_trace(RIL_TRACE_LOCAL_REQUEST, socket_id, request, -1, 0, len);
+#if RILC_LOG
+    RLOGD("C[locl]> %s", requestToString(request));
+#endif
 
-    /* Hack to include Samsung requests */
-    if (request > 10000) {
-        index = request - 10000 + MAX_RIL_SOL;
-        RLOGD("SAMSUNG: request=%d, index=%d", request, index);
-        pRI->pCI = &(s_commands[index]);
+    VENDOR_LOCK();
+    CALL_ONREQUEST(request, data, len, pRI, pRI->socket_id);
+    VENDOR_UNLOCK();
+}
+
+
+/**
+ * Reply to a request that has no table entry, so the client sees
+ * RIL_E_REQUEST_NOT_SUPPORTED instead of waiting for a response
+ */
+static void
+sendUnsupportedResponse(int32_t request, int32_t token, RIL_SOCKET_ID socket_id,
+        uint32_t connection) {
+    Parcel &p = *obtainParcel(&s_otherSizeHint);
+
+    p.writeInt32 (RESPONSE_SOLICITED);
+    p.writeInt32 (token);
+    p.writeInt32 (RIL_E_REQUEST_NOT_SUPPORTED);
+
+    ril_trace(RIL_TRACE_RESPONSE, socket_id, request, token,
+            RIL_E_REQUEST_NOT_SUPPORTED, 0);
+    sendResponse(p, socket_id, connection);
+    recycleParcel(&p, &s_otherSizeHint);
+}
+
+// Index in s_cachePolicies, -1 if responses to request are not cached
+static int
+responseCacheIndex(int request) {
+    for (size_t i = 0; i < NUM_ELEMS(s_cachePolicies); i++) {
+        if (s_cachePolicies[i].requestNumber == request) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Answer a request from the cache. On a miss returns false with the
+ * entry's generation, which responseCacheStore() checks so a response
+ * overtaken by an invalidation is not stored.
+ */
+static bool
+responseCacheServe(int index, CommandInfo *pCI, int32_t token,
+        const uint8_t *args, size_t argsLen, RIL_SOCKET_ID socket_id,
+        uint32_t connection, uint32_t *p_generation) {
+    const CachePolicy *policy = &s_cachePolicies[index];
+    CacheEntry *entry = &s_responseCache[socket_id][index];
+    uint32_t *sizeHint = solicitedSizeHint(pCI);
+    Parcel *p = NULL;
+
+    pthread_mutex_lock(&s_responseCacheMutex);
+
+    if (entry->data != NULL && entry->argsLen == argsLen
+            && memcmp(entry->args, args, argsLen) == 0
+            && (policy->ttlMs == 0 || ril_nano_time() - entry->storedNs
+                    < (uint64_t)policy->ttlMs * 1000000)) {
+        p = obtainParcel(sizeHint);
+        p->writeInt32 (RESPONSE_SOLICITED);
+        p->writeInt32 (token);
+        p->write(entry->data, entry->len);
+        entry->hits++;
     } else {
-        pRI->pCI = &(s_commands[request]);
+        entry->misses++;
+        *p_generation = entry->generation;
     }
 
-    pRI->socket_id = socket_id;
+    pthread_mutex_unlock(&s_responseCacheMutex);
 
-    ret = pthread_mutex_lock(pendingRequestsMutexHook);
-    assert (ret == 0);
+    if (p == NULL) {
+        return false;
+    }
+    ril_trace(RIL_TRACE_REQUEST, socket_id, pCI->requestNumber, token, 0, argsLen);
+    ril_trace(RIL_TRACE_RESPONSE, socket_id, pCI->requestNumber, token,
+            RIL_E_SUCCESS, p->dataSize());
+    sendResponse(*p, socket_id, connection);
+    recycleParcel(p, sizeHint);
+    return true;
+}
 
-    pRI->p_next = *pendingRequestsHook;
-    *pendingRequestsHook = pRI;
+// Keep a successful response marshalled in p, unless invalidated meanwhile
+static void
+responseCacheStore(int index, RequestInfo *pRI, Parcel &p) {
+    CacheEntry *entry = &s_responseCache[pRI->socket_id][index];
+    size_t headerLen = 2 * sizeof(int32_t);     // RESPONSE_SOLICITED, token
+    size_t len = p.dataSize() - headerLen;
+    uint8_t *buf = (uint8_t *)malloc(pRI->argsLen + len);
 
-    ret = pthread_mutex_unlock(pendingRequestsMutexHook);
-    assert (ret == 0);
+    if (buf == NULL) {
+        return;
+    }
+    if (pRI->argsLen > 0) {
+        memcpy(buf, pRI->args, pRI->argsLen);
+    }
+    memcpy(buf + pRI->argsLen, p.data() + headerLen, len);
 
-    RLOGD("C[locl]> %s", requestToString(request));
+    pthread_mutex_lock(&s_responseCacheMutex);
 
-    CALL_ONREQUEST(request, data, len, pRI, pRI->socket_id);
+    if (entry->generation == pRI->cacheGeneration) {
+        free(entry->args);
+        entry->args = buf;
+        entry->argsLen = pRI->argsLen;
+        entry->data = buf + pRI->argsLen;
+        entry->len = len;
+        entry->storedNs = ril_nano_time();
+        buf = NULL;
+    }
+
+    pthread_mutex_unlock(&s_responseCacheMutex);
+
+    free(buf);
 }
 
+// Whether code is on a 0 terminated invalidatedBy list
+static bool
+isInvalidatedBy(const int *invalidatedBy, int code) {
+    for (int j = 0; j < CACHE_MAX_INVALIDATORS && invalidatedBy[j] != 0; j++) {
+        if (invalidatedBy[j] == code) {
+            return true;
+        }
+    }
+    return false;
+}
 
+// Drop the socket's entries that code invalidates
+static void
+responseCacheInvalidate(int code, RIL_SOCKET_ID socket_id) {
+    for (size_t i = 0; i < NUM_ELEMS(s_cachePolicies); i++) {
+        if (isInvalidatedBy(s_cachePolicies[i].invalidatedBy, code)) {
+            CacheEntry *entry = &s_responseCache[socket_id][i];
+
+            pthread_mutex_lock(&s_responseCacheMutex);
+            entry->generation++;
+            free(entry->args);
+            entry->args = NULL;
+            entry->data = NULL;
+            pthread_mutex_unlock(&s_responseCacheMutex);
+        }
+    }
+}
+
+// Whether code makes the in-flight response to request stale
+static bool
+collapseInvalidatedBy(int request, int code) {
+    for (size_t i = 0; i < NUM_ELEMS(s_cachePolicies); i++) {
+        if (s_cachePolicies[i].requestNumber == request) {
+            return isInvalidatedBy(s_cachePolicies[i].invalidatedBy, code);
+        }
+    }
+    for (size_t i = 0; i < NUM_ELEMS(s_collapseInvalidations); i++) {
+        if (s_collapseInvalidations[i].requestNumber == request) {
+            return isInvalidatedBy(s_collapseInvalidations[i].invalidatedBy, code);
+        }
+    }
+    return false;
+}
+
+/**
+ * Take the socket's in-flight requests that code makes stale off the
+ * collapsible list. Their followers still get their response; requests
+ * arriving from now on are dispatched anew.
+ */
+static void
+collapseInvalidate(int code, RIL_SOCKET_ID socket_id) {
+    PendingRequests *pending = &s_pendingRequests[socket_id];
+    RequestInfo **pp;
+
+    pthread_mutex_lock(&pending->mutex);
+
+    pp = &pending->collapsible;
+    while (*pp != NULL) {
+        RequestInfo *leader = *pp;
+
+        if (collapseInvalidatedBy(leader->pCI->requestNumber, code)) {
+            *pp = leader->p_next;
+            leader->p_next = NULL;
+            leader->collapsible = 0;
+        } else {
+            pp = &leader->p_next;
+        }
+    }
+
+    pthread_mutex_unlock(&pending->mutex);
+}
 
 static int
-processCommandBuffer(void *buffer, size_t buflen, RIL_SOCKET_ID socket_id) {
+processCommandBuffer(void *buffer, size_t buflen, RIL_SOCKET_ID socket_id,
+        uint32_t connection) {
     Parcel p;
     status_t status;
     int32_t request;
     int32_t token;
     RequestInfo *pRI;
-    int index;
+    CommandInfo *pCI;
     int ret;
-    /* Hook for current context */
-    /* pendingRequestsMutextHook refer to &s_pendingRequestsMutex */
-    pthread_mutex_t* pendingRequestsMutexHook = &s_pendingRequestsMutex;
-    /* pendingRequestsHook refer to &s_pendingRequests */
-    RequestInfo**    pendingRequestsHook = &s_pendingRequests;
+    int cacheIndex;
+    uint32_t cacheGeneration = 0;
+    char arenaBuf[STRING_ARENA_BYTES];
+    StringArena arena = {arenaBuf, sizeof(arenaBuf), 0, NULL};
 
     p.setData((uint8_t *) buffer, buflen);
 
@@ -481,25 +1476,8 @@ processCommandBuffer(void *buffer, size_t buflen, RIL_SOCKET_ID socket_id) {
     status = p.readInt32(&request);
     status = p.readInt32 (&token);
 
+#if RILC_LOG
     RLOGD("SOCKET %s REQUEST: %s length:%d", rilSocketIdToString(socket_id), requestToString(request), buflen);
-
-#if (SIM_COUNT >= 2)
-    if (socket_id == RIL_SOCKET_2) {
-        pendingRequestsMutexHook = &s_pendingRequestsMutex_socket2;
-        pendingRequestsHook = &s_pendingRequests_socket2;
-    }
-#if (SIM_COUNT >= 3)
-    else if (socket_id == RIL_SOCKET_3) {
-        pendingRequestsMutexHook = &s_pendingRequestsMutex_socket3;
-        pendingRequestsHook = &s_pendingRequests_socket3;
-    }
-#endif
-#if (SIM_COUNT >= 4)
-    else if (socket_id == RIL_SOCKET_4) {
-        pendingRequestsMutexHook = &s_pendingRequestsMutex_socket4;
-        pendingRequestsHook = &s_pendingRequests_socket4;
-    }
-#endif
 #endif
 
     if (status != NO_ERROR) {
@@ -507,53 +1485,69 @@ processCommandBuffer(void *buffer, size_t buflen, RIL_SOCKET_ID socket_id) {
         return 0;
     }
 
-    /* Hack to include Samsung requests */
-    if (request < 1 || ((request > MAX_RIL_SOL) &&
-            (request < RIL_REQUEST_GET_CELL_BROADCAST_CONFIG)) ||
-            request > RIL_REQUEST_HANGUP_VT) {
+    pCI = lookupCommand(request);
+    if (pCI == NULL) {
         RLOGE("unsupported request code %d token %d", request, token);
-        // FIXME this should perhaps return a response
+        sendUnsupportedResponse(request, token, socket_id, connection);
         return 0;
     }
 
+    cacheIndex = responseCacheIndex(request);
+    if (cacheIndex >= 0 && responseCacheServe(cacheIndex, pCI, token,
+            (uint8_t *)buffer + p.dataPosition(), buflen - p.dataPosition(),
+            socket_id, connection, &cacheGeneration)) {
+        return 0;
+    }
 
-    pRI = (RequestInfo *)calloc(1, sizeof(RequestInfo));
+    pRI = (RequestInfo *)ril_pool_alloc(&s_requestInfoPool);
 
     pRI->token = token;
-
-    /* Hack to include Samsung requests */
-    if (request > 10000) {
-        index = request - 10000 + MAX_RIL_SOL;
-        RLOGD("processCommandBuffer: samsung request=%d, index=%d",
-                request, index);
-        pRI->pCI = &(s_commands[index]);
-    } else {
-        pRI->pCI = &(s_commands[request]);
-    }
-
-    pRI->pCI = &(s_commands[request]);
+    pRI->startNs = ril_nano_time();
+    pRI->pCI = pCI;
     pRI->socket_id = socket_id;
+    pRI->connection = connection;
+    pRI->cacheGeneration = cacheGeneration;
 
-    ret = pthread_mutex_lock(pendingRequestsMutexHook);
-    assert (ret == 0);
+    ret = enqueueRequestInfo(pRI, pCI->collapse == COLLAPSE
+                    ? (uint8_t *)buffer + p.dataPosition() : NULL,
+            buflen - p.dataPosition());
+    if (ret < 0) {
+        ril_pool_free(&s_requestInfoPool, pRI);
+        return 0;
+    }
 
-    pRI->p_next = *pendingRequestsHook;
-    *pendingRequestsHook = pRI;
+/*    sLastDispatchedToken = token; */
 
-    ret = pthread_mutex_unlock(pendingRequestsMutexHook);
-    assert (ret == 0);
+    ril_trace(RIL_TRACE_REQUEST, socket_id, request, token, 0, buflen);
 
-/*    sLastDispatchedToken = token; */
+    if (ret > 0) {
+        // answered when the identical request in flight completes
+        return 0;
+    }
 
+    // pRI may already be completed and freed once this returns
+    pRI->arena = &arena;
+    VENDOR_LOCK();
     pRI->pCI->dispatchFunction(p, pRI);
+    VENDOR_UNLOCK();
+
+#ifdef MEMSET_FREED
+    memset(arenaBuf, 0, arena.used);
+#endif
+    freeArenaOverflow(&arena);
 
     return 0;
 }
 
+/**
+ * Fails a request whose arguments could not be decoded. Requests that
+ * collapsed into it are answered with it rather than left pending.
+ */
 static void
 invalidCommandBlock (RequestInfo *pRI) {
     RLOGE("invalid command block for token %d request %s",
                 pRI->token, requestToString(pRI->pCI->requestNumber));
+    RIL_onRequestComplete(requestToken(pRI), RIL_E_GENERIC_FAILURE, NULL, 0);
 }
 
 /** Callee expects NULL */
@@ -572,7 +1566,7 @@ dispatchString (Parcel& p, RequestInfo *pRI) {
     size_t stringlen;
     char *string8 = NULL;
 
-    string8 = strdupReadString(p);
+    string8 = readString(p, pRI);
 
     startRequest;
     appendPrintBuf("%s%s", printBuf, string8);
@@ -582,11 +1576,6 @@ dispatchString (Parcel& p, RequestInfo *pRI) {
     CALL_ONREQUEST(pRI->pCI->requestNumber, string8,
                        sizeof(char *), pRI, pRI->socket_id);
 
-#ifdef MEMSET_FREED
-    memsetString(string8);
-#endif
-
-    free(string8);
     return;
 invalid:
     invalidCommandBlock(pRI);
@@ -621,7 +1610,7 @@ dispatchStrings (Parcel &p, RequestInfo *pRI) {
         pStrings = (char **)alloca(datalen);
 
         for (int i = 0 ; i < countStrings ; i++) {
-            pStrings[i] = strdupReadString(p);
+            pStrings[i] = readString(p, pRI);
             appendPrintBuf("%s%s,", printBuf, pStrings[i]);
         }
     }
@@ -631,18 +1620,11 @@ dispatchStrings (Parcel &p, RequestInfo *pRI) {
 
     CALL_ONREQUEST(pRI->pCI->requestNumber, pStrings, datalen, pRI, pRI->socket_id);
 
-    if (pStrings != NULL) {
-        for (int i = 0 ; i < countStrings ; i++) {
-#ifdef MEMSET_FREED
-            memsetString (pStrings[i]);
-#endif
-            free(pStrings[i]);
-        }
-
 #ifdef MEMSET_FREED
+    if (pStrings != NULL) {
         memset(pStrings, 0, datalen);
-#endif
     }
+#endif
 
     return;
 invalid:
@@ -714,13 +1696,13 @@ dispatchSmsWrite (Parcel &p, RequestInfo *pRI) {
     status = p.readInt32(&t);
     args.status = (int)t;
 
-    args.pdu = strdupReadString(p);
+    args.pdu = readString(p, pRI);
 
     if (status != NO_ERROR || args.pdu == NULL) {
         goto invalid;
     }
 
-    args.smsc = strdupReadString(p);
+    args.smsc = readString(p, pRI);
 
     startRequest;
     appendPrintBuf("%s%d,%s,smsc=%s", printBuf, args.status,
@@ -730,12 +1712,6 @@ dispatchSmsWrite (Parcel &p, RequestInfo *pRI) {
 
     CALL_ONREQUEST(pRI->pCI->requestNumber, &args, sizeof(args), pRI, pRI->socket_id);
 
-#ifdef MEMSET_FREED
-    memsetString (args.pdu);
-#endif
-
-    free (args.pdu);
-
 #ifdef MEMSET_FREED
     memset(&args, 0, sizeof(args));
 #endif
@@ -763,7 +1739,7 @@ dispatchDial (Parcel &p, RequestInfo *pRI) {
 
     memset (&dial, 0, sizeof(dial));
 
-    dial.address = strdupReadString(p);
+    dial.address = readString(p, pRI);
 
     status = p.readInt32(&t);
     dial.clir = (int)t;
@@ -826,12 +1802,6 @@ dispatchDial (Parcel &p, RequestInfo *pRI) {
 
     CALL_ONREQUEST(pRI->pCI->requestNumber, &dial, sizeOfDial, pRI, pRI->socket_id);
 
-#ifdef MEMSET_FREED
-    memsetString (dial.address);
-#endif
-
-    free (dial.address);
-
 #ifdef MEMSET_FREED
     memset(&uusInfo, 0, sizeof(RIL_UUS_Info));
     memset(&dial, 0, sizeof(dial));
@@ -875,7 +1845,7 @@ dispatchSIM_IO (Parcel &p, RequestInfo *pRI) {
     status = p.readInt32(&t);
     simIO.v6.fileid = (int)t;
 
-    simIO.v6.path = strdupReadString(p);
+    simIO.v6.path = readString(p, pRI);
 
     status = p.readInt32(&t);
     simIO.v6.p1 = (int)t;
@@ -886,9 +1856,9 @@ dispatchSIM_IO (Parcel &p, RequestInfo *pRI) {
     status = p.readInt32(&t);
     simIO.v6.p3 = (int)t;
 
-    simIO.v6.data = strdupReadString(p);
-    simIO.v6.pin2 = strdupReadString(p);
-    simIO.v6.aidPtr = strdupReadString(p);
+    simIO.v6.data = readString(p, pRI);
+    simIO.v6.pin2 = readString(p, pRI);
+    simIO.v6.aidPtr = readString(p, pRI);
 
     startRequest;
     appendPrintBuf("%scmd=0x%X,efid=0x%X,path=%s,%d,%d,%d,%s,pin2=%s,aid=%s", printBuf,
@@ -905,18 +1875,6 @@ dispatchSIM_IO (Parcel &p, RequestInfo *pRI) {
     size = (s_callbacks.version < 6) ? sizeof(simIO.v5) : sizeof(simIO.v6);
     CALL_ONREQUEST(pRI->pCI->requestNumber, &simIO, size, pRI, pRI->socket_id);
 
-#ifdef MEMSET_FREED
-    memsetString (simIO.v6.path);
-    memsetString (simIO.v6.data);
-    memsetString (simIO.v6.pin2);
-    memsetString (simIO.v6.aidPtr);
-#endif
-
-    free (simIO.v6.path);
-    free (simIO.v6.data);
-    free (simIO.v6.pin2);
-    free (simIO.v6.aidPtr);
-
 #ifdef MEMSET_FREED
     memset(&simIO, 0, sizeof(simIO));
 #endif
@@ -964,7 +1922,7 @@ dispatchSIM_APDU (Parcel &p, RequestInfo *pRI) {
     status = p.readInt32(&t);
     apdu.p3 = (int)t;
 
-    apdu.data = strdupReadString(p);
+    apdu.data = readString(p, pRI);
 
     startRequest;
     appendPrintBuf("%ssessionid=%d,cla=%d,ins=%d,p1=%d,p2=%d,p3=%d,data=%s",
@@ -979,11 +1937,6 @@ dispatchSIM_APDU (Parcel &p, RequestInfo *pRI) {
 
     CALL_ONREQUEST(pRI->pCI->requestNumber, &apdu, sizeof(RIL_SIM_APDU), pRI, pRI->socket_id);
 
-#ifdef MEMSET_FREED
-    memsetString(apdu.data);
-#endif
-    free(apdu.data);
-
 #ifdef MEMSET_FREED
     memset(&apdu, 0, sizeof(RIL_SIM_APDU));
 #endif
@@ -1027,7 +1980,7 @@ dispatchCallForward(Parcel &p, RequestInfo *pRI) {
     status = p.readInt32(&t);
     cff.toa = (int)t;
 
-    cff.number = strdupReadString(p);
+    cff.number = readString(p, pRI);
 
     status = p.readInt32(&t);
     cff.timeSeconds = (int)t;
@@ -1051,12 +2004,6 @@ dispatchCallForward(Parcel &p, RequestInfo *pRI) {
 
     CALL_ONREQUEST(pRI->pCI->requestNumber, &cff, sizeof(cff), pRI, pRI->socket_id);
 
-#ifdef MEMSET_FREED
-    memsetString(cff.number);
-#endif
-
-    free (cff.number);
-
 #ifdef MEMSET_FREED
     memset(&cff, 0, sizeof(cff));
 #endif
@@ -1271,7 +2218,7 @@ dispatchImsGsmSms(Parcel &p, RequestInfo *pRI, uint8_t retry, int32_t messageRef
         pStrings = (char **)alloca(datalen);
 
         for (int i = 0 ; i < countStrings ; i++) {
-            pStrings[i] = strdupReadString(p);
+            pStrings[i] = readString(p, pRI);
             appendPrintBuf("%s%s,", printBuf, pStrings[i]);
         }
     }
@@ -1284,18 +2231,11 @@ dispatchImsGsmSms(Parcel &p, RequestInfo *pRI, uint8_t retry, int32_t messageRef
             sizeof(RIL_RadioTechnologyFamily)+sizeof(uint8_t)+sizeof(int32_t)
             +datalen, pRI, pRI->socket_id);
 
-    if (pStrings != NULL) {
-        for (int i = 0 ; i < countStrings ; i++) {
-#ifdef MEMSET_FREED
-            memsetString (pStrings[i]);
-#endif
-            free(pStrings[i]);
-        }
-
 #ifdef MEMSET_FREED
+    if (pStrings != NULL) {
         memset(pStrings, 0, datalen);
-#endif
     }
+#endif
 
 #ifdef MEMSET_FREED
     memset(&rism, 0, sizeof(rism));
@@ -1338,6 +2278,7 @@ dispatchImsSms(Parcel &p, RequestInfo *pRI) {
         dispatchImsCdmaSms(p, pRI, retry, messageRef);
     } else {
         ALOGE("requestImsSendSMS invalid format value =%d", format);
+        invalidCommandBlock(pRI);
     }
 
     return;
@@ -1636,7 +2577,8 @@ static void dispatchVoiceRadioTech(Parcel& p, RequestInfo *pRI) {
     RIL_RadioState state = CALL_ONSTATEREQUEST((RIL_SOCKET_ID)pRI->socket_id);
 
     if ((RADIO_STATE_UNAVAILABLE == state) || (RADIO_STATE_OFF == state)) {
-        RIL_onRequestComplete(pRI, RIL_E_RADIO_NOT_AVAILABLE, NULL, 0);
+        RIL_onRequestComplete(requestToken(pRI), RIL_E_RADIO_NOT_AVAILABLE, NULL, 0);
+        return;
     }
 
     // RILs that support RADIO_STATE_ON should support this request.
@@ -1651,9 +2593,9 @@ static void dispatchVoiceRadioTech(Parcel& p, RequestInfo *pRI) {
     voiceRadioTech = decodeVoiceRadioTechnology(state);
 
     if (voiceRadioTech < 0)
-        RIL_onRequestComplete(pRI, RIL_E_GENERIC_FAILURE, NULL, 0);
+        RIL_onRequestComplete(requestToken(pRI), RIL_E_GENERIC_FAILURE, NULL, 0);
     else
-        RIL_onRequestComplete(pRI, RIL_E_SUCCESS, &voiceRadioTech, sizeof(int));
+        RIL_onRequestComplete(requestToken(pRI), RIL_E_SUCCESS, &voiceRadioTech, sizeof(int));
 }
 
 // For backwards compatibility in RIL_REQUEST_CDMA_GET_SUBSCRIPTION_SOURCE:.
@@ -1663,7 +2605,8 @@ static void dispatchCdmaSubscriptionSource(Parcel& p, RequestInfo *pRI) {
     RIL_RadioState state = CALL_ONSTATEREQUEST((RIL_SOCKET_ID)pRI->socket_id);
 
     if ((RADIO_STATE_UNAVAILABLE == state) || (RADIO_STATE_OFF == state)) {
-        RIL_onRequestComplete(pRI, RIL_E_RADIO_NOT_AVAILABLE, NULL, 0);
+        RIL_onRequestComplete(requestToken(pRI), RIL_E_RADIO_NOT_AVAILABLE, NULL, 0);
+        return;
     }
 
     // RILs that support RADIO_STATE_ON should support this request.
@@ -1678,9 +2621,9 @@ static void dispatchCdmaSubscriptionSource(Parcel& p, RequestInfo *pRI) {
     cdmaSubscriptionSource = decodeCdmaSubscriptionSource(state);
 
     if (cdmaSubscriptionSource < 0)
-        RIL_onRequestComplete(pRI, RIL_E_GENERIC_FAILURE, NULL, 0);
+        RIL_onRequestComplete(requestToken(pRI), RIL_E_GENERIC_FAILURE, NULL, 0);
     else
-        RIL_onRequestComplete(pRI, RIL_E_SUCCESS, &cdmaSubscriptionSource, sizeof(int));
+        RIL_onRequestComplete(requestToken(pRI), RIL_E_SUCCESS, &cdmaSubscriptionSource, sizeof(int));
 }
 
 static void dispatchSetInitialAttachApn(Parcel &p, RequestInfo *pRI)
@@ -1691,14 +2634,14 @@ static void dispatchSetInitialAttachApn(Parcel &p, RequestInfo *pRI)
 
     memset(&pf, 0, sizeof(pf));
 
-    pf.apn = strdupReadString(p);
-    pf.protocol = strdupReadString(p);
+    pf.apn = readString(p, pRI);
+    pf.protocol = readString(p, pRI);
 
     status = p.readInt32(&t);
     pf.authtype = (int) t;
 
-    pf.username = strdupReadString(p);
-    pf.password = strdupReadString(p);
+    pf.username = readString(p, pRI);
+    pf.password = readString(p, pRI);
 
     startRequest;
     appendPrintBuf("%sapn=%s, protocol=%s, authtype=%d, username=%s, password=%s",
@@ -1711,18 +2654,6 @@ static void dispatchSetInitialAttachApn(Parcel &p, RequestInfo *pRI)
     }
     CALL_ONREQUEST(pRI->pCI->requestNumber, &pf, sizeof(pf), pRI, pRI->socket_id);
 
-#ifdef MEMSET_FREED
-    memsetString(pf.apn);
-    memsetString(pf.protocol);
-    memsetString(pf.username);
-    memsetString(pf.password);
-#endif
-
-    free(pf.apn);
-    free(pf.protocol);
-    free(pf.username);
-    free(pf.password);
-
 #ifdef MEMSET_FREED
     memset(&pf, 0, sizeof(pf));
 #endif
@@ -1776,7 +2707,7 @@ static void dispatchNVWriteItem(Parcel &p, RequestInfo *pRI) {
     status = p.readInt32(&t);
     nvwi.itemID = (RIL_NV_Item) t;
 
-    nvwi.value = strdupReadString(p);
+    nvwi.value = readString(p, pRI);
 
     if (status != NO_ERROR || nvwi.value == NULL) {
         goto invalid;
@@ -1791,12 +2722,6 @@ static void dispatchNVWriteItem(Parcel &p, RequestInfo *pRI) {
 
     CALL_ONREQUEST(pRI->pCI->requestNumber, &nvwi, sizeof(nvwi), pRI, pRI->socket_id);
 
-#ifdef MEMSET_FREED
-    memsetString(nvwi.value);
-#endif
-
-    free(nvwi.value);
-
 #ifdef MEMSET_FREED
     memset(&nvwi, 0, sizeof(nvwi));
 #endif
@@ -1869,8 +2794,8 @@ static void dispatchSimAuthentication(Parcel &p, RequestInfo *pRI)
 
     status = p.readInt32(&t);
     pf.authContext = (int) t;
-    pf.authData = strdupReadString(p);
-    pf.aid = strdupReadString(p);
+    pf.authData = readString(p, pRI);
+    pf.aid = readString(p, pRI);
 
     startRequest;
     appendPrintBuf("authContext=%s, authData=%s, aid=%s", pf.authContext, pf.authData, pf.aid);
@@ -1882,14 +2807,6 @@ static void dispatchSimAuthentication(Parcel &p, RequestInfo *pRI)
     }
     CALL_ONREQUEST(pRI->pCI->requestNumber, &pf, sizeof(pf), pRI, pRI->socket_id);
 
-#ifdef MEMSET_FREED
-    memsetString(pf.authData);
-    memsetString(pf.aid);
-#endif
-
-    free(pf.authData);
-    free(pf.aid);
-
 #ifdef MEMSET_FREED
     memset(&pf, 0, sizeof(pf));
 #endif
@@ -1921,13 +2838,13 @@ static void dispatchDataProfile(Parcel &p, RequestInfo *pRI) {
             status = p.readInt32(&t);
             dataProfiles[i].profileId = (int) t;
 
-            dataProfiles[i].apn = strdupReadString(p);
-            dataProfiles[i].protocol = strdupReadString(p);
+            dataProfiles[i].apn = readString(p, pRI);
+            dataProfiles[i].protocol = readString(p, pRI);
             status = p.readInt32(&t);
             dataProfiles[i].authType = (int) t;
 
-            dataProfiles[i].user = strdupReadString(p);
-            dataProfiles[i].password = strdupReadString(p);
+            dataProfiles[i].user = readString(p, pRI);
+            dataProfiles[i].password = readString(p, pRI);
 
             status = p.readInt32(&t);
             dataProfiles[i].type = (int) t;
@@ -1974,62 +2891,317 @@ invalid:
     return;
 }
 
-static int
-blockingWrite(int fd, const void *buffer, size_t len) {
-    size_t writeOffset = 0;
-    const uint8_t *toWrite;
+static void
+outQueueDiscard(OutQueue *q) {
+    OutRecord *rec;
+
+    while (q->head != NULL) {
+        rec = q->head;
+        q->head = rec->p_next;
+        free(rec);
+    }
+    q->tail = NULL;
+    q->bytes = 0;
+}
+
+static OutRecord *
+outRecordNew(uint32_t header, const void *data, size_t dataSize,
+        int unsolResponse) {
+    OutRecord *rec = (OutRecord *)malloc(sizeof(OutRecord)
+            + sizeof(header) + dataSize);
+
+    if (rec == NULL) {
+        return NULL;
+    }
+    rec->p_next = NULL;
+    rec->len = sizeof(header) + dataSize;
+    rec->offset = 0;
+    rec->unsolResponse = unsolResponse;
+    rec->data = (uint8_t *)(rec + 1);
+    memcpy(rec->data, &header, sizeof(header));
+    memcpy(rec->data + sizeof(header), data, dataSize);
+
+    return rec;
+}
+
+/**
+ * Unlinks the first record of unsolResponse from a list, or returns NULL.
+ * With keepHead the head is left alone; in the out queue it may already
+ * be partly written.
+ */
+static OutRecord *
+outListRemove(OutRecord **head, OutRecord **tail, int unsolResponse,
+        bool keepHead) {
+    OutRecord *prev = keepHead ? *head : NULL;
+    OutRecord *rec = prev != NULL ? prev->p_next : *head;
+
+    for (; rec != NULL; prev = rec, rec = rec->p_next) {
+        if (rec->unsolResponse == unsolResponse) {
+            if (prev != NULL) {
+                prev->p_next = rec->p_next;
+            } else {
+                *head = rec->p_next;
+            }
+            if (*tail == rec) {
+                *tail = prev;
+            }
+            rec->p_next = NULL;
+            return rec;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Keeps an unsent unsolicited response for the next connection, or frees
+ * it if its policy does not replay. Called with q->mutex held.
+ */
+static void
+outQueueKeep(OutQueue *q, OutRecord *rec, UnsolPolicy policy,
+        RIL_SOCKET_ID socket_id) {
+    OutRecord *old;
+
+    if (policy == REPLAY_LATEST) {
+        old = outListRemove(&q->replayHead, &q->replayTail,
+                rec->unsolResponse, false);
+        if (old != NULL) {
+            q->replayBytes -= old->len;
+            free(old);
+        }
+    }
 
-    toWrite = (const uint8_t *)buffer;
+    if (policy != REPLAY_LATEST && policy != REPLAY_ALL) {
+        free(rec);
+        return;
+    }
+    if (q->replayBytes + rec->len > REPLAY_MAX_BYTES) {
+        ril_trace(RIL_TRACE_DROPPED, socket_id, rec->unsolResponse, -1, 0,
+                rec->len);
+        RLOGE("%s: replay queue full, dropping %s",
+                rilSocketIdToString(socket_id),
+                requestToString(rec->unsolResponse));
+        free(rec);
+        return;
+    }
+
+    rec->p_next = NULL;
+    rec->offset = 0;
+    if (q->replayTail != NULL) {
+        q->replayTail->p_next = rec;
+    } else {
+        q->replayHead = rec;
+    }
+    q->replayTail = rec;
+    q->replayBytes += rec->len;
+}
+
+/**
+ * Writes queued records until the socket would block. Called with
+ * q->mutex held. Returns 0 when the queue is empty, 1 if records remain
+ * and -1 on a write error, after which the queue has been discarded and
+ * the socket shut down so the reader closes it.
+ */
+static int
+outQueueWrite(OutQueue *q) {
+    struct iovec iov[OUT_QUEUE_MAX_IOV];
+    OutRecord *rec;
+    ssize_t written;
+    int count;
+
+    while (q->head != NULL) {
+        count = 0;
+        for (rec = q->head; rec != NULL && count < OUT_QUEUE_MAX_IOV;
+                rec = rec->p_next, count++) {
+            iov[count].iov_base = rec->data + rec->offset;
+            iov[count].iov_len = rec->len - rec->offset;
+        }
 
-    while (writeOffset < len) {
-        ssize_t written;
         do {
-            written = write (fd, toWrite + writeOffset,
-                                len - writeOffset);
-        } while (written < 0 && ((errno == EINTR) || (errno == EAGAIN)));
+            written = writev(q->fd, iov, count);
+        } while (written < 0 && errno == EINTR);
 
-        if (written >= 0) {
-            writeOffset += written;
-        } else {   // written < 0
+        if (written < 0) {
+            if (errno == EAGAIN) {
+                return 1;
+            }
             RLOGE ("RIL Response: unexpected error on write errno:%d", errno);
-            close(fd);
+            outQueueDiscard(q);
+            shutdown(q->fd, SHUT_RDWR);
             return -1;
         }
+
+        q->bytes -= written;
+        while (written > 0) {
+            rec = q->head;
+            if ((size_t)written < rec->len - rec->offset) {
+                rec->offset += written;
+                break;
+            }
+            written -= rec->len - rec->offset;
+            q->head = rec->p_next;
+            free(rec);
+        }
+        if (q->head == NULL) {
+            q->tail = NULL;
+        }
     }
 
     return 0;
 }
 
-static int
-sendResponseRaw (const void *data, size_t dataSize, RIL_SOCKET_ID socket_id) {
-    int fd = s_ril_param_socket.fdCommand;
-    int ret;
-    uint32_t header;
-    pthread_mutex_t * writeMutexHook = &s_writeMutex;
+static void
+outQueueWritableCallback(int fd, short flags, void *param) {
+    OutQueue *q = (OutQueue *)param;
 
-    RLOGE("Send Response to %s", rilSocketIdToString(socket_id));
+    pthread_mutex_lock(&q->mutex);
 
-#if (SIM_COUNT >= 2)
-    if (socket_id == RIL_SOCKET_2) {
-        fd = s_ril_param_socket2.fdCommand;
-        writeMutexHook = &s_writeMutex_socket2;
+    if (q->fd >= 0 && outQueueWrite(q) > 0) {
+        ril_event_add(&q->write_event);
     }
-#if (SIM_COUNT >= 3)
-    else if (socket_id == RIL_SOCKET_3) {
-        fd = s_ril_param_socket3.fdCommand;
-        writeMutexHook = &s_writeMutex_socket3;
+
+    pthread_mutex_unlock(&q->mutex);
+}
+
+static void
+outQueueAttach(RIL_SOCKET_ID socket_id, int fdCommand) {
+    OutQueue *q = &s_outQueue[socket_id];
+
+    pthread_mutex_lock(&q->mutex);
+
+    q->fd = dup(fdCommand);
+    if (q->fd < 0) {
+        RLOGE("Error duplicating command socket errno:%d", errno);
+    } else {
+        fcntl(q->fd, F_SETFD, FD_CLOEXEC);
+        ril_event_set_write(&q->write_event, q->fd, false,
+                outQueueWritableCallback, q);
     }
-#endif
-#if (SIM_COUNT >= 4)
-    else if (socket_id == RIL_SOCKET_4) {
-        fd = s_ril_param_socket4.fdCommand;
-        writeMutexHook = &s_writeMutex_socket4;
+
+    pthread_mutex_unlock(&q->mutex);
+}
+
+static uint32_t
+outQueueConnection(RIL_SOCKET_ID socket_id) {
+    OutQueue *q = &s_outQueue[socket_id];
+    uint32_t connection;
+
+    pthread_mutex_lock(&q->mutex);
+    connection = q->connection;
+    pthread_mutex_unlock(&q->mutex);
+
+    return connection;
+}
+
+static void
+outQueueDetach(RIL_SOCKET_ID socket_id) {
+    OutQueue *q = &s_outQueue[socket_id];
+    UnsolResponseInfo *pUI;
+    OutRecord *rec;
+
+    pthread_mutex_lock(&q->mutex);
+
+    q->connection++;
+    if (q->fd >= 0) {
+        ril_event_del(&q->write_event);
+        close(q->fd);
+        q->fd = -1;
+    }
+
+    // whatever was never sent may still be replayed to the next client
+    while ((rec = q->head) != NULL) {
+        q->head = rec->p_next;
+        pUI = NULL;
+        if (rec->offset == 0 && rec->unsolResponse != 0) {
+            pUI = lookupUnsolResponse(rec->unsolResponse);
+        }
+        if (pUI != NULL) {
+            outQueueKeep(q, rec, pUI->policy, socket_id);
+        } else {
+            free(rec);
+        }
     }
-#endif
-#endif
-    if (fd < 0) {
-        return -1;
+    q->tail = NULL;
+    q->bytes = 0;
+
+    pthread_mutex_unlock(&q->mutex);
+}
+
+/**
+ * Sends the unsolicited responses kept while no client was connected,
+ * after those onNewCommandConnect() sends itself. sendRecord() has already
+ * dropped a kept REPLAY_LATEST response once a newer copy went out.
+ */
+static void
+outQueueReplay(RIL_SOCKET_ID socket_id) {
+    OutQueue *q = &s_outQueue[socket_id];
+    OutRecord *rec;
+    UnsolResponseInfo *pUI;
+    bool wasEmpty;
+
+    pthread_mutex_lock(&q->mutex);
+
+    if (q->fd < 0 || q->replayHead == NULL) {
+        pthread_mutex_unlock(&q->mutex);
+        return;
+    }
+
+    wasEmpty = (q->head == NULL);
+    while ((rec = q->replayHead) != NULL) {
+        q->replayHead = rec->p_next;
+        rec->p_next = NULL;
+
+        pUI = lookupUnsolResponse(rec->unsolResponse);
+        if (pUI == NULL) {
+            RLOGE("dropping replay of unknown unsolicited response %d",
+                    rec->unsolResponse);
+            free(rec);
+            continue;
+        }
+
+        if (q->tail != NULL) {
+            q->tail->p_next = rec;
+        } else {
+            q->head = rec;
+        }
+        q->tail = rec;
+        q->bytes += rec->len;
     }
+    q->replayTail = NULL;
+    q->replayBytes = 0;
+
+    if (q->bytes > q->highWater) {
+        q->highWater = q->bytes;
+    }
+    // a non-empty queue is already waiting for the socket to drain
+    if (wasEmpty && q->head != NULL && outQueueWrite(q) > 0) {
+        rilEventAddWakeup(&q->write_event);
+    }
+
+    pthread_mutex_unlock(&q->mutex);
+}
+
+/**
+ * Sends a record or queues it for a slow reader. unsolResponse is 0 for a
+ * solicited response, which is dropped unless the client that sent the
+ * request on connection is still connected; for an unsolicited one, policy
+ * says whether it replaces an older queued copy and whether it is kept
+ * while no client is connected. Returns -1 if it was not delivered to a
+ * client.
+ */
+static int
+sendRecord (const void *data, size_t dataSize, RIL_SOCKET_ID socket_id,
+        uint32_t connection, int unsolResponse, UnsolPolicy policy) {
+    OutQueue *q = &s_outQueue[socket_id];
+    struct iovec iov[2];
+    uint32_t header;
+    size_t total;
+    ssize_t written = 0;
+    OutRecord *rec;
+
+#if RILC_LOG
+    RLOGD("Send Response to %s", rilSocketIdToString(socket_id));
+#endif
 
     if (dataSize > MAX_COMMAND_BYTES) {
         RLOGE("RIL: packet larger than %u (%u)",
@@ -2038,33 +3210,128 @@ sendResponseRaw (const void *data, size_t dataSize, RIL_SOCKET_ID socket_id) {
         return -1;
     }
 
-    pthread_mutex_lock(writeMutexHook);
-
     header = htonl(dataSize);
+    total = sizeof(header) + dataSize;
 
-    ret = blockingWrite(fd, (void *)&header, sizeof(header));
+    pthread_mutex_lock(&q->mutex);
 
-    if (ret < 0) {
-        pthread_mutex_unlock(writeMutexHook);
-        return ret;
+    if (unsolResponse == 0 && connection != q->connection) {
+        pthread_mutex_unlock(&q->mutex);
+        return -1;
     }
 
-    ret = blockingWrite(fd, data, dataSize);
+    if (q->fd < 0) {
+        if (policy == REPLAY_LATEST || policy == REPLAY_ALL) {
+            rec = outRecordNew(header, data, dataSize, unsolResponse);
+            if (rec != NULL) {
+                outQueueKeep(q, rec, policy, socket_id);
+            }
+        }
+        pthread_mutex_unlock(&q->mutex);
+        return -1;
+    }
 
-    if (ret < 0) {
-        pthread_mutex_unlock(writeMutexHook);
-        return ret;
+    if (policy == REPLAY_LATEST && q->replayHead != NULL) {
+        // not replayed yet, and this copy is newer than the kept one
+        rec = outListRemove(&q->replayHead, &q->replayTail, unsolResponse, false);
+        if (rec != NULL) {
+            q->replayBytes -= rec->len;
+            free(rec);
+        }
+    }
+
+    if (q->head != NULL && (policy == KEEP_LATEST || policy == REPLAY_LATEST)) {
+        // the reader is behind: the older copy is stale, drop it
+        rec = outListRemove(&q->head, &q->tail, unsolResponse, true);
+        if (rec != NULL) {
+            q->bytes -= rec->len;
+            q->coalesced++;
+            free(rec);
+        }
+    }
+
+    if (q->head == NULL) {
+        // fast path: nothing queued, try to send it all now
+        iov[0].iov_base = &header;
+        iov[0].iov_len = sizeof(header);
+        iov[1].iov_base = (void *)data;
+        iov[1].iov_len = dataSize;
+
+        do {
+            written = writev(q->fd, iov, 2);
+        } while (written < 0 && errno == EINTR);
+
+        if ((size_t)written == total) {
+            pthread_mutex_unlock(&q->mutex);
+            return 0;
+        }
+        if (written < 0) {
+            if (errno != EAGAIN) {
+                RLOGE ("RIL Response: unexpected error on write errno:%d", errno);
+                shutdown(q->fd, SHUT_RDWR);
+                pthread_mutex_unlock(&q->mutex);
+                return -1;
+            }
+            written = 0;
+        }
+    }
+
+    // a partly written record must be completed to keep the stream framed
+    if (written == 0 && q->bytes + total > OUT_QUEUE_MAX_BYTES) {
+        ril_trace(RIL_TRACE_DROPPED, socket_id, -1, -1, 0, total);
+        RLOGE("RIL Response: %s not reading, dropping %u bytes",
+                rilSocketIdToString(socket_id), (unsigned int)total);
+        pthread_mutex_unlock(&q->mutex);
+        return -1;
+    }
+
+    rec = outRecordNew(header, data, dataSize, unsolResponse);
+    if (rec == NULL) {
+        RLOGE("RIL Response: out of memory queueing response");
+        if (written > 0) {
+            shutdown(q->fd, SHUT_RDWR);
+        }
+        pthread_mutex_unlock(&q->mutex);
+        return -1;
     }
+    rec->offset = written;
 
-    pthread_mutex_unlock(writeMutexHook);
+    if (q->tail == NULL) {
+        q->head = rec;
+        // first queued record: wait for the socket to drain
+        rilEventAddWakeup(&q->write_event);
+    } else {
+        q->tail->p_next = rec;
+    }
+    q->tail = rec;
+    q->bytes += total - written;
+    if (q->bytes > q->highWater) {
+        q->highWater = q->bytes;
+    }
+
+    pthread_mutex_unlock(&q->mutex);
 
     return 0;
 }
 
 static int
-sendResponse (Parcel &p, RIL_SOCKET_ID socket_id) {
+sendResponseRaw (const void *data, size_t dataSize, RIL_SOCKET_ID socket_id,
+        uint32_t connection) {
+    return sendRecord(data, dataSize, socket_id, connection, 0, DONT_KEEP);
+}
+
+static int
+sendResponse (Parcel &p, RIL_SOCKET_ID socket_id, uint32_t connection) {
+    printResponse;
+    return sendResponseRaw(p.data(), p.dataSize(), socket_id, connection);
+}
+
+static int
+sendUnsolicitedResponse (Parcel &p, RIL_SOCKET_ID socket_id,
+        UnsolResponseInfo *pUI) {
     printResponse;
-    return sendResponseRaw(p.data(), p.dataSize(), socket_id);
+    return sendRecord(p.data(), p.dataSize(), socket_id, 0,
+            pUI->requestNumber, pUI->policy);
 }
 
 /** response is an int* pointing to an array of ints */
@@ -3160,6 +4427,14 @@ static void rilEventAddWakeup(struct ril_event *ev) {
     triggerEvLoop();
 }
 
+// With timerfd the timer wakes the loop itself; otherwise poke it
+static void rilTimerAddWakeup(struct ril_event *ev, struct timeval *tv) {
+    ril_timer_add(ev, tv);
+    if (!ril_timer_wakes_loop()) {
+        triggerEvLoop();
+    }
+}
+
 static void sendSimStatusAppInfo(Parcel &p, int num_apps, RIL_AppStatus appStatus[]) {
         p.writeInt32(num_apps);
         startResponse;
@@ -3339,77 +4614,311 @@ static int responseDcRtInfo(Parcel &p, void *response, size_t responselen)
         return RIL_ERRNO_INVALID_RESPONSE;
     }
 
-    startResponse;
-    RIL_DcRtInfo *pDcRtInfo = (RIL_DcRtInfo *)response;
-    p.writeInt64(pDcRtInfo->time);
-    p.writeInt32(pDcRtInfo->powerState);
-    appendPrintBuf("%s[time=%d,powerState=%d]", printBuf,
-        pDcRtInfo->time,
-        pDcRtInfo->powerState);
-    closeResponse;
+    startResponse;
+    RIL_DcRtInfo *pDcRtInfo = (RIL_DcRtInfo *)response;
+    p.writeInt64(pDcRtInfo->time);
+    p.writeInt32(pDcRtInfo->powerState);
+    appendPrintBuf("%s[time=%d,powerState=%d]", printBuf,
+        pDcRtInfo->time,
+        pDcRtInfo->powerState);
+    closeResponse;
+
+    return 0;
+}
+
+/**
+ * A write on the wakeup fd is done just to pop us out of select()
+ * We empty the buffer here and then ril_event will reset the timers on the
+ * way back down
+ */
+static void processWakeupCallback(int fd, short flags, void *param) {
+    char buff[16];
+    int ret;
+
+    RLOGV("processWakeupCallback");
+
+    /* empty our wakeup socket out */
+    do {
+        ret = read(s_fdWakeupRead, &buff, sizeof(buff));
+    } while (ret > 0 || (ret < 0 && errno == EINTR));
+}
+
+static void onCommandsSocketClosed(RIL_SOCKET_ID socket_id) {
+    int ret;
+    PendingRequests *pending = &s_pendingRequests[socket_id];
+
+    /* mark pending requests as "cancelled" so we dont report responses */
+    ret = pthread_mutex_lock(&pending->mutex);
+    assert (ret == 0);
+
+    for (uint32_t i = 0; i < pending->size; i++) {
+        if (pending->slots[i].pRI != NULL) {
+            pending->slots[i].pRI->cancelled = 1;
+        }
+    }
+
+    ret = pthread_mutex_unlock(&pending->mutex);
+    assert (ret == 0);
+}
+
+// Drop commands that were read but not dispatched. Called with the lock held.
+static void
+commandQueueDiscard(SocketListenParam *p_info) {
+    CommandRecord *rec;
+
+    while ((rec = p_info->head) != NULL) {
+        p_info->head = rec->p_next;
+        free(rec);
+    }
+    p_info->tail = NULL;
+    p_info->bytes = 0;
+}
+
+/**
+ * Append rec behind the last record of the same or higher priority, so
+ * each priority stays in arrival order. Usually that is the tail.
+ */
+static void
+commandListInsert(CommandRecord **p_head, CommandRecord **p_tail, CommandRecord *rec) {
+    CommandRecord **pp = p_head;
+
+    if (*p_tail == NULL || (*p_tail)->priority >= rec->priority) {
+        pp = *p_tail != NULL ? &(*p_tail)->p_next : p_head;
+    } else {
+        while ((*pp)->priority >= rec->priority) {
+            pp = &(*pp)->p_next;
+        }
+    }
+    rec->p_next = *pp;
+    *pp = rec;
+    if (rec->p_next == NULL) {
+        *p_tail = rec;
+    }
+}
+
+static void
+commandQueuePut(SocketListenParam *p_info, void *data, size_t len,
+        uint32_t connection) {
+    CommandRecord *rec = (CommandRecord *)malloc(sizeof(CommandRecord) + len);
+
+    if (rec == NULL) {
+        RLOGE("out of memory queueing a command for %s",
+                rilSocketIdToString(p_info->socket_id));
+        return;
+    }
+    rec->p_next = NULL;
+    rec->len = len;
+    rec->data = (uint8_t *)(rec + 1);
+    memcpy(rec->data, data, len);
+
+    // The request number is the first field of the parcel
+    rec->request = -1;
+    if (len >= sizeof(rec->request)) {
+        memcpy(&rec->request, rec->data, sizeof(rec->request));
+    }
+    rec->priority = requestPriorityOf(rec->request);
+    rec->connection = connection;
+
+    pthread_mutex_lock(&p_info->mutex);
+
+    commandListInsert(&p_info->head, &p_info->tail, rec);
+    p_info->bytes += len;
+    pthread_cond_signal(&p_info->cond);
+
+    pthread_mutex_unlock(&p_info->mutex);
+}
+
+/**
+ * Hand a command to the worker pool, waiting while the socket already has
+ * COMMAND_QUEUE_MAX_BYTES queued so reading the socket pauses in turn.
+ * The worker frees rec.
+ */
+static void
+requestWorkersPut(RIL_SOCKET_ID socket_id, CommandRecord *rec) {
+    RequestWorkers *w = &s_requestWorkers;
+    RequestQueue *q = &w->queues[socket_id][requestClassOf(rec->request)];
+
+    pthread_mutex_lock(&w->mutex);
+
+    if (w->bytes[socket_id] > COMMAND_QUEUE_MAX_BYTES) {
+        w->stalls++;
+        do {
+            pthread_cond_wait(&w->spaceCond, &w->mutex);
+        } while (w->bytes[socket_id] > COMMAND_QUEUE_MAX_BYTES);
+    }
+
+    commandListInsert(&q->head, &q->tail, rec);
+    w->bytes[socket_id] += rec->len;
+    pthread_cond_signal(&w->workCond);
+
+    pthread_mutex_unlock(&w->mutex);
+}
+
+// Drop the socket's commands not yet taken by a worker
+static void
+requestWorkersDiscard(RIL_SOCKET_ID socket_id) {
+    RequestWorkers *w = &s_requestWorkers;
+    CommandRecord *rec;
+
+    pthread_mutex_lock(&w->mutex);
+
+    for (int c = 0; c < REQUEST_CLASS_COUNT; c++) {
+        RequestQueue *q = &w->queues[socket_id][c];
+
+        while ((rec = q->head) != NULL) {
+            q->head = rec->p_next;
+            free(rec);
+        }
+        q->tail = NULL;
+    }
+    w->bytes[socket_id] = 0;
+    pthread_cond_broadcast(&w->spaceCond);
+
+    pthread_mutex_unlock(&w->mutex);
+}
+
+/**
+ * Find the next command to run, or NULL. Classes below DATA never take
+ * the last idle worker, which stays free for calls, SMS, SIM and data.
+ * Called with the lock held.
+ */
+static CommandRecord *
+requestWorkersTake(RequestWorkers *w, RIL_SOCKET_ID *p_socket_id, int *p_class) {
+    for (int c = 0; c < REQUEST_CLASS_COUNT; c++) {
+        if (c > REQUEST_CLASS_DATA && w->count > 1 && w->busy + 1 >= w->count) {
+            break;
+        }
+        for (int i = 0; i < s_simCount; i++) {
+            int socket_id = (w->nextSocket + i) % s_simCount;
+            RequestQueue *q = &w->queues[socket_id][c];
+            CommandRecord *rec = q->head;
+
+            if (rec == NULL || q->busy) {
+                continue;
+            }
+            q->head = rec->p_next;
+            if (q->head == NULL) {
+                q->tail = NULL;
+            }
+            q->busy = true;
+            w->bytes[socket_id] -= rec->len;
+            w->nextSocket = (socket_id + 1) % s_simCount;
+            w->started[c]++;
+            *p_socket_id = (RIL_SOCKET_ID)socket_id;
+            *p_class = c;
+            return rec;
+        }
+    }
+    return NULL;
+}
+
+static void *
+requestWorkerLoop(void *param) {
+    RequestWorkers *w = &s_requestWorkers;
+    RIL_SOCKET_ID socket_id;
+    CommandRecord *rec;
+    int requestClass;
+
+    pthread_mutex_lock(&w->mutex);
+
+    for (;;) {
+        while ((rec = requestWorkersTake(w, &socket_id, &requestClass)) == NULL) {
+            pthread_cond_wait(&w->workCond, &w->mutex);
+        }
+        w->busy++;
+        pthread_cond_broadcast(&w->spaceCond);
+
+        pthread_mutex_unlock(&w->mutex);
 
-    return 0;
-}
+        processCommandBuffer(rec->data, rec->len, socket_id, rec->connection);
+        free(rec);
 
-/**
- * A write on the wakeup fd is done just to pop us out of select()
- * We empty the buffer here and then ril_event will reset the timers on the
- * way back down
- */
-static void processWakeupCallback(int fd, short flags, void *param) {
-    char buff[16];
-    int ret;
+        pthread_mutex_lock(&w->mutex);
 
-    RLOGV("processWakeupCallback");
+        w->busy--;
+        w->queues[socket_id][requestClass].busy = false;
+        // The finished queue, or one held back for the idle worker, can run
+        pthread_cond_broadcast(&w->workCond);
+    }
 
-    /* empty our wakeup socket out */
-    do {
-        ret = read(s_fdWakeupRead, &buff, sizeof(buff));
-    } while (ret > 0 || (ret < 0 && errno == EINTR));
+    return NULL;
 }
 
-static void onCommandsSocketClosed(RIL_SOCKET_ID socket_id) {
+static void
+startRequestWorkers(int count) {
+    RequestWorkers *w = &s_requestWorkers;
+    pthread_attr_t attr;
+    pthread_t tid;
     int ret;
-    RequestInfo *p_cur;
-    /* Hook for current context
-       pendingRequestsMutextHook refer to &s_pendingRequestsMutex */
-    pthread_mutex_t * pendingRequestsMutexHook = &s_pendingRequestsMutex;
-    /* pendingRequestsHook refer to &s_pendingRequests */
-    RequestInfo **    pendingRequestsHook = &s_pendingRequests;
 
-#if (SIM_COUNT >= 2)
-    if (socket_id == RIL_SOCKET_2) {
-        pendingRequestsMutexHook = &s_pendingRequestsMutex_socket2;
-        pendingRequestsHook = &s_pendingRequests_socket2;
-    }
-#if (SIM_COUNT >= 3)
-    else if (socket_id == RIL_SOCKET_3) {
-        pendingRequestsMutexHook = &s_pendingRequestsMutex_socket3;
-        pendingRequestsHook = &s_pendingRequests_socket3;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    for (int i = 0; i < count; i++) {
+        ret = pthread_create(&tid, &attr, requestWorkerLoop, NULL);
+        if (ret != 0) {
+            RLOGE("Failed to create request worker: %s", strerror(ret));
+            break;
+        }
+        pthread_mutex_lock(&w->mutex);
+        w->count++;
+        pthread_mutex_unlock(&w->mutex);
     }
-#endif
-#if (SIM_COUNT >= 4)
-    else if (socket_id == RIL_SOCKET_4) {
-        pendingRequestsMutexHook = &s_pendingRequestsMutex_socket4;
-        pendingRequestsHook = &s_pendingRequests_socket4;
+    RLOGI("%d request workers", w->count);
+}
+
+/**
+ * Per-socket dispatch thread: runs the commands read by
+ * processCommandsCallback() in priority order, or passes them to the request
+ * workers, and resumes reading the socket once a paused queue has
+ * drained by half.
+ */
+static void *
+commandDispatchLoop(void *param) {
+    SocketListenParam *p_info = (SocketListenParam *)param;
+    CommandRecord *rec;
+    bool resume;
+
+    pthread_mutex_lock(&s_registerMutex);
+    while (!s_registerDone) {
+        pthread_cond_wait(&s_registerCond, &s_registerMutex);
     }
-#endif
-#endif
-    /* mark pending requests as "cancelled" so we dont report responses */
-    ret = pthread_mutex_lock(pendingRequestsMutexHook);
-    assert (ret == 0);
+    pthread_mutex_unlock(&s_registerMutex);
+
+    for (;;) {
+        pthread_mutex_lock(&p_info->mutex);
+
+        while (p_info->head == NULL) {
+            pthread_cond_wait(&p_info->cond, &p_info->mutex);
+        }
+        rec = p_info->head;
+        p_info->head = rec->p_next;
+        if (p_info->head == NULL) {
+            p_info->tail = NULL;
+        }
+        p_info->bytes -= rec->len;
+
+        resume = p_info->paused && p_info->bytes <= COMMAND_QUEUE_MAX_BYTES / 2;
+        if (resume) {
+            p_info->paused = false;
+        }
+
+        pthread_mutex_unlock(&p_info->mutex);
 
-    p_cur = *pendingRequestsHook;
+        if (resume) {
+            rilEventAddWakeup(&p_info->commands_event);
+        }
 
-    for (p_cur = *pendingRequestsHook
-            ; p_cur != NULL
-            ; p_cur  = p_cur->p_next
-    ) {
-        p_cur->cancelled = 1;
+        if (s_requestWorkers.count > 0) {
+            requestWorkersPut(p_info->socket_id, rec);
+        } else {
+            processCommandBuffer(rec->data, rec->len, p_info->socket_id,
+                    rec->connection);
+            free(rec);
+        }
     }
 
-    ret = pthread_mutex_unlock(pendingRequestsMutexHook);
-    assert (ret == 0);
+    return NULL;
 }
 
 static void processCommandsCallback(int fd, short flags, void *param) {
@@ -3417,11 +4926,13 @@ static void processCommandsCallback(int fd, short flags, void *param) {
     void *p_record;
     size_t recordlen;
     int ret;
+    uint32_t connection;
     SocketListenParam *p_info = (SocketListenParam *)param;
 
     assert(fd == p_info->fdCommand);
 
     p_rs = p_info->p_rs;
+    connection = outQueueConnection(p_info->socket_id);
 
     for (;;) {
         /* loop until EAGAIN/EINTR, end of stream, or other error */
@@ -3430,10 +4941,15 @@ static void processCommandsCallback(int fd, short flags, void *param) {
         if (ret == 0 && p_record == NULL) {
             /* end-of-stream */
             break;
+        } else if (ret < 0 && errno == EFBIG) {
+            /* the record stream discards it and carries on */
+            RLOGE("%s: dropping command larger than %u bytes",
+                    rilSocketIdToString(p_info->socket_id), MAX_COMMAND_BYTES);
         } else if (ret < 0) {
             break;
         } else if (ret == 0) { /* && p_record != NULL */
-            processCommandBuffer(p_record, recordlen, p_info->socket_id);
+            bootPhaseOnce(&s_bootFirstRequest, "first request");
+            commandQueuePut(p_info, p_record, recordlen, connection);
         }
     }
 
@@ -3445,18 +4961,42 @@ static void processCommandsCallback(int fd, short flags, void *param) {
             RLOGW("EOS.  Closing command socket.");
         }
 
+        outQueueDetach(p_info->socket_id);
+
         close(fd);
         p_info->fdCommand = -1;
 
-        ril_event_del(p_info->commands_event);
+        ril_event_del(&p_info->commands_event);
 
         record_stream_free(p_rs);
 
+        pthread_mutex_lock(&p_info->mutex);
+        commandQueueDiscard(p_info);
+        pthread_mutex_unlock(&p_info->mutex);
+
+        pthread_mutex_lock(&s_registerMutex);
+        p_info->connectPending = false;
+        pthread_mutex_unlock(&s_registerMutex);
+        requestWorkersDiscard(p_info->socket_id);
+
         /* start listening for new connections again */
-        rilEventAddWakeup(&s_listen_event);
+        rilEventAddWakeup(&p_info->listen_event);
 
         onCommandsSocketClosed(p_info->socket_id);
+        return;
+    }
+
+    // Stop reading a client that outruns its dispatch thread. Checked only
+    // after draining the record stream so no record is left in its buffer.
+    pthread_mutex_lock(&p_info->mutex);
+    if (p_info->bytes > COMMAND_QUEUE_MAX_BYTES) {
+        RLOGW("%s: %u command bytes queued, pausing reads",
+                rilSocketIdToString(p_info->socket_id),
+                (unsigned int)p_info->bytes);
+        p_info->paused = true;
+        ril_event_del(&p_info->commands_event);
     }
+    pthread_mutex_unlock(&p_info->mutex);
 }
 
 
@@ -3465,18 +5005,14 @@ static void onNewCommandConnect(RIL_SOCKET_ID socket_id) {
     int rilVer = s_callbacks.version;
     RIL_UNSOL_RESPONSE(RIL_UNSOL_RIL_CONNECTED,
                                     &rilVer, sizeof(rilVer), socket_id);
+    bootPhaseOnce(&s_bootFirstConnected, "RIL_CONNECTED");
 
     // implicit radio state changed
     RIL_UNSOL_RESPONSE(RIL_UNSOL_RESPONSE_RADIO_STATE_CHANGED,
                                     NULL, 0, socket_id);
 
-    // Send last NITZ time data, in case it was missed
-    if (s_lastNITZTimeData != NULL) {
-        sendResponseRaw(s_lastNITZTimeData, s_lastNITZTimeDataSize, socket_id);
-
-        free(s_lastNITZTimeData);
-        s_lastNITZTimeData = NULL;
-    }
+    // Send what was missed while disconnected, such as the last NITZ time
+    outQueueReplay(socket_id);
 
     // Get version string
     if (s_callbacks.getVersion != NULL) {
@@ -3508,15 +5044,15 @@ static void listenCallback (int fd, short flags, void *param) {
 
     struct passwd *pwd = NULL;
 
-    assert (*p_info->fdCommand < 0);
-    assert (fd == *p_info->fdListen);
+    assert (p_info->fdCommand < 0);
+    assert (fd == p_info->fdListen);
 
     fdCommand = accept(fd, (sockaddr *) &peeraddr, &socklen);
 
     if (fdCommand < 0 ) {
         RLOGE("Error on accept() errno:%d", errno);
         /* start listening for new connections again */
-        rilEventAddWakeup(p_info->listen_event);
+        rilEventAddWakeup(&p_info->listen_event);
         return;
     }
 
@@ -3553,7 +5089,7 @@ static void listenCallback (int fd, short flags, void *param) {
       onCommandsSocketClosed(p_info->socket_id);
 
       /* start listening for new connections again */
-      rilEventAddWakeup(p_info->listen_event);
+      rilEventAddWakeup(&p_info->listen_event);
 
       return;
     }
@@ -3568,16 +5104,153 @@ static void listenCallback (int fd, short flags, void *param) {
 
     p_info->fdCommand = fdCommand;
 
+    outQueueAttach(p_info->socket_id, p_info->fdCommand);
+
     p_rs = record_stream_new(p_info->fdCommand, MAX_COMMAND_BYTES);
 
     p_info->p_rs = p_rs;
 
-    ril_event_set (p_info->commands_event, p_info->fdCommand, 1,
+    ril_event_set (&p_info->commands_event, p_info->fdCommand, 1,
         p_info->processCommandsCallback, p_info);
 
-    rilEventAddWakeup (p_info->commands_event);
+    rilEventAddWakeup (&p_info->commands_event);
+
+    bootPhaseOnce(&s_bootFirstConnect, "client connected");
+
+    pthread_mutex_lock(&s_registerMutex);
+    bool registered = s_registerDone;
+    p_info->connectPending = !registered;
+    pthread_mutex_unlock(&s_registerMutex);
+
+    if (registered) {
+        onNewCommandConnect(p_info->socket_id);
+    } else {
+        RLOGI("%s: RIL_CONNECTED follows RIL_register",
+                rilSocketIdToString(p_info->socket_id));
+    }
+}
+
+static void debugPrintf(int fd, const char *fmt, ...) {
+    char buf[256];
+    va_list ap;
+    int len;
+
+    va_start(ap, fmt);
+    len = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+
+    if (len >= (int)sizeof(buf)) {
+        len = sizeof(buf) - 1;
+    }
+    if (len > 0 && write(fd, buf, len) < 0) {
+        RLOGE("error writing on debug port: %d", errno);
+    }
+}
+
+static void dumpStats(int fd) {
+    uint64_t now = ril_nano_time();
+    uint64_t elapsedMs = (now - s_statsDumpNs) / 1000000;
+
+    debugPrintf(fd, "request latency (us): vendor p50/p90/p99/max, libril mean/max,"
+            " deadline misses, collapsed into another\n");
+    for (size_t i = 0; i < NUM_ELEMS(s_commands); i++) {
+        RequestStats *stats = &s_requestStats[i];
+        uint32_t total = __atomic_load_n(&stats->vendor.total, __ATOMIC_RELAXED);
+
+        if (total == 0) {
+            continue;
+        }
+        debugPrintf(fd, "  %s: n=%u vendor=%llu/%llu/%llu/%u libril=%llu/%u missed=%u collapsed=%u\n",
+                requestToString(s_commands[i].requestNumber), total,
+                (unsigned long long)ril_histogram_percentile(&stats->vendor, 50),
+                (unsigned long long)ril_histogram_percentile(&stats->vendor, 90),
+                (unsigned long long)ril_histogram_percentile(&stats->vendor, 99),
+                __atomic_load_n(&stats->vendor.maxUs, __ATOMIC_RELAXED),
+                (unsigned long long)(__atomic_load_n(&stats->librilSumUs,
+                        __ATOMIC_RELAXED) / total),
+                __atomic_load_n(&stats->librilMaxUs, __ATOMIC_RELAXED),
+                __atomic_load_n(&stats->deadlineMisses, __ATOMIC_RELAXED),
+                __atomic_load_n(&stats->collapsed, __ATOMIC_RELAXED));
+    }
+
+    struct ril_wake_lock_stats wake;
+    ril_wake_lock_get_stats(&wake);
+    debugPrintf(fd, "wake lock: %u refs (max %u), %u acquisitions for %u"
+            " references and %u holds, held %llums (max %llums)\n",
+            wake.refs, wake.maxRefs, wake.acquisitions, wake.references,
+            wake.holds, (unsigned long long)(wake.heldNs / 1000000),
+            (unsigned long long)(wake.maxHeldNs / 1000000));
+
+    if (s_requestWorkers.count > 0) {
+        RequestWorkers *w = &s_requestWorkers;
+
+        pthread_mutex_lock(&w->mutex);
+        debugPrintf(fd, "request workers: %d busy of %d, %u stalls, started",
+                w->busy, w->count, w->stalls);
+        for (int c = 0; c < REQUEST_CLASS_COUNT; c++) {
+            debugPrintf(fd, " %s=%u", requestClassToString(c), w->started[c]);
+        }
+        debugPrintf(fd, "\n");
+        pthread_mutex_unlock(&w->mutex);
+    }
+
+    debugPrintf(fd, "boot:");
+    for (uint32_t i = 0; i < BOOT_PHASES_MAX; i++) {
+        const char *phase = __atomic_load_n(&s_bootPhaseNames[i], __ATOMIC_ACQUIRE);
+
+        if (phase != NULL) {
+            debugPrintf(fd, " %s +%llums", phase,
+                    (unsigned long long)(s_bootPhaseNs[i] - s_bootPhaseNs[0]) / 1000000);
+        }
+    }
+    debugPrintf(fd, "\n");
+
+    debugPrintf(fd, "response cache: hits/misses per socket\n");
+    pthread_mutex_lock(&s_responseCacheMutex);
+    for (size_t i = 0; i < NUM_ELEMS(s_cachePolicies); i++) {
+        debugPrintf(fd, "  %s:", requestToString(s_cachePolicies[i].requestNumber));
+        for (int j = 0; j < s_simCount; j++) {
+            debugPrintf(fd, " %u/%u", s_responseCache[j][i].hits,
+                    s_responseCache[j][i].misses);
+        }
+        debugPrintf(fd, "\n");
+    }
+    pthread_mutex_unlock(&s_responseCacheMutex);
+
+    for (int i = 0; i < SIM_COUNT; i++) {
+        PendingRequests *pending = &s_pendingRequests[i];
+        OutQueue *q = &s_outQueue[i];
+
+        pthread_mutex_lock(&pending->mutex);
+        debugPrintf(fd, "%s: in flight %u (high %u)",
+                rilSocketIdToString((RIL_SOCKET_ID)i),
+                pending->count, pending->highWater);
+        pthread_mutex_unlock(&pending->mutex);
+
+        pthread_mutex_lock(&q->mutex);
+        debugPrintf(fd, ", out queue %u bytes (high %u), coalesced %u,"
+                " replay %u bytes\n",
+                (unsigned int)q->bytes, (unsigned int)q->highWater,
+                q->coalesced, (unsigned int)q->replayBytes);
+        pthread_mutex_unlock(&q->mutex);
+    }
+
+    debugPrintf(fd, "unsolicited: total, per second over the last %llums\n",
+            (unsigned long long)elapsedMs);
+    for (size_t i = 0; i < NUM_ELEMS(s_unsolResponses); i++) {
+        uint32_t count = __atomic_load_n(&s_unsolCount[i], __ATOMIC_RELAXED);
+        uint32_t delta = count - s_unsolCountAtDump[i];
 
-    onNewCommandConnect(p_info->socket_id);
+        s_unsolCountAtDump[i] = count;
+        if (count == 0) {
+            continue;
+        }
+        debugPrintf(fd, "  %s: %u %llu.%02llu\n",
+                requestToString(s_unsolResponses[i].requestNumber), count,
+                elapsedMs ? (unsigned long long)delta * 1000 / elapsedMs : 0ULL,
+                elapsedMs ? (unsigned long long)delta * 100000 / elapsedMs % 100 : 0ULL);
+    }
+    s_statsDumpNs = now;
 }
 
 static void freeDebugCallbackArgs(int number, char **args) {
@@ -3639,28 +5312,10 @@ static void debugCallback (int fd, short flags, void *param) {
         if ((i+1) == number) {
             /* The last argument should be sim id 0(SIM1)~3(SIM4) */
             sim_id = atoi(args[i]);
-            switch (sim_id) {
-                case 0:
-                    socket_id = RIL_SOCKET_1;
-                    break;
-            #if (SIM_COUNT >= 2)
-                case 1:
-                    socket_id = RIL_SOCKET_2;
-                    break;
-            #endif
-            #if (SIM_COUNT >= 3)
-                case 2:
-                    socket_id = RIL_SOCKET_3;
-                    break;
-            #endif
-            #if (SIM_COUNT >= 4)
-                case 3:
-                    socket_id = RIL_SOCKET_4;
-                    break;
-            #endif
-                default:
-                    socket_id = RIL_SOCKET_1;
-                    break;
+            if (sim_id >= 0 && sim_id < s_simCount) {
+                socket_id = (RIL_SOCKET_ID)sim_id;
+            } else {
+                socket_id = RIL_SOCKET_1;
             }
         }
     }
@@ -3674,17 +5329,10 @@ static void debugCallback (int fd, short flags, void *param) {
             RLOGI ("Connection on debug port: issuing radio power off.");
             data = 0;
             issueLocalRequest(RIL_REQUEST_RADIO_POWER, &data, sizeof(int), socket_id);
-            // Close the socket
-            if (socket_id == RIL_SOCKET_1 && s_ril_param_socket.fdCommand > 0) {
-                close(s_ril_param_socket.fdCommand);
-                s_ril_param_socket.fdCommand = -1;
-            }
-        #if (SIM_COUNT == 2)
-            else if (socket_id == RIL_SOCKET_2 && s_ril_param_socket2.fdCommand > 0) {
-                close(s_ril_param_socket2.fdCommand);
-                s_ril_param_socket2.fdCommand = -1;
+            // Shut the socket down; the reader sees EOS and closes it
+            if (s_ril_param_socket[socket_id].fdCommand > 0) {
+                shutdown(s_ril_param_socket[socket_id].fdCommand, SHUT_RDWR);
             }
-        #endif
             break;
         case 2:
             RLOGI ("Debug port: issuing unsolicited voice network change.");
@@ -3746,6 +5394,23 @@ static void debugCallback (int fd, short flags, void *param) {
             issueLocalRequest(RIL_REQUEST_HANGUP, &hangupData,
                               sizeof(hangupData), socket_id);
             break;
+        case 11:
+            RLOGI("Debug port: Dump pool stats");
+            ril_pool_dump(&s_requestInfoPool, acceptFD);
+            ril_pool_dump(&s_userCallbackPool, acceptFD);
+            break;
+        case 12:
+            RLOGI("Debug port: Dump request trace");
+            ril_trace_dump(acceptFD);
+            break;
+        case 13:
+            RLOGI("Debug port: Dump raw request trace");
+            ril_trace_dump_raw(acceptFD);
+            break;
+        case 14:
+            RLOGI("Debug port: Dump request stats");
+            dumpStats(acceptFD);
+            break;
         default:
             RLOGE ("Invalid request");
             break;
@@ -3760,15 +5425,11 @@ static void userTimerCallback (int fd, short flags, void *param) {
 
     p_info = (UserCallbackInfo *)param;
 
+    VENDOR_LOCK();
     p_info->p_callback(p_info->userParam);
+    VENDOR_UNLOCK();
 
-
-    // FIXME generalize this...there should be a cancel mechanism
-    if (s_last_wake_timeout_info != NULL && s_last_wake_timeout_info == p_info) {
-        s_last_wake_timeout_info = NULL;
-    }
-
-    free(p_info);
+    ril_pool_free(&s_userCallbackPool, p_info);
 }
 
 
@@ -3779,6 +5440,9 @@ eventLoop(void *param) {
 
     ril_event_init();
 
+    // Rescheduled on every WAKE_PARTIAL unsolicited; see RIL_onUnsolicitedResponse
+    ril_event_set(&s_wake_timeout_event, -1, false, wakeTimeoutCallback, NULL);
+
     pthread_mutex_lock(&s_startupMutex);
 
     s_started = 1;
@@ -3812,8 +5476,57 @@ eventLoop(void *param) {
     return NULL;
 }
 
+static void startListen(RIL_SOCKET_ID socket_id, SocketListenParam* socket_listen_p);
+static int getSimCount();
+
+/**
+ * Start the dispatch thread of each command socket and listen on it.
+ * Called once the event loop runs, before RIL_register().
+ */
+static void
+startCommandSockets() {
+    int ret;
+
+    s_simCount = getSimCount();
+    RLOGI("serving %d of %d sockets", s_simCount, SIM_COUNT);
+
+    for (int i = 0; i < s_simCount; i++) {
+        SocketListenParam *p_info = &s_ril_param_socket[i];
+        pthread_attr_t attr;
+
+        p_info->socket_id = (RIL_SOCKET_ID)i;
+        p_info->fdListen = -1;
+        p_info->fdCommand = -1;
+        p_info->processName = (char *)PHONE_PROCESS;
+        p_info->processCommandsCallback = processCommandsCallback;
+        p_info->p_rs = NULL;
+        pthread_mutex_init(&p_info->mutex, NULL);
+        pthread_cond_init(&p_info->cond, NULL);
+
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+        ret = pthread_create(&p_info->tid_dispatch, &attr,
+                commandDispatchLoop, p_info);
+        if (ret != 0) {
+            RLOGE("Failed to create dispatch thread for %s: %s",
+                    rilSocketIdToString(p_info->socket_id), strerror(ret));
+            continue;
+        }
+
+        startListen(p_info->socket_id, p_info);
+    }
+    RIL_bootPhase("listening");
+}
+
 extern "C" void
 RIL_startEventLoop(void) {
+    ril_pool_init(&s_requestInfoPool, "RequestInfo",
+            sizeof(RequestInfo), REQUEST_POOL_SIZE);
+    ril_pool_init(&s_userCallbackPool, "UserCallbackInfo",
+            sizeof(UserCallbackInfo), USER_CALLBACK_POOL_SIZE);
+    s_statsDumpNs = ril_nano_time();
+
     /* spin up eventLoop thread and wait for it to get started */
     s_started = 0;
     pthread_mutex_lock(&s_startupMutex);
@@ -3834,6 +5547,11 @@ RIL_startEventLoop(void) {
 
 done:
     pthread_mutex_unlock(&s_startupMutex);
+
+    if (s_started) {
+        RIL_bootPhase("event loop started");
+        startCommandSockets();
+    }
 }
 
 // Used for testing purpose only.
@@ -3890,10 +5608,34 @@ static void startListen(RIL_SOCKET_ID socket_id, SocketListenParam* socket_liste
     socket_listen_p->fdListen = fdListen;
 
     /* note: non-persistent so we can accept only one connection at a time */
-    ril_event_set (socket_listen_p->listen_event, fdListen, false,
+    ril_event_set (&socket_listen_p->listen_event, fdListen, false,
                 listenCallback, socket_listen_p);
 
-    rilEventAddWakeup (socket_listen_p->listen_event);
+    rilEventAddWakeup (&socket_listen_p->listen_event);
+}
+
+// Number of sockets to serve, from the multi-SIM configuration
+static int
+getSimCount() {
+    char config[PROPERTY_VALUE_MAX];
+    int count = SIM_COUNT;
+
+    if (property_get(PROPERTY_MULTISIM_CONFIG, config, "") > 0) {
+        if (strcmp(config, "dsds") == 0 || strcmp(config, "dsda") == 0) {
+            count = 2;
+        } else if (strcmp(config, "tsts") == 0) {
+            count = 3;
+        } else {
+            count = 1;
+        }
+    }
+
+    if (count > SIM_COUNT) {
+        RLOGW("%s needs %d sockets, built for %d",
+                PROPERTY_MULTISIM_CONFIG, count, SIM_COUNT);
+        count = SIM_COUNT;
+    }
+    return count;
 }
 
 extern "C" void
@@ -3927,76 +5669,34 @@ RIL_register (const RIL_RadioFunctions *callbacks) {
 
     memcpy(&s_callbacks, callbacks, sizeof (RIL_RadioFunctions));
 
-    /* Initialize socket1 parameters */
-    s_ril_param_socket = {
-                        RIL_SOCKET_1,             /* socket_id */
-                        -1,                       /* fdListen */
-                        -1,                       /* fdCommand */
-                        PHONE_PROCESS,            /* processName */
-                        &s_commands_event,        /* commands_event */
-                        &s_listen_event,          /* listen_event */
-                        processCommandsCallback,  /* processCommandsCallback */
-                        NULL                      /* p_rs */
-                        };
-
-#if (SIM_COUNT >= 2)
-    s_ril_param_socket2 = {
-                        RIL_SOCKET_2,               /* socket_id */
-                        -1,                         /* fdListen */
-                        -1,                         /* fdCommand */
-                        PHONE_PROCESS,              /* processName */
-                        &s_commands_event_socket2,  /* commands_event */
-                        &s_listen_event_socket2,    /* listen_event */
-                        processCommandsCallback,    /* processCommandsCallback */
-                        NULL                        /* p_rs */
-                        };
-#endif
-
-#if (SIM_COUNT >= 3)
-    s_ril_param_socket3 = {
-                        RIL_SOCKET_3,               /* socket_id */
-                        -1,                         /* fdListen */
-                        -1,                         /* fdCommand */
-                        PHONE_PROCESS,              /* processName */
-                        &s_commands_event_socket3,  /* commands_event */
-                        &s_listen_event_socket3,    /* listen_event */
-                        processCommandsCallback,    /* processCommandsCallback */
-                        NULL                        /* p_rs */
-                        };
-#endif
-
-#if (SIM_COUNT >= 4)
-    s_ril_param_socket4 = {
-                        RIL_SOCKET_4,               /* socket_id */
-                        -1,                         /* fdListen */
-                        -1,                         /* fdCommand */
-                        PHONE_PROCESS,              /* processName */
-                        &s_commands_event_socket4,  /* commands_event */
-                        &s_listen_event_socket4,    /* listen_event */
-                        processCommandsCallback,    /* processCommandsCallback */
-                        NULL                        /* p_rs */
-                        };
-#endif
-
-
     s_registerCalled = 1;
 
     RLOGI("s_registerCalled flag set, %d", s_started);
     // Little self-check
 
+    assert(NUM_ELEMS(s_commands)
+            == MAX_RIL_SOL + 1 + MAX_SAMSUNG_SOL - SAMSUNG_REQUEST_BASE + 1);
     for (int i = 0; i < (int)NUM_ELEMS(s_commands); i++) {
-        assert(i == s_commands[i].requestNumber);
+        assert(s_commands[i].dispatchFunction == NULL
+                || lookupCommand(s_commands[i].requestNumber) == &s_commands[i]);
+    }
+
+    for (int i = 0; i < (int)NUM_ELEMS(s_cachePolicies); i++) {
+        CommandInfo *pCI = lookupCommand(s_cachePolicies[i].requestNumber);
+        assert(pCI != NULL && pCI->collapse == COLLAPSE);
+    }
+    for (int i = 0; i < (int)NUM_ELEMS(s_collapseInvalidations); i++) {
+        CommandInfo *pCI = lookupCommand(s_collapseInvalidations[i].requestNumber);
+        assert(pCI != NULL && pCI->collapse == COLLAPSE);
     }
 
+    assert(NUM_ELEMS(s_unsolResponses)
+            == MAX_RIL_UNSOL - RIL_UNSOL_RESPONSE_BASE + 1
+                + MAX_SAMSUNG_UNSOL - SAMSUNG_UNSOL_RESPONSE_BASE + 1);
     for (int i = 0; i < (int)NUM_ELEMS(s_unsolResponses); i++) {
-        /* Hack to include Samsung responses */
-        if (i > MAX_RIL_UNSOL - RIL_UNSOL_RESPONSE_BASE) {
-            assert(i + SAMSUNG_UNSOL_RESPONSE_BASE - MAX_RIL_UNSOL
-                == s_unsolResponses[i].requestNumber);
-        } else {
-            assert(i + RIL_UNSOL_RESPONSE_BASE
-                == s_unsolResponses[i].requestNumber);
-        }
+        assert(s_unsolResponses[i].responseFunction == NULL
+                || lookupUnsolResponse(s_unsolResponses[i].requestNumber)
+                    == &s_unsolResponses[i]);
     }
 
     // New rild impl calls RIL_startEventLoop() first
@@ -4006,23 +5706,26 @@ RIL_register (const RIL_RadioFunctions *callbacks) {
         RIL_startEventLoop();
     }
 
-    // start listen socket1
-    startListen(RIL_SOCKET_1, &s_ril_param_socket);
-
-#if (SIM_COUNT >= 2)
-    // start listen socket2
-    startListen(RIL_SOCKET_2, &s_ril_param_socket2);
-#endif /* (SIM_COUNT == 2) */
+    if (RIL_REQUEST_WORKERS > 0) {
+        startRequestWorkers(RIL_REQUEST_WORKERS);
+    }
 
-#if (SIM_COUNT >= 3)
-    // start listen socket3
-    startListen(RIL_SOCKET_3, &s_ril_param_socket3);
-#endif /* (SIM_COUNT == 3) */
+    // Greet the clients that connected early, then let the dispatch
+    // threads run what was queued meanwhile, so RIL_CONNECTED goes out
+    // before any response. Holding the lock makes a client connecting
+    // meanwhile wait and then greet itself.
+    pthread_mutex_lock(&s_registerMutex);
+    for (int i = 0; i < s_simCount; i++) {
+        if (s_ril_param_socket[i].connectPending) {
+            s_ril_param_socket[i].connectPending = false;
+            onNewCommandConnect((RIL_SOCKET_ID)i);
+        }
+    }
+    s_registerDone = true;
+    pthread_cond_broadcast(&s_registerCond);
+    pthread_mutex_unlock(&s_registerMutex);
 
-#if (SIM_COUNT >= 4)
-    // start listen socket4
-    startListen(RIL_SOCKET_4, &s_ril_param_socket4);
-#endif /* (SIM_COUNT == 4) */
+    RIL_bootPhase("RIL_register");
 
 
 #if 1
@@ -4060,94 +5763,109 @@ RIL_register (const RIL_RadioFunctions *callbacks) {
 
 }
 
-static int
-checkAndDequeueRequestInfo(struct RequestInfo *pRI) {
-    int ret = 0;
-    /* Hook for current context
-       pendingRequestsMutextHook refer to &s_pendingRequestsMutex */
-    pthread_mutex_t* pendingRequestsMutexHook = &s_pendingRequestsMutex;
-    /* pendingRequestsHook refer to &s_pendingRequests */
-    RequestInfo ** pendingRequestsHook = &s_pendingRequests;
-
-    if (pRI == NULL) {
-        return 0;
+/**
+ * Looks up the request behind a RIL_Token and removes it from its pending
+ * table. Returns NULL if the token is unknown or was already completed.
+ * expired marks the token as failed by its deadline, see tokenExpired().
+ */
+static RequestInfo *
+checkAndDequeueRequestInfo(RIL_Token t, bool expired) {
+    uint32_t handle = (uint32_t)(uintptr_t)t;
+    uint32_t socket_id = handle >> PENDING_SOCKET_SHIFT;
+    uint32_t generation = (handle >> PENDING_SLOT_BITS) & PENDING_GEN_MASK;
+    uint32_t slot = handle & PENDING_SLOT_MASK;
+    PendingRequests *pending;
+    RequestInfo *pRI = NULL;
+
+    if ((uintptr_t)t != handle || socket_id >= SIM_COUNT) {
+        return NULL;
     }
+    pending = &s_pendingRequests[socket_id];
 
-#if (SIM_COUNT >= 2)
-    if (pRI->socket_id == RIL_SOCKET_2) {
-        pendingRequestsMutexHook = &s_pendingRequestsMutex_socket2;
-        pendingRequestsHook = &s_pendingRequests_socket2;
-    }
-#if (SIM_COUNT >= 3)
-        if (pRI->socket_id == RIL_SOCKET_3) {
-            pendingRequestsMutexHook = &s_pendingRequestsMutex_socket3;
-            pendingRequestsHook = &s_pendingRequests_socket3;
+    pthread_mutex_lock(&pending->mutex);
+
+    if (slot < pending->size && pending->slots[slot].pRI != NULL
+            && pending->slots[slot].generation == generation) {
+        pRI = pending->slots[slot].pRI;
+        pending->slots[slot].pRI = NULL;
+        if (expired) {
+            pending->slots[slot].expired = generation;
+        }
+        pending->slots[slot].generation =
+                (generation & PENDING_GEN_MASK) == PENDING_GEN_MASK ? 1 : generation + 1;
+        pending->slots[slot].nextFree = pending->freeHead;
+        pending->freeHead = slot;
+        pending->count--;
+
+        // No more followers once it is off the collapsible list
+        if (pRI->collapsible) {
+            RequestInfo **pp = &pending->collapsible;
+
+            while (*pp != pRI) {
+                pp = &(*pp)->p_next;
+            }
+            *pp = pRI->p_next;
+            pRI->p_next = NULL;
         }
-#endif
-#if (SIM_COUNT >= 4)
-    if (pRI->socket_id == RIL_SOCKET_4) {
-        pendingRequestsMutexHook = &s_pendingRequestsMutex_socket4;
-        pendingRequestsHook = &s_pendingRequests_socket4;
     }
-#endif
-#endif
-    pthread_mutex_lock(pendingRequestsMutexHook);
 
-    for(RequestInfo **ppCur = pendingRequestsHook
-        ; *ppCur != NULL
-        ; ppCur = &((*ppCur)->p_next)
-    ) {
-        if (pRI == *ppCur) {
-            ret = 1;
+    pthread_mutex_unlock(&pending->mutex);
 
-            *ppCur = (*ppCur)->p_next;
-            break;
-        }
+    return pRI;
+}
+
+// Whether t was failed by its deadline, so a late completion is expected
+static bool
+tokenExpired(RIL_Token t) {
+    uint32_t handle = (uint32_t)(uintptr_t)t;
+    uint32_t socket_id = handle >> PENDING_SOCKET_SHIFT;
+    uint32_t generation = (handle >> PENDING_SLOT_BITS) & PENDING_GEN_MASK;
+    uint32_t slot = handle & PENDING_SLOT_MASK;
+    PendingRequests *pending;
+    bool expired;
+
+    if ((uintptr_t)t != handle || socket_id >= SIM_COUNT) {
+        return false;
     }
+    pending = &s_pendingRequests[socket_id];
 
-    pthread_mutex_unlock(pendingRequestsMutexHook);
+    pthread_mutex_lock(&pending->mutex);
+    expired = slot < pending->size && pending->slots[slot].expired == generation;
+    pthread_mutex_unlock(&pending->mutex);
 
-    return ret;
+    return expired;
 }
 
 
-extern "C" void
-RIL_onRequestComplete(RIL_Token t, RIL_Errno e, void *response, size_t responselen) {
-    RequestInfo *pRI;
+// Send the response for a request taken off its pending table and free it
+static void
+completeRequest(RequestInfo *pRI, RIL_Errno e, void *response, size_t responselen) {
     int ret;
-    int fd = s_ril_param_socket.fdCommand;
+    int fd;
     size_t errorOffset;
     RIL_SOCKET_ID socket_id = RIL_SOCKET_1;
+    uint64_t completeNs;
 
-    pRI = (RequestInfo *)t;
-
-    if (!checkAndDequeueRequestInfo(pRI)) {
-        RLOGE ("RIL_onRequestComplete: invalid RIL_Token");
-        return;
+    completeNs = ril_nano_time();
+    if (pRI->dispatchNs == 0) {
+        // completed by libril without calling onRequest
+        pRI->dispatchNs = completeNs;
     }
 
     socket_id = pRI->socket_id;
-#if (SIM_COUNT >= 2)
-    if (socket_id == RIL_SOCKET_2) {
-        fd = s_ril_param_socket2.fdCommand;
-    }
-#if (SIM_COUNT >= 3)
-        if (socket_id == RIL_SOCKET_3) {
-            fd = s_ril_param_socket3.fdCommand;
-        }
-#endif
-#if (SIM_COUNT >= 4)
-    if (socket_id == RIL_SOCKET_4) {
-        fd = s_ril_param_socket4.fdCommand;
-    }
-#endif
-#endif
+    fd = s_ril_param_socket[socket_id].fdCommand;
+#if RILC_LOG
     RLOGD("RequestComplete, %s", rilSocketIdToString(socket_id));
+#endif
+    ril_trace(RIL_TRACE_RESPONSE, socket_id, pRI->pCI->requestNumber,
+            pRI->local > 0 ? -1 : pRI->token, e, responselen);
 
     if (pRI->local > 0) {
         // Locally issued command...void only!
         // response does not go back up the command socket
+#if RILC_LOG
         RLOGD("C[locl]< %s", requestToString(pRI->pCI->requestNumber));
+#endif
 
         goto done;
     }
@@ -4155,8 +5873,13 @@ RIL_onRequestComplete(RIL_Token t, RIL_Errno e, void *response, size_t responsel
     appendPrintBuf("[%04d]< %s",
         pRI->token, requestToString(pRI->pCI->requestNumber));
 
+    responseCacheInvalidate(pRI->pCI->requestNumber, socket_id);
+    collapseInvalidate(pRI->pCI->requestNumber, socket_id);
+
     if (pRI->cancelled == 0) {
-        Parcel p;
+        uint32_t *sizeHint = solicitedSizeHint(pRI->pCI);
+        Parcel &p = *obtainParcel(sizeHint);
+        bool cacheable = (e == RIL_E_SUCCESS && pRI->collapsible);
 
         p.writeInt32 (RESPONSE_SOLICITED);
         p.writeInt32 (pRI->token);
@@ -4173,6 +5896,7 @@ RIL_onRequestComplete(RIL_Token t, RIL_Errno e, void *response, size_t responsel
                 RLOGE ("responseFunction error, ret %d", ret);
                 p.setDataPosition(errorOffset);
                 p.writeInt32 (ret);
+                cacheable = false;
             }
         }
 
@@ -4180,39 +5904,128 @@ RIL_onRequestComplete(RIL_Token t, RIL_Errno e, void *response, size_t responsel
             appendPrintBuf("%s fails by %s", printBuf, failCauseToString(e));
         }
 
+        int cacheIndex = cacheable ? responseCacheIndex(pRI->pCI->requestNumber) : -1;
+        if (cacheIndex >= 0) {
+            responseCacheStore(cacheIndex, pRI, p);
+        }
+
         if (fd < 0) {
             RLOGD ("RIL onRequestComplete: Command channel closed");
         }
-        sendResponse(p, socket_id);
+        sendResponse(p, socket_id, pRI->connection);
+
+        // Same response for the requests collapsed into this one, with
+        // their own serial in place of ours
+        for (RequestInfo *follower = pRI->followers; follower != NULL;
+                follower = follower->p_next) {
+            p.setDataPosition(sizeof(int32_t));
+            p.writeInt32 (follower->token);
+            sendResponse(p, socket_id, follower->connection);
+        }
+        recycleParcel(&p, sizeHint);
     }
 
 done:
-    free(pRI);
+    RequestStats *stats = requestStats(pRI->pCI);
+    if (stats != NULL) {
+        uint64_t librilUs = (pRI->dispatchNs - pRI->startNs
+                + ril_nano_time() - completeNs) / 1000;
+
+        ril_histogram_add(&stats->vendor, (completeNs - pRI->dispatchNs) / 1000);
+        __atomic_add_fetch(&stats->librilSumUs, librilUs, __ATOMIC_RELAXED);
+        uint32_t max = __atomic_load_n(&stats->librilMaxUs, __ATOMIC_RELAXED);
+        while (librilUs > max
+                && !__atomic_compare_exchange_n(&stats->librilMaxUs, &max,
+                        (uint32_t)librilUs, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    }
+
+    while (pRI->followers != NULL) {
+        RequestInfo *follower = pRI->followers;
+
+        pRI->followers = follower->p_next;
+        ril_trace(RIL_TRACE_RESPONSE, socket_id, pRI->pCI->requestNumber,
+                follower->token, e, responselen);
+        if (stats != NULL) {
+            __atomic_add_fetch(&stats->collapsed, 1, __ATOMIC_RELAXED);
+        }
+        ril_pool_free(&s_requestInfoPool, follower);
+    }
+
+    free(pRI->args);
+    ril_pool_free(&s_requestInfoPool, pRI);
 }
 
+extern "C" void
+RIL_onRequestComplete(RIL_Token t, RIL_Errno e, void *response, size_t responselen) {
+    RequestInfo *pRI;
+
+    pRI = checkAndDequeueRequestInfo(t, false);
 
-static void
-grabPartialWakeLock() {
-    acquire_wake_lock(PARTIAL_WAKE_LOCK, ANDROID_WAKE_LOCK_NAME);
+    if (pRI == NULL) {
+        if (tokenExpired(t)) {
+            RLOGD ("RIL_onRequestComplete: request already failed by its deadline");
+        } else {
+            RLOGE ("RIL_onRequestComplete: invalid RIL_Token");
+        }
+        return;
+    }
+
+    if (pRI->deadline_event.func != NULL) {
+        ril_event_del(&pRI->deadline_event);
+    }
+    completeRequest(pRI, e, response, responselen);
 }
 
+/**
+ * Deadline of a request passed. Unless it completed meanwhile, fail it
+ * and tell the vendor RIL, whose own completion will then be ignored.
+ */
 static void
-releaseWakeLock() {
-    release_wake_lock(ANDROID_WAKE_LOCK_NAME);
+requestDeadlineCallback(int fd, short flags, void *param) {
+    RIL_Token t = (RIL_Token)param;
+    RequestInfo *pRI = checkAndDequeueRequestInfo(t, true);
+    RequestStats *stats;
+
+    if (pRI == NULL) {
+        return;
+    }
+
+    RLOGW("%s: [%04d] %s missed its %ums deadline, cancelling",
+            rilSocketIdToString(pRI->socket_id), pRI->token,
+            requestToString(pRI->pCI->requestNumber),
+            requestDeadlineMs(pRI->pCI->requestNumber));
+
+    stats = requestStats(pRI->pCI);
+    if (stats != NULL) {
+        __atomic_add_fetch(&stats->deadlineMisses, 1, __ATOMIC_RELAXED);
+    }
+
+    completeRequest(pRI, RIL_E_GENERIC_FAILURE, NULL, 0);
+
+    if (s_callbacks.onCancel != NULL) {
+        VENDOR_LOCK();
+        s_callbacks.onCancel(t);
+        VENDOR_UNLOCK();
+    }
 }
 
+
 /**
- * Timer callback to put us back to sleep before the default timeout
+ * Timer callback to put us back to sleep before the default timeout.
+ * Unsolicited responses since the timer was armed only moved the
+ * deadline, so check it and rearm for whatever is left.
  */
 static void
-wakeTimeoutCallback (void *param) {
-    // We're using "param != NULL" as a cancellation mechanism
-    if (param == NULL) {
-        //RLOGD("wakeTimeout: releasing wake lock");
+wakeTimeoutCallback (int fd, short flags, void *param) {
+    uint64_t remaining = ril_wake_lock_expire();
 
-        releaseWakeLock();
-    } else {
-        //RLOGD("wakeTimeout: releasing wake lock CANCELLED");
+    if (remaining > 0) {
+        struct timeval wakeTimeout;
+        // round up to whole microseconds before splitting
+        uint64_t remainingUs = (remaining + 999) / 1000;
+        wakeTimeout.tv_sec = remainingUs / 1000000;
+        wakeTimeout.tv_usec = remainingUs % 1000000;
+        rilTimerAddWakeup(&s_wake_timeout_event, &wakeTimeout);
     }
 }
 
@@ -4344,7 +6157,8 @@ void RIL_onUnsolicitedResponse(int unsolResponse, void *data,
                                 size_t datalen)
 #endif
 {
-    int unsolResponseIndex;
+    UnsolResponseInfo *pUI;
+    size_t unsolResponseIndex;
     int ret;
     int64_t timeReceived = 0;
     bool shouldScheduleTimeout = false;
@@ -4362,26 +6176,25 @@ void RIL_onUnsolicitedResponse(int unsolResponse, void *data,
         return;
     }
 
-    /* Hack to include Samsung responses */
-    if (unsolResponse > SAMSUNG_UNSOL_RESPONSE_BASE) {
-        unsolResponseIndex = unsolResponse - SAMSUNG_UNSOL_RESPONSE_BASE + MAX_RIL_UNSOL - RIL_UNSOL_RESPONSE_BASE;
-        RLOGD("SAMSUNG: unsolResponse=%d, unsolResponseIndex=%d", unsolResponse, unsolResponseIndex);
-    } else {
-        unsolResponseIndex = unsolResponse - RIL_UNSOL_RESPONSE_BASE;
-    }
-
-    if ((unsolResponseIndex < 0)
-        || (unsolResponseIndex >= (int32_t)NUM_ELEMS(s_unsolResponses))) {
+    pUI = lookupUnsolResponse(unsolResponse);
+    if (pUI == NULL) {
         RLOGE("unsupported unsolicited response code %d", unsolResponse);
         return;
     }
+    unsolResponseIndex = pUI - s_unsolResponses;
+
+    __atomic_add_fetch(&s_unsolCount[unsolResponseIndex], 1, __ATOMIC_RELAXED);
+
+    // Before the client hears of the change and asks again
+    responseCacheInvalidate(unsolResponse, soc_id);
+    collapseInvalidate(unsolResponse, soc_id);
 
     // Grab a wake lock if needed for this reponse,
     // as we exit we'll either release it immediately
     // or set a timer to release it later.
-    switch (s_unsolResponses[unsolResponseIndex].wakeType) {
+    switch (pUI->wakeType) {
         case WAKE_PARTIAL:
-            grabPartialWakeLock();
+            ril_wake_lock_acquire();
             shouldScheduleTimeout = true;
         break;
 
@@ -4402,15 +6215,16 @@ void RIL_onUnsolicitedResponse(int unsolResponse, void *data,
 
     appendPrintBuf("[UNSL]< %s", requestToString(unsolResponse));
 
-    Parcel p;
+    uint32_t *sizeHint = &s_unsolSizeHint[unsolResponseIndex];
+    Parcel &p = *obtainParcel(sizeHint);
 
     p.writeInt32 (RESPONSE_UNSOLICITED);
     p.writeInt32 (unsolResponse);
 
-    ret = s_unsolResponses[unsolResponseIndex]
-                .responseFunction(p, const_cast<void*>(data), datalen);
+    ret = pUI->responseFunction(p, const_cast<void*>(data), datalen);
     if (ret != 0) {
         // Problem with the response. Don't continue;
+        recycleParcel(&p, sizeHint);
         goto error_exit;
     }
 
@@ -4435,37 +6249,29 @@ void RIL_onUnsolicitedResponse(int unsolResponse, void *data,
 
     }
 
+    ril_trace(RIL_TRACE_UNSOL, soc_id, unsolResponse, -1, 0, p.dataSize());
+#if RILC_LOG
     RLOGI("%s UNSOLICITED: %s length:%d", rilSocketIdToString(soc_id), requestToString(unsolResponse), p.dataSize());
-    ret = sendResponse(p, soc_id);
-    if (ret != 0 && unsolResponse == RIL_UNSOL_NITZ_TIME_RECEIVED) {
-
-        // Unfortunately, NITZ time is not poll/update like everything
-        // else in the system. So, if the upstream client isn't connected,
-        // keep a copy of the last NITZ response (with receive time noted
-        // above) around so we can deliver it when it is connected
-
-        if (s_lastNITZTimeData != NULL) {
-            free (s_lastNITZTimeData);
-            s_lastNITZTimeData = NULL;
-        }
+#endif
+    // A client that is behind or not connected gets the latest copy of
+    // state-like responses; NITZ, which is not polled, and events such as
+    // new SMS are kept for the next connection. See UnsolPolicy.
+    sendUnsolicitedResponse(p, soc_id, pUI);
 
-        s_lastNITZTimeData = malloc(p.dataSize());
-        s_lastNITZTimeDataSize = p.dataSize();
-        memcpy(s_lastNITZTimeData, p.data(), p.dataSize());
-    }
+    recycleParcel(&p, sizeHint);
 
     // For now, we automatically go back to sleep after TIMEVAL_WAKE_TIMEOUT
     // FIXME The java code should handshake here to release wake lock
 
     if (shouldScheduleTimeout) {
-        // Cancel the previous request
-        if (s_last_wake_timeout_info != NULL) {
-            s_last_wake_timeout_info->userParam = (void *)1;
+        // Move the deadline; the timer is only armed when none was pending
+        uint32_t ms = TIMEVAL_WAKE_TIMEOUT.tv_sec * 1000
+                + TIMEVAL_WAKE_TIMEOUT.tv_usec / 1000;
+        if (ril_wake_lock_hold(ms)) {
+            struct timeval wakeTimeout = TIMEVAL_WAKE_TIMEOUT;
+            rilTimerAddWakeup(&s_wake_timeout_event, &wakeTimeout);
         }
-
-        s_last_wake_timeout_info
-            = internalRequestTimedCallback(wakeTimeoutCallback, NULL,
-                                            &TIMEVAL_WAKE_TIMEOUT);
+        ril_wake_lock_release();
     }
 
     // Normal exit
@@ -4473,21 +6279,18 @@ void RIL_onUnsolicitedResponse(int unsolResponse, void *data,
 
 error_exit:
     if (shouldScheduleTimeout) {
-        releaseWakeLock();
+        ril_wake_lock_release();
     }
 }
 
-/** FIXME generalize this if you track UserCAllbackInfo, clear it
-    when the callback occurs
-*/
-static UserCallbackInfo *
+static void
 internalRequestTimedCallback (RIL_TimedCallback callback, void *param,
                                 const struct timeval *relativeTime)
 {
     struct timeval myRelativeTime;
     UserCallbackInfo *p_info;
 
-    p_info = (UserCallbackInfo *) malloc (sizeof(UserCallbackInfo));
+    p_info = (UserCallbackInfo *) ril_pool_alloc(&s_userCallbackPool);
 
     p_info->p_callback = callback;
     p_info->userParam = param;
@@ -4502,10 +6305,7 @@ internalRequestTimedCallback (RIL_TimedCallback callback, void *param,
 
     ril_event_set(&(p_info->event), -1, false, userTimerCallback, p_info);
 
-    ril_timer_add(&(p_info->event), &myRelativeTime);
-
-    triggerEvLoop();
-    return p_info;
+    rilTimerAddWakeup(&(p_info->event), &myRelativeTime);
 }
 
 
@@ -0,0 +1,69 @@
+/* //device/libs/telephony/ril_commands_samsung.h
+**
+** Copyright 2026, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+    {10000, NULL, NULL, DONT_COLLAPSE},       //none
+    {RIL_REQUEST_SET_CELL_BROADCAST_CONFIG, dispatchRaw, responseVoid, DONT_COLLAPSE},
+    {RIL_REQUEST_GET_CELL_BROADCAST_CONFIG, dispatchVoid, responseRaw, COLLAPSE},
+    {RIL_REQUEST_CRFM_LINE_SMS_COUNT_MSG, dispatchVoid, responseInts, DONT_COLLAPSE},
+    {RIL_REQUEST_CRFM_LINE_SMS_READ_MSG, dispatchInts, responseRaw, DONT_COLLAPSE},
+    {RIL_REQUEST_SEND_ENCODED_USSD, dispatchRaw, responseVoid, DONT_COLLAPSE},
+    {RIL_REQUEST_SET_PDA_MEMORY_STATUS, dispatchInts, responseVoid, DONT_COLLAPSE},
+    {RIL_REQUEST_GET_PHONEBOOK_STORAGE_INFO, dispatchInts, responseInts, COLLAPSE},
+    {RIL_REQUEST_GET_PHONEBOOK_ENTRY, dispatchInts, responseRaw, DONT_COLLAPSE},
+    {RIL_REQUEST_ACCESS_PHONEBOOK_ENTRY, dispatchRaw, responseInts, DONT_COLLAPSE},
+    {RIL_REQUEST_DIAL_VIDEO_CALL, dispatchDial, responseVoid, DONT_COLLAPSE},
+    {RIL_REQUEST_CALL_DEFLECTION, dispatchString, responseVoid, DONT_COLLAPSE},
+    {RIL_REQUEST_READ_SMS_FROM_SIM, dispatchInts, responseRaw, DONT_COLLAPSE},
+    {RIL_REQUEST_USIM_PB_CAPA, dispatchVoid, responseInts, COLLAPSE},
+    {RIL_REQUEST_LOCK_INFO, dispatchInts, responseInts, COLLAPSE},
+    {10015, NULL, NULL, DONT_COLLAPSE},
+    {RIL_REQUEST_DIAL_EMERGENCY_CALL, dispatchDial, responseVoid, DONT_COLLAPSE},
+    {RIL_REQUEST_GET_STOREAD_MSG_COUNT, dispatchVoid, responseInts, DONT_COLLAPSE},
+    {RIL_REQUEST_STK_SIM_INIT_EVENT, dispatchVoid, responseVoid, DONT_COLLAPSE},
+    {RIL_REQUEST_GET_LINE_ID, dispatchVoid, responseInts, COLLAPSE},
+    {RIL_REQUEST_SET_LINE_ID, dispatchInts, responseVoid, DONT_COLLAPSE},
+    {RIL_REQUEST_GET_SERIAL_NUMBER, dispatchVoid, responseString, COLLAPSE},
+    {RIL_REQUEST_GET_MANUFACTURE_DATE_NUMBER, dispatchVoid, responseString, COLLAPSE},
+    {RIL_REQUEST_GET_BARCODE_NUMBER, dispatchVoid, responseString, COLLAPSE},
+    {10024, NULL, NULL, DONT_COLLAPSE},
+    {10025, NULL, NULL, DONT_COLLAPSE},
+    {10026, NULL, NULL, DONT_COLLAPSE},
+    {10027, NULL, NULL, DONT_COLLAPSE},
+    {10028, NULL, NULL, DONT_COLLAPSE},
+    {10029, NULL, NULL, DONT_COLLAPSE},
+    {10030, NULL, NULL, DONT_COLLAPSE},
+    {10031, NULL, NULL, DONT_COLLAPSE},
+    {10032, NULL, NULL, DONT_COLLAPSE},
+    {10033, NULL, NULL, DONT_COLLAPSE},
+    {10034, NULL, NULL, DONT_COLLAPSE},
+    {10035, NULL, NULL, DONT_COLLAPSE},
+    {10036, NULL, NULL, DONT_COLLAPSE},
+    {10037, NULL, NULL, DONT_COLLAPSE},
+    {10038, NULL, NULL, DONT_COLLAPSE},
+    {10039, NULL, NULL, DONT_COLLAPSE},
+    {10040, NULL, NULL, DONT_COLLAPSE},
+    {10041, NULL, NULL, DONT_COLLAPSE},
+    {10042, NULL, NULL, DONT_COLLAPSE},
+    {10043, NULL, NULL, DONT_COLLAPSE},
+    {10044, NULL, NULL, DONT_COLLAPSE},
+    {10045, NULL, NULL, DONT_COLLAPSE},
+    {10046, NULL, NULL, DONT_COLLAPSE},
+    {10047, NULL, NULL, DONT_COLLAPSE},
+    {10048, NULL, NULL, DONT_COLLAPSE},
+    {10049, NULL, NULL, DONT_COLLAPSE},
+    {10050, NULL, NULL, DONT_COLLAPSE},
+    {10051, NULL, NULL, DONT_COLLAPSE},
+    {RIL_REQUEST_HANGUP_VT, dispatchInts, responseVoid, DONT_COLLAPSE},
@@ -18,6 +18,7 @@
 #define LOG_TAG "RILC"
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -26,6 +27,10 @@
 #include <string.h>
 #include <sys/time.h>
 #include <time.h>
+#include <sys/timerfd.h>
+#ifdef RIL_EVENT_USE_EPOLL
+#include <sys/epoll.h>
+#endif
 
 #include <pthread.h>
 static pthread_mutex_t listMutex;
@@ -65,13 +70,44 @@ static pthread_mutex_t listMutex;
     } while(0);
 #endif
 
+#ifdef RIL_EVENT_USE_EPOLL
+// Max number of ready fd's collected per epoll_wait() call. Readies beyond
+// this are simply reported again on the next wakeup.
+#define MAX_EPOLL_EVENTS 16
+
+#ifdef RIL_EVENT_EPOLL_EDGE_TRIGGERED
+// Edge triggered: callbacks must drain their fd until EAGAIN
+#define EPOLL_WATCH_EVENTS (EPOLLIN | EPOLLET)
+#else
+#define EPOLL_WATCH_EVENTS (EPOLLIN)
+#endif
+
+static int epollFd = -1;
+#else
 static fd_set readFds;
+static fd_set writeFds;
 static int nfds = 0;
 
 static struct ril_event * watch_table[MAX_FD_EVENTS];
-static struct ril_event timer_list;
+#endif
 static struct ril_event pending_list;
 
+/*
+ * Pending timers live in a binary min-heap ordered by expiry, so adding or
+ * cancelling a timer is O(log n). ev->index is the heap slot of a queued
+ * timer and -1 otherwise. The heap head is mirrored into timerFd, which is
+ * watched like any other fd, so arming a timer from any thread wakes the
+ * loop without going through the wakeup pipe.
+ */
+#define TIMER_HEAP_INITIAL_SIZE 16
+
+static struct ril_event ** timer_heap;
+static int timer_count = 0;
+static int timer_heap_size = 0;
+
+static int timerFd = -1;
+static struct ril_event timerfd_event;
+
 #define DEBUG 0
 
 #if DEBUG
@@ -93,16 +129,13 @@ static void dump_event(struct ril_event * ev)
 #define dump_event(x) do {} while(0)
 #endif
 
+// Timers are keyed on CLOCK_MONOTONIC, the clock timerFd runs on
 static void getNow(struct timeval * tv)
 {
-#ifdef HAVE_POSIX_CLOCKS
     struct timespec ts;
     clock_gettime(CLOCK_MONOTONIC, &ts);
     tv->tv_sec = ts.tv_sec;
     tv->tv_usec = ts.tv_nsec/1000;
-#else
-    gettimeofday(tv, NULL);
-#endif
 }
 
 static void init_list(struct ril_event * list)
@@ -134,12 +167,46 @@ static void removeFromList(struct ril_event * ev)
 }
 
 
+#ifdef RIL_EVENT_USE_EPOLL
+/*
+ * epoll backend: the kernel keeps the watch set, and each registration
+ * carries its ril_event pointer so that add, dispatch and removal are
+ * O(1) per fd. ev->index is 0 while the event is registered, -1 otherwise.
+ */
+static void removeWatch(struct ril_event * ev)
+{
+    ev->index = -1;
+
+    // fd may already have been closed, which drops it from the epoll set
+    if (epoll_ctl(epollFd, EPOLL_CTL_DEL, ev->fd, NULL) < 0 && errno != EBADF
+            && errno != ENOENT) {
+        RLOGE("ril_event: epoll_ctl(DEL) fd %d error (%d)", ev->fd, errno);
+    }
+}
+
+static void addWatch(struct ril_event * ev)
+{
+    struct epoll_event event;
+
+    memset(&event, 0, sizeof(event));
+    event.events = ev->write ? EPOLLOUT : EPOLL_WATCH_EVENTS;
+    event.data.ptr = ev;
+
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, ev->fd, &event) < 0) {
+        RLOGE("ril_event: epoll_ctl(ADD) fd %d error (%d)", ev->fd, errno);
+        return;
+    }
+    ev->index = 0;
+    dlog("~~~~ added fd %d ~~~~", ev->fd);
+    dump_event(ev);
+}
+#else
 static void removeWatch(struct ril_event * ev, int index)
 {
     watch_table[index] = NULL;
     ev->index = -1;
 
-    FD_CLR(ev->fd, &readFds);
+    FD_CLR(ev->fd, ev->write ? &writeFds : &readFds);
 
     if (ev->fd+1 == nfds) {
         int n = 0;
@@ -156,41 +223,201 @@ static void removeWatch(struct ril_event * ev, int index)
     }
 }
 
-static void processTimeouts()
+static void addWatch(struct ril_event * ev)
+{
+    for (int i = 0; i < MAX_FD_EVENTS; i++) {
+        if (watch_table[i] == NULL) {
+            watch_table[i] = ev;
+            ev->index = i;
+            dlog("~~~~ added at %d ~~~~", i);
+            dump_event(ev);
+            FD_SET(ev->fd, ev->write ? &writeFds : &readFds);
+            if (ev->fd >= nfds) nfds = ev->fd+1;
+            dlog("~~~~ nfds = %d ~~~~", nfds);
+            return;
+        }
+    }
+    // a dropped watch would leave its socket silently unserviced
+    RLOGE("ril_event: watch table full, fd %d not added", ev->fd);
+    abort();
+}
+#endif
+
+static void heapSet(int index, struct ril_event * ev)
+{
+    timer_heap[index] = ev;
+    ev->index = index;
+}
+
+static void heapSiftUp(int index)
+{
+    struct ril_event * ev = timer_heap[index];
+
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (!timercmp(&ev->timeout, &timer_heap[parent]->timeout, <)) {
+            break;
+        }
+        heapSet(index, timer_heap[parent]);
+        index = parent;
+    }
+    heapSet(index, ev);
+}
+
+static void heapSiftDown(int index)
+{
+    struct ril_event * ev = timer_heap[index];
+
+    for (;;) {
+        int child = 2 * index + 1;
+        if (child >= timer_count) {
+            break;
+        }
+        if (child + 1 < timer_count
+                && timercmp(&timer_heap[child + 1]->timeout,
+                        &timer_heap[child]->timeout, <)) {
+            child++;
+        }
+        if (!timercmp(&timer_heap[child]->timeout, &ev->timeout, <)) {
+            break;
+        }
+        heapSet(index, timer_heap[child]);
+        index = child;
+    }
+    heapSet(index, ev);
+}
+
+static bool heapInsert(struct ril_event * ev)
+{
+    if (timer_count == timer_heap_size) {
+        int size = timer_heap_size ? timer_heap_size * 2 : TIMER_HEAP_INITIAL_SIZE;
+        struct ril_event ** heap = (struct ril_event **)
+                realloc(timer_heap, size * sizeof(struct ril_event *));
+
+        if (heap == NULL) {
+            RLOGE("ril_event: out of memory growing timer heap");
+            return false;
+        }
+        timer_heap = heap;
+        timer_heap_size = size;
+    }
+    heapSet(timer_count++, ev);
+    heapSiftUp(ev->index);
+    return true;
+}
+
+static void heapRemove(struct ril_event * ev)
+{
+    int index = ev->index;
+    struct ril_event * last = timer_heap[--timer_count];
+
+    ev->index = -1;
+    if (last == ev) {
+        return;
+    }
+    heapSet(index, last);
+    heapSiftUp(index);
+    heapSiftDown(last->index);
+}
+
+// Program timerFd for the earliest pending timer, or disarm it
+static void armTimerFd()
+{
+    struct itimerspec its;
+
+    if (timerFd < 0) {
+        return;
+    }
+
+    memset(&its, 0, sizeof(its));
+    if (timer_count > 0) {
+        its.it_value.tv_sec = timer_heap[0]->timeout.tv_sec;
+        its.it_value.tv_nsec = timer_heap[0]->timeout.tv_usec * 1000;
+        if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) {
+            // all zero would disarm the timer
+            its.it_value.tv_nsec = 1;
+        }
+    }
+
+    if (timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+        RLOGE("ril_event: timerfd_settime error (%d)", errno);
+    }
+}
+
+static void processTimerFd(int fd, short flags, void *param)
+{
+    // never queued; processTimeouts() acknowledges the expiration
+}
+
+static void processTimeouts(bool timerExpired)
 {
     dlog("~~~~ +processTimeouts ~~~~");
     MUTEX_ACQUIRE();
     struct timeval now;
-    struct ril_event * tev = timer_list.next;
-    struct ril_event * next;
+    struct ril_event * tev;
+    bool fired = false;
+
+    if (timerExpired) {
+        // Drain before sampling the clock. Reading after the re-arm below
+        // could swallow an expiration for the new earliest timer.
+        uint64_t expirations;
+        while (read(timerFd, &expirations, sizeof(expirations)) < 0 && errno == EINTR);
+    }
 
     getNow(&now);
-    // walk list, see if now >= ev->timeout for any events
+    // pop the heap while now >= the earliest timeout
 
     dlog("~~~~ Looking for timers <= %ds + %dus ~~~~", (int)now.tv_sec, (int)now.tv_usec);
-    while ((tev != &timer_list) && (timercmp(&now, &tev->timeout, >))) {
+    while (timer_count > 0 && !timercmp(&now, &timer_heap[0]->timeout, <)) {
         // Timer expired
         dlog("~~~~ firing timer ~~~~");
-        next = tev->next;
-        removeFromList(tev);
+        tev = timer_heap[0];
+        heapRemove(tev);
         addToList(tev, &pending_list);
-        tev = next;
+        fired = true;
+    }
+    if (fired || timerExpired) {
+        armTimerFd();
     }
     MUTEX_RELEASE();
     dlog("~~~~ -processTimeouts ~~~~");
 }
 
-static void processReadReadies(fd_set * rfds, int n)
+#ifdef RIL_EVENT_USE_EPOLL
+static void processReadReadies(struct epoll_event * events, int n)
+{
+    dlog("~~~~ +processReadReadies (%d) ~~~~", n);
+    MUTEX_ACQUIRE();
+
+    for (int i = 0; i < n; i++) {
+        struct ril_event * rev = (struct ril_event *)events[i].data.ptr;
+        // skip events removed by another thread since epoll_wait() returned
+        if (rev->index < 0 || rev == &timerfd_event) {
+            continue;
+        }
+        addToList(rev, &pending_list);
+        if (rev->persist == false) {
+            removeWatch(rev);
+        }
+    }
+
+    MUTEX_RELEASE();
+    dlog("~~~~ -processReadReadies (%d) ~~~~", n);
+}
+#else
+static void processReadReadies(fd_set * rfds, fd_set * wfds, int n)
 {
     dlog("~~~~ +processReadReadies (%d) ~~~~", n);
     MUTEX_ACQUIRE();
 
     for (int i = 0; (i < MAX_FD_EVENTS) && (n > 0); i++) {
         struct ril_event * rev = watch_table[i];
-        if (rev != NULL && FD_ISSET(rev->fd, rfds)) {
-            addToList(rev, &pending_list);
-            if (rev->persist == false) {
-                removeWatch(rev, i);
+        if (rev != NULL && FD_ISSET(rev->fd, rev->write ? wfds : rfds)) {
+            if (rev != &timerfd_event) {
+                addToList(rev, &pending_list);
+                if (rev->persist == false) {
+                    removeWatch(rev, i);
+                }
             }
             n--;
         }
@@ -199,32 +426,48 @@ static void processReadReadies(fd_set * rfds, int n)
     MUTEX_RELEASE();
     dlog("~~~~ -processReadReadies (%d) ~~~~", n);
 }
+#endif
 
 static void firePending()
 {
     dlog("~~~~ +firePending ~~~~");
-    struct ril_event * ev = pending_list.next;
-    while (ev != &pending_list) {
-        struct ril_event * next = ev->next;
+    // pop under the lock so ril_event_del() may drop events that have not
+    // fired yet; callbacks run unlocked and may re-add their own event.
+    // Copy the event first: once popped, its owner may free it.
+    MUTEX_ACQUIRE();
+    while (pending_list.next != &pending_list) {
+        struct ril_event * ev = pending_list.next;
+        ril_event_cb func = ev->func;
+        int fd = ev->fd;
+        void * param = ev->param;
         removeFromList(ev);
-        ev->func(ev->fd, 0, ev->param);
-        ev = next;
+        MUTEX_RELEASE();
+        func(fd, 0, param);
+        MUTEX_ACQUIRE();
     }
+    MUTEX_RELEASE();
     dlog("~~~~ -firePending ~~~~");
 }
 
+/*
+ * Only used when timerfd is unavailable. Timers armed from other threads
+ * are then noticed at the next wakeup of the loop; see ril_timer_wakes_loop().
+ */
 static int calcNextTimeout(struct timeval * tv)
 {
-    struct ril_event * tev = timer_list.next;
+    struct ril_event * tev;
     struct timeval now;
 
-    getNow(&now);
-
-    // Sorted list, so calc based on first node
-    if (tev == &timer_list) {
-        // no pending timers
+    MUTEX_ACQUIRE();
+    // Heap, so calc based on the root
+    if (timer_count == 0 || timerFd >= 0) {
+        // no pending timers, or timerFd will wake us
+        MUTEX_RELEASE();
         return -1;
     }
+    tev = timer_heap[0];
+
+    getNow(&now);
 
     dlog("~~~~ now = %ds + %dus ~~~~", (int)now.tv_sec, (int)now.tv_usec);
     dlog("~~~~ next = %ds + %dus ~~~~",
@@ -235,6 +478,7 @@ static int calcNextTimeout(struct timeval * tv)
         // timer already expired.
         tv->tv_sec = tv->tv_usec = 0;
     }
+    MUTEX_RELEASE();
     return 0;
 }
 
@@ -243,10 +487,28 @@ void ril_event_init()
 {
     MUTEX_INIT();
 
+#ifdef RIL_EVENT_USE_EPOLL
+    epollFd = epoll_create(MAX_FD_EVENTS);
+    if (epollFd < 0) {
+        RLOGE("ril_event: epoll_create error (%d)", errno);
+    } else {
+        fcntl(epollFd, F_SETFD, FD_CLOEXEC);
+    }
+#else
     FD_ZERO(&readFds);
-    init_list(&timer_list);
-    init_list(&pending_list);
+    FD_ZERO(&writeFds);
     memset(watch_table, 0, sizeof(watch_table));
+#endif
+    init_list(&pending_list);
+
+    timerFd = timerfd_create(CLOCK_MONOTONIC, 0);
+    if (timerFd < 0) {
+        RLOGE("ril_event: timerfd_create error (%d), timers fall back to polling", errno);
+    } else {
+        fcntl(timerFd, F_SETFD, FD_CLOEXEC);
+        ril_event_set(&timerfd_event, timerFd, true, processTimerFd, NULL);
+        ril_event_add(&timerfd_event);
+    }
 }
 
 // Initialize an event
@@ -262,73 +524,148 @@ void ril_event_set(struct ril_event * ev, int fd, bool persist, ril_event_cb fun
     fcntl(fd, F_SETFL, O_NONBLOCK);
 }
 
+// Initialize an event that fires when fd becomes writable
+void ril_event_set_write(struct ril_event * ev, int fd, bool persist, ril_event_cb func, void * param)
+{
+    ril_event_set(ev, fd, persist, func, param);
+    ev->write = true;
+}
+
 // Add event to watch list
 void ril_event_add(struct ril_event * ev)
 {
     dlog("~~~~ +ril_event_add ~~~~");
     MUTEX_ACQUIRE();
-    for (int i = 0; i < MAX_FD_EVENTS; i++) {
-        if (watch_table[i] == NULL) {
-            watch_table[i] = ev;
-            ev->index = i;
-            dlog("~~~~ added at %d ~~~~", i);
-            dump_event(ev);
-            FD_SET(ev->fd, &readFds);
-            if (ev->fd >= nfds) nfds = ev->fd+1;
-            dlog("~~~~ nfds = %d ~~~~", nfds);
-            break;
-        }
-    }
+    addWatch(ev);
     MUTEX_RELEASE();
     dlog("~~~~ -ril_event_add ~~~~");
 }
 
-// Add timer event
+// Add timer event, or reschedule it if it is already pending
 void ril_timer_add(struct ril_event * ev, struct timeval * tv)
 {
     dlog("~~~~ +ril_timer_add ~~~~");
     MUTEX_ACQUIRE();
 
-    struct ril_event * list;
     if (tv != NULL) {
-        // add to timer list
-        list = timer_list.next;
+        bool wasFirst = false;
+
         ev->fd = -1; // make sure fd is invalid
 
+        if (ev->index >= 0) {
+            wasFirst = (ev->index == 0);
+            heapRemove(ev);
+        } else if (ev->next != NULL) {
+            // expired but not fired yet
+            removeFromList(ev);
+        }
+
         struct timeval now;
         getNow(&now);
         timeradd(&now, tv, &ev->timeout);
 
-        // keep list sorted
-        while (timercmp(&list->timeout, &ev->timeout, < )
-                && (list != &timer_list)) {
-            list = list->next;
+        if (heapInsert(ev) && ev->index == 0) {
+            wasFirst = true;
+        }
+        if (wasFirst) {
+            // earliest timer changed
+            armTimerFd();
         }
-        // list now points to the first event older than ev
-        addToList(ev, list);
     }
 
     MUTEX_RELEASE();
     dlog("~~~~ -ril_timer_add ~~~~");
 }
 
-// Remove event from watch or timer list
+bool ril_timer_wakes_loop()
+{
+    return timerFd >= 0;
+}
+
+// Remove event from watch or timer list. An event that is due but has not
+// fired yet is dropped as well.
 void ril_event_del(struct ril_event * ev)
 {
     dlog("~~~~ +ril_event_del ~~~~");
     MUTEX_ACQUIRE();
 
+    if (ev->next != NULL) {
+        removeFromList(ev);
+    }
+
+    if (ev->fd < 0) {
+        if (ev->index >= 0) {
+            bool wasFirst = (ev->index == 0);
+            heapRemove(ev);
+            if (wasFirst) {
+                armTimerFd();
+            }
+        }
+        MUTEX_RELEASE();
+        return;
+    }
+
     if (ev->index < 0 || ev->index >= MAX_FD_EVENTS) {
         MUTEX_RELEASE();
         return;
     }
 
+#ifdef RIL_EVENT_USE_EPOLL
+    removeWatch(ev);
+#else
     removeWatch(ev, ev->index);
+#endif
 
     MUTEX_RELEASE();
     dlog("~~~~ -ril_event_del ~~~~");
 }
 
+#ifdef RIL_EVENT_USE_EPOLL
+void ril_event_loop()
+{
+    int n;
+    int timeoutMs;
+    struct timeval tv;
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+
+    for (;;) {
+
+        if (-1 == calcNextTimeout(&tv)) {
+            // no pending timers, or timerFd wakes us; block indefinitely
+            dlog("~~~~ no timeout; blocking indefinitely ~~~~");
+            timeoutMs = -1;
+        } else {
+            dlog("~~~~ blocking for %ds + %dus ~~~~", (int)tv.tv_sec, (int)tv.tv_usec);
+            // round up so we never wake before the timer is due
+            timeoutMs = tv.tv_sec * 1000 + (tv.tv_usec + 999) / 1000;
+        }
+        n = epoll_wait(epollFd, events, MAX_EPOLL_EVENTS, timeoutMs);
+        dlog("~~~~ %d events fired ~~~~", n);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+
+            RLOGE("ril_event: epoll_wait error (%d)", errno);
+            // bail?
+            return;
+        }
+
+        bool timerExpired = false;
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == &timerfd_event) {
+                timerExpired = true;
+                break;
+            }
+        }
+
+        // Check for timeouts
+        processTimeouts(timerExpired);
+        // Check for read-ready
+        processReadReadies(events, n);
+        // Fire away
+        firePending();
+    }
+}
+#else
 #if DEBUG
 static void printReadies(fd_set * rfds)
 {
@@ -347,24 +684,26 @@ void ril_event_loop()
 {
     int n;
     fd_set rfds;
+    fd_set wfds;
     struct timeval tv;
     struct timeval * ptv;
 
 
     for (;;) {
 
-        // make local copy of read fd_set
+        // make local copies of the read and write fd_sets
         memcpy(&rfds, &readFds, sizeof(fd_set));
+        memcpy(&wfds, &writeFds, sizeof(fd_set));
         if (-1 == calcNextTimeout(&tv)) {
-            // no pending timers; block indefinitely
-            dlog("~~~~ no timers; blocking indefinitely ~~~~");
+            // no pending timers, or timerFd wakes us; block indefinitely
+            dlog("~~~~ no timeout; blocking indefinitely ~~~~");
             ptv = NULL;
         } else {
             dlog("~~~~ blocking for %ds + %dus ~~~~", (int)tv.tv_sec, (int)tv.tv_usec);
             ptv = &tv;
         }
         printReadies(&rfds);
-        n = select(nfds, &rfds, NULL, NULL, ptv);
+        n = select(nfds, &rfds, &wfds, NULL, ptv);
         printReadies(&rfds);
         dlog("~~~~ %d events fired ~~~~", n);
         if (n < 0) {
@@ -376,10 +715,11 @@ void ril_event_loop()
         }
 
         // Check for timeouts
-        processTimeouts();
+        processTimeouts(n > 0 && timerFd >= 0 && FD_ISSET(timerFd, &rfds));
         // Check for read-ready
-        processReadReadies(&rfds, n);
+        processReadReadies(&rfds, &wfds, n);
         // Fire away
         firePending();
     }
 }
+#endif
@@ -15,8 +15,13 @@
 ** limitations under the License.
 */
 
-// Max number of fd's we watch at any one time.  Increase if necessary.
-#define MAX_FD_EVENTS 8
+#include <telephony/ril.h>
+
+// Max number of fd's we watch at any one time with the select() backend:
+// the listen, command and out queue fds of each RIL socket, plus the debug
+// socket, the wakeup pipe and the timerfd. Increase if more are added.
+// The epoll backend (RIL_EVENT_USE_EPOLL) has no limit.
+#define MAX_FD_EVENTS (3 * SIM_COUNT + 3)
 
 typedef void (*ril_event_cb)(int fd, short events, void *userdata);
 
@@ -25,8 +30,9 @@ struct ril_event {
     struct ril_event *prev;
 
     int fd;
-    int index;
+    int index;      // watch slot, or timer heap slot when fd < 0
     bool persist;
+    bool write;     // watch for writability instead of readability
     struct timeval timeout;
     ril_event_cb func;
     void *param;
@@ -38,13 +44,21 @@ void ril_event_init();
 // Initialize an event
 void ril_event_set(struct ril_event * ev, int fd, bool persist, ril_event_cb func, void * param);
 
+// Initialize an event that fires when fd becomes writable. With the epoll
+// backend fd must not also be watched for reads; watch a dup() of it.
+void ril_event_set_write(struct ril_event * ev, int fd, bool persist, ril_event_cb func, void * param);
+
 // Add event to watch list
 void ril_event_add(struct ril_event * ev);
 
-// Add timer event
+// Add timer event, or reschedule it if it is already pending
 void ril_timer_add(struct ril_event * ev, struct timeval * tv);
 
-// Remove event from watch list
+// True if arming a timer wakes the event loop by itself (timerfd). When it
+// does not, a timer added from another thread needs the loop woken up.
+bool ril_timer_wakes_loop();
+
+// Remove event from watch list, or cancel a pending timer
 void ril_event_del(struct ril_event * ev);
 
 // Event loop
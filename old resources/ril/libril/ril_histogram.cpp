@@ -0,0 +1,92 @@
+/* //device/libs/telephony/ril_histogram.cpp
+**
+** Copyright 2026, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#include <ril_histogram.h>
+
+/*
+ * Values below RIL_HISTOGRAM_SUB_BUCKETS get a bucket each. Above that,
+ * the exponent picks a group of RIL_HISTOGRAM_SUB_BUCKETS buckets and the
+ * bits just below the leading one pick the bucket inside the group.
+ */
+static int bucketOf(uint64_t us)
+{
+    int exponent;
+    int index;
+
+    if (us < RIL_HISTOGRAM_SUB_BUCKETS) {
+        return (int)us;
+    }
+    exponent = 63 - __builtin_clzll(us);
+    index = (exponent - RIL_HISTOGRAM_SUB_BITS + 1) * RIL_HISTOGRAM_SUB_BUCKETS
+            + (int)((us >> (exponent - RIL_HISTOGRAM_SUB_BITS))
+                    & (RIL_HISTOGRAM_SUB_BUCKETS - 1));
+
+    return index < RIL_HISTOGRAM_BUCKETS ? index : RIL_HISTOGRAM_BUCKETS - 1;
+}
+
+// Largest value that falls into bucket index
+static uint64_t bucketUpperBound(int index)
+{
+    int group = index / RIL_HISTOGRAM_SUB_BUCKETS;
+    int sub = index % RIL_HISTOGRAM_SUB_BUCKETS;
+    int exponent;
+
+    if (group == 0) {
+        return index;
+    }
+    exponent = group + RIL_HISTOGRAM_SUB_BITS - 1;
+
+    return ((uint64_t)(RIL_HISTOGRAM_SUB_BUCKETS + sub + 1)
+            << (exponent - RIL_HISTOGRAM_SUB_BITS)) - 1;
+}
+
+void ril_histogram_add(struct ril_histogram * h, uint64_t us)
+{
+    uint32_t clamped = us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+    uint32_t max = __atomic_load_n(&h->maxUs, __ATOMIC_RELAXED);
+
+    __atomic_add_fetch(&h->counts[bucketOf(us)], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&h->total, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&h->sumUs, us, __ATOMIC_RELAXED);
+
+    while (clamped > max
+            && !__atomic_compare_exchange_n(&h->maxUs, &max, clamped,
+                    true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+uint64_t ril_histogram_percentile(struct ril_histogram * h, int percentile)
+{
+    uint32_t total = __atomic_load_n(&h->total, __ATOMIC_RELAXED);
+    uint64_t wanted = ((uint64_t)total * percentile + 99) / 100;
+    uint64_t seen = 0;
+
+    if (total == 0) {
+        return 0;
+    }
+    if (wanted == 0) {
+        wanted = 1;
+    }
+
+    for (int i = 0; i < RIL_HISTOGRAM_BUCKETS; i++) {
+        seen += __atomic_load_n(&h->counts[i], __ATOMIC_RELAXED);
+        if (seen >= wanted) {
+            return bucketUpperBound(i);
+        }
+    }
+
+    return __atomic_load_n(&h->maxUs, __ATOMIC_RELAXED);
+}
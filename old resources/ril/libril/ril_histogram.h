@@ -0,0 +1,46 @@
+/* //device/libs/telephony/ril_histogram.h
+**
+** Copyright 2026, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef RIL_HISTOGRAM_H
+#define RIL_HISTOGRAM_H
+
+#include <stdint.h>
+
+// Log-linear buckets in microseconds: each power of 2 is split into
+// RIL_HISTOGRAM_SUB_BUCKETS, so a bucket is within 25% of its values.
+// Values beyond the last group (~67s) land in the last bucket.
+#define RIL_HISTOGRAM_SUB_BITS      2
+#define RIL_HISTOGRAM_SUB_BUCKETS   (1 << RIL_HISTOGRAM_SUB_BITS)
+#define RIL_HISTOGRAM_MAX_EXPONENT  24
+#define RIL_HISTOGRAM_BUCKETS \
+        ((RIL_HISTOGRAM_MAX_EXPONENT + 1) * RIL_HISTOGRAM_SUB_BUCKETS)
+
+// Zero-initialized is empty. Updated with atomics from any thread.
+struct ril_histogram {
+    uint32_t counts[RIL_HISTOGRAM_BUCKETS];
+    uint32_t total;
+    uint32_t maxUs;
+    uint64_t sumUs;
+};
+
+// Record one value
+void ril_histogram_add(struct ril_histogram * h, uint64_t us);
+
+// Upper bound of the bucket holding the given percentile (0-100), 0 if empty
+uint64_t ril_histogram_percentile(struct ril_histogram * h, int percentile);
+
+#endif // RIL_HISTOGRAM_H
@@ -0,0 +1,151 @@
+/* //device/libs/telephony/ril_pool.cpp
+**
+** Copyright 2026, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#define LOG_TAG "RILC"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <utils/Log.h>
+#include <ril_pool.h>
+
+#define POOL_NO_INDEX 0xffffffffU
+
+#define HEAD_INDEX(h)       ((uint32_t)(h))
+#define HEAD_MAKE(tag, i)   (((uint64_t)(tag) << 32) | (i))
+#define HEAD_TAG(h)         ((uint32_t)((h) >> 32))
+
+static void updateHighWater(struct ril_pool * pool, uint32_t inUse)
+{
+    uint32_t high = __atomic_load_n(&pool->highWater, __ATOMIC_RELAXED);
+
+    while (inUse > high
+            && !__atomic_compare_exchange_n(&pool->highWater, &high, inUse,
+                    true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+void ril_pool_init(struct ril_pool * pool, const char * name, size_t objSize, uint32_t count)
+{
+    memset(pool, 0, sizeof(struct ril_pool));
+    pool->name = name;
+    pool->objSize = objSize;
+    pool->freeHead = HEAD_MAKE(0, POOL_NO_INDEX);
+
+    pool->objects = (uint8_t *)malloc(objSize * count);
+    pool->next = (uint32_t *)malloc(sizeof(uint32_t) * count);
+    if (pool->objects == NULL || pool->next == NULL) {
+        RLOGE("ril_pool %s: out of memory, using the heap", name);
+        free(pool->objects);
+        free(pool->next);
+        pool->objects = NULL;
+        pool->next = NULL;
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        pool->next[i] = (i + 1 < count) ? i + 1 : POOL_NO_INDEX;
+    }
+    pool->count = count;
+    pool->freeHead = HEAD_MAKE(0, count > 0 ? 0 : POOL_NO_INDEX);
+}
+
+void * ril_pool_alloc(struct ril_pool * pool)
+{
+    uint64_t head = __atomic_load_n(&pool->freeHead, __ATOMIC_ACQUIRE);
+    uint32_t inUse;
+    void *obj = NULL;
+
+    // Treiber stack pop; the tag defeats ABA when an object is freed and
+    // reallocated between our load and the compare-and-swap. A pool that
+    // was never initialized has count 0 and always uses the heap.
+    while (pool->count > 0 && HEAD_INDEX(head) != POOL_NO_INDEX) {
+        uint32_t index = HEAD_INDEX(head);
+        uint64_t newHead = HEAD_MAKE(HEAD_TAG(head) + 1,
+                __atomic_load_n(&pool->next[index], __ATOMIC_RELAXED));
+
+        if (__atomic_compare_exchange_n(&pool->freeHead, &head, newHead,
+                true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+            obj = pool->objects + (size_t)index * pool->objSize;
+            memset(obj, 0, pool->objSize);
+            break;
+        }
+    }
+
+    if (obj == NULL) {
+        obj = calloc(1, pool->objSize);
+        if (obj == NULL) {
+            return NULL;
+        }
+        __atomic_add_fetch(&pool->overflows, 1, __ATOMIC_RELAXED);
+    }
+
+    __atomic_add_fetch(&pool->allocs, 1, __ATOMIC_RELAXED);
+    inUse = __atomic_add_fetch(&pool->inUse, 1, __ATOMIC_RELAXED);
+    updateHighWater(pool, inUse);
+
+    return obj;
+}
+
+void ril_pool_free(struct ril_pool * pool, void * obj)
+{
+    uint8_t *p = (uint8_t *)obj;
+    uint64_t head;
+    uint32_t index;
+
+    if (obj == NULL) {
+        return;
+    }
+
+    __atomic_sub_fetch(&pool->inUse, 1, __ATOMIC_RELAXED);
+
+    if (pool->objects == NULL || p < pool->objects
+            || p >= pool->objects + (size_t)pool->count * pool->objSize) {
+        // came from the heap because the pool was exhausted
+        free(obj);
+        return;
+    }
+
+    index = (uint32_t)((p - pool->objects) / pool->objSize);
+    head = __atomic_load_n(&pool->freeHead, __ATOMIC_RELAXED);
+    do {
+        __atomic_store_n(&pool->next[index], HEAD_INDEX(head), __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(&pool->freeHead, &head,
+                HEAD_MAKE(HEAD_TAG(head) + 1, index),
+                true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+void ril_pool_dump(struct ril_pool * pool, int fd)
+{
+    char buf[160];
+    int len;
+
+    len = snprintf(buf, sizeof(buf),
+            "%s: size %u, in use %u, high water %u, overflows %u, allocs %u\n",
+            pool->name != NULL ? pool->name : "(uninitialized)",
+            pool->count,
+            __atomic_load_n(&pool->inUse, __ATOMIC_RELAXED),
+            __atomic_load_n(&pool->highWater, __ATOMIC_RELAXED),
+            __atomic_load_n(&pool->overflows, __ATOMIC_RELAXED),
+            __atomic_load_n(&pool->allocs, __ATOMIC_RELAXED));
+    if (len >= (int)sizeof(buf)) {
+        len = sizeof(buf) - 1;
+    }
+    if (len > 0 && write(fd, buf, len) < 0) {
+        RLOGE("ril_pool %s: error writing stats", pool->name);
+    }
+}
@@ -0,0 +1,54 @@
+/* //device/libs/telephony/ril_pool.h
+**
+** Copyright 2026, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef RIL_POOL_H
+#define RIL_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed-size pool of equally sized objects, used for the control blocks
+// allocated on every request. Alloc and free are lock-free and may be called
+// from any thread. When the pool is exhausted, or was never initialized,
+// objects come from the heap and are counted as overflows.
+struct ril_pool {
+    const char *name;
+    size_t objSize;
+    uint32_t count;
+    uint8_t *objects;
+    uint32_t *next;         // free list links, indexed by object
+    uint64_t freeHead;      // tag << 32 | index of first free object
+
+    uint32_t inUse;
+    uint32_t highWater;
+    uint32_t overflows;
+    uint32_t allocs;
+};
+
+// Initialize a pool of count objects of objSize bytes
+void ril_pool_init(struct ril_pool * pool, const char * name, size_t objSize, uint32_t count);
+
+// Get a zeroed object
+void * ril_pool_alloc(struct ril_pool * pool);
+
+// Return an object obtained from ril_pool_alloc()
+void ril_pool_free(struct ril_pool * pool, void * obj);
+
+// Write a one line usage summary to fd
+void ril_pool_dump(struct ril_pool * pool, int fd);
+
+#endif // RIL_POOL_H
@@ -0,0 +1,139 @@
+/* //device/libs/telephony/ril_trace.cpp
+**
+** Copyright 2026, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#define LOG_TAG "RILC"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <utils/Log.h>
+#include <telephony/librilutils.h>
+#include <ril_trace.h>
+
+extern "C" const char * requestToString(int request);
+
+#define RIL_TRACE_MASK (RIL_TRACE_RECORDS - 1)
+
+static struct ril_trace_record s_ring[RIL_TRACE_RECORDS];
+// Total records ever written; the next one goes to s_ring[s_next & MASK]
+static uint32_t s_next = 0;
+
+void ril_trace(enum ril_trace_type type, int socket_id, int id, int token,
+        int error, uint32_t length)
+{
+    uint32_t n = __atomic_fetch_add(&s_next, 1, __ATOMIC_RELAXED);
+    struct ril_trace_record * r = &s_ring[n & RIL_TRACE_MASK];
+
+    // seq 0 marks the slot as being written until the fields are complete
+    __atomic_store_n(&r->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    r->type = (uint8_t)type;
+    r->socket_id = (uint8_t)socket_id;
+    r->reserved = 0;
+    r->id = id;
+    r->token = token;
+    r->error = error;
+    r->length = length;
+    r->timeNs = ril_nano_time();
+
+    __atomic_store_n(&r->seq, n + 1, __ATOMIC_RELEASE);
+}
+
+// Copy record n if it is complete and has not been overwritten since
+static bool readRecord(uint32_t n, struct ril_trace_record * out)
+{
+    struct ril_trace_record * r = &s_ring[n & RIL_TRACE_MASK];
+
+    if (__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != n + 1) {
+        return false;
+    }
+    memcpy(out, r, sizeof(struct ril_trace_record));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    return __atomic_load_n(&r->seq, __ATOMIC_RELAXED) == n + 1;
+}
+
+static const char * typeToString(uint8_t type)
+{
+    switch (type) {
+        case RIL_TRACE_REQUEST: return "REQ";
+        case RIL_TRACE_LOCAL_REQUEST: return "LOCL";
+        case RIL_TRACE_RESPONSE: return "RSP";
+        case RIL_TRACE_UNSOL: return "UNSL";
+        case RIL_TRACE_DROPPED: return "DROP";
+        default: return "?";
+    }
+}
+
+static int writeAll(int fd, const void * buf, size_t len)
+{
+    const char * p = (const char *)buf;
+
+    while (len > 0) {
+        ssize_t written = write(fd, p, len);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += written;
+        len -= written;
+    }
+    return 0;
+}
+
+void ril_trace_dump(int fd)
+{
+    uint32_t end = __atomic_load_n(&s_next, __ATOMIC_ACQUIRE);
+    uint32_t start = end > RIL_TRACE_RECORDS ? end - RIL_TRACE_RECORDS : 0;
+    struct ril_trace_record r;
+    char line[160];
+
+    for (uint32_t n = start; n != end; n++) {
+        if (!readRecord(n, &r)) {
+            continue;
+        }
+        int len = snprintf(line, sizeof(line),
+                "%llu.%06llu %-4s sim%u [%04d] %s error=%d len=%u\n",
+                (unsigned long long)(r.timeNs / 1000000000ULL),
+                (unsigned long long)(r.timeNs % 1000000000ULL / 1000),
+                typeToString(r.type), r.socket_id + 1, r.token,
+                requestToString(r.id), r.error, r.length);
+        if (len >= (int)sizeof(line)) {
+            len = sizeof(line) - 1;
+        }
+        if (len > 0 && writeAll(fd, line, len) < 0) {
+            RLOGE("ril_trace: error writing dump (%d)", errno);
+            return;
+        }
+    }
+}
+
+void ril_trace_dump_raw(int fd)
+{
+    uint32_t end = __atomic_load_n(&s_next, __ATOMIC_ACQUIRE);
+    uint32_t start = end > RIL_TRACE_RECORDS ? end - RIL_TRACE_RECORDS : 0;
+    struct ril_trace_record r;
+
+    for (uint32_t n = start; n != end; n++) {
+        if (readRecord(n, &r) && writeAll(fd, &r, sizeof(r)) < 0) {
+            RLOGE("ril_trace: error writing dump (%d)", errno);
+            return;
+        }
+    }
+}
@@ -0,0 +1,58 @@
+/* //device/libs/telephony/ril_trace.h
+**
+** Copyright 2026, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef RIL_TRACE_H
+#define RIL_TRACE_H
+
+#include <stdint.h>
+
+// Number of records kept; must be a power of 2
+#define RIL_TRACE_RECORDS 512
+
+enum ril_trace_type {
+    RIL_TRACE_REQUEST = 1,      // request read from a command socket
+    RIL_TRACE_LOCAL_REQUEST,    // request issued by libril itself
+    RIL_TRACE_RESPONSE,         // RIL_onRequestComplete
+    RIL_TRACE_UNSOL,            // RIL_onUnsolicitedResponse
+    RIL_TRACE_DROPPED,          // response not delivered to the socket
+};
+
+// One fixed-size binary record. Decoded by ril_trace_dump(), or offline
+// from the raw ring written by ril_trace_dump_raw().
+struct ril_trace_record {
+    uint32_t seq;       // 1 + index of the write that filled the slot, 0 while writing
+    uint8_t type;       // enum ril_trace_type
+    uint8_t socket_id;
+    uint16_t reserved;
+    int32_t id;         // request or unsolicited response code
+    int32_t token;      // serial from the command socket, -1 if none
+    int32_t error;      // RIL_Errno, or a response function error
+    uint32_t length;    // payload bytes
+    uint64_t timeNs;    // ril_nano_time()
+};
+
+// Append a record. Lock-free, callable from any thread.
+void ril_trace(enum ril_trace_type type, int socket_id, int id, int token,
+        int error, uint32_t length);
+
+// Write the ring as text, oldest record first
+void ril_trace_dump(int fd);
+
+// Write the ring as raw ril_trace_record structs, oldest record first
+void ril_trace_dump_raw(int fd);
+
+#endif // RIL_TRACE_H
@@ -0,0 +1,33 @@
+/* //device/libs/telephony/ril_unsol_commands_samsung.h
+**
+** Copyright 2026, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+    {RIL_UNSOL_RESPONSE_NEW_CB_MSG, responseRaw, WAKE_PARTIAL, REPLAY_ALL},
+    {RIL_UNSOL_RELEASE_COMPLETE_MESSAGE, responseVoid, WAKE_PARTIAL, DONT_KEEP},
+    {RIL_UNSOL_STK_SEND_SMS_RESULT, responseInts, WAKE_PARTIAL, REPLAY_ALL},
+    {RIL_UNSOL_STK_CALL_CONTROL_RESULT, responseString, WAKE_PARTIAL, REPLAY_ALL},
+    {RIL_UNSOL_DUN_CALL_STATUS, responseInts, WAKE_PARTIAL, DONT_KEEP},
+    {RIL_UNSOL_RESPONSE_LINE_SMS_COUNT, responseInts, WAKE_PARTIAL, DONT_KEEP},
+    {RIL_UNSOL_RESPONSE_LINE_SMS_READ, responseRaw, WAKE_PARTIAL, REPLAY_ALL},
+    {RIL_UNSOL_O2_HOME_ZONE_INFO, responseRaw, WAKE_PARTIAL, DONT_KEEP},
+    {RIL_UNSOL_DEVICE_READY_NOTI, responseVoid, WAKE_PARTIAL, DONT_KEEP},
+    {RIL_UNSOL_GPS_NOTI, responseVoid, WAKE_PARTIAL, DONT_KEEP},
+    {RIL_UNSOL_AM, responseString, WAKE_PARTIAL, DONT_KEEP},
+    {11011, NULL, DONT_WAKE, DONT_KEEP},
+    {11012, NULL, DONT_WAKE, DONT_KEEP},
+    {RIL_UNSOL_SAP, responseRaw, WAKE_PARTIAL, DONT_KEEP},
+    {RIL_UNSOL_RESPONSE_NO_NETWORK_RESPONSE, responseVoid, WAKE_PARTIAL, DONT_KEEP},
+    {RIL_UNSOL_SIM_SMS_STORAGE_AVAILALE, responseVoid, WAKE_PARTIAL, DONT_KEEP},
+    {RIL_UNSOL_HSDPA_STATE_CHANGED, responseInts, WAKE_PARTIAL, REPLAY_LATEST},
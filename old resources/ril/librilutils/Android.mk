@@ -5,7 +5,10 @@ include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES:= \
     librilutils.c \
-    record_stream.c
+    record_stream.c \
+    wake_lock.c
+
+LOCAL_SHARED_LIBRARIES := libhardware_legacy
 
 LOCAL_CFLAGS :=
 
@@ -20,7 +23,8 @@ include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES:= \
     librilutils.c \
-    record_stream.c
+    record_stream.c \
+    wake_lock.c
 
 LOCAL_STATIC_LIBRARIES :=
 
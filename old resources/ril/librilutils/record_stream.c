@@ -26,19 +26,34 @@
 #include <winsock2.h>   /* for ntohl */
 #else
 #include <netinet/in.h>
+#include <sys/uio.h>
 #endif
 
 #define HEADER_SIZE 4
 
+// The ring starts at this size and doubles whenever it fills, up to
+// RECORD_STREAM_MAX_RECORDS maximum-length records
+#define RECORD_STREAM_INITIAL_SIZE 4096
+#define RECORD_STREAM_MAX_RECORDS 4
+
+/*
+ * Bytes read from fd wait in a ring buffer. A record is returned in place
+ * unless it wraps around the end of the ring, in which case it is copied
+ * to scratch; unconsumed bytes are never moved to the front.
+ */
 struct RecordStream {
     int fd;
     size_t maxRecordLen;
 
     unsigned char *buffer;
+    size_t size;
+    size_t maxSize;
+
+    size_t head;        // offset of the first unconsumed byte
+    size_t count;       // unconsumed bytes
+    size_t skip;        // bytes of an oversize record still to discard
 
-    unsigned char *unconsumed;
-    unsigned char *read_end;
-    unsigned char *buffer_end;
+    unsigned char *scratch;
 };
 
 
@@ -46,17 +61,23 @@ extern RecordStream *record_stream_new(int fd, size_t maxRecordLen)
 {
     RecordStream *ret;
 
-    assert (maxRecordLen <= 0xffff);
-
     ret = (RecordStream *)calloc(1, sizeof(RecordStream));
+    if (ret == NULL) {
+        return NULL;
+    }
 
     ret->fd = fd;
     ret->maxRecordLen = maxRecordLen;
-    ret->buffer = (unsigned char *)malloc (maxRecordLen + HEADER_SIZE);
-
-    ret->unconsumed = ret->buffer;
-    ret->read_end = ret->buffer;
-    ret->buffer_end = ret->buffer + maxRecordLen + HEADER_SIZE;
+    ret->maxSize = RECORD_STREAM_MAX_RECORDS * (maxRecordLen + HEADER_SIZE);
+    ret->size = RECORD_STREAM_INITIAL_SIZE;
+    if (ret->size > ret->maxSize) {
+        ret->size = ret->maxSize;
+    }
+    ret->buffer = (unsigned char *)malloc (ret->size);
+    if (ret->buffer == NULL) {
+        free(ret);
+        return NULL;
+    }
 
     return ret;
 }
@@ -65,56 +86,145 @@ extern RecordStream *record_stream_new(int fd, size_t maxRecordLen)
 extern void record_stream_free(RecordStream *rs)
 {
     free(rs->buffer);
+    free(rs->scratch);
     free(rs);
 }
 
-
-/* returns NULL; if there isn't a full record in the buffer */
-static unsigned char * getEndOfRecord (unsigned char *p_begin,
-                                            unsigned char *p_end)
+// Copy len unconsumed bytes starting offset bytes past head
+static void copyOut (RecordStream *p_rs, size_t offset, unsigned char *dst,
+                        size_t len)
 {
-    size_t len;
-    unsigned char * p_ret;
+    size_t start = p_rs->head + offset;
+    size_t first;
 
-    if (p_end < p_begin + HEADER_SIZE) {
-        return NULL;
+    if (start >= p_rs->size) {
+        start -= p_rs->size;
+    }
+    first = p_rs->size - start;
+    if (first > len) {
+        first = len;
     }
 
-    //First four bytes are length
-    len = ntohl(*((uint32_t *)p_begin));
+    memcpy(dst, p_rs->buffer + start, first);
+    memcpy(dst + first, p_rs->buffer, len - first);
+}
 
-    p_ret = p_begin + HEADER_SIZE + len;
+static void consume (RecordStream *p_rs, size_t len)
+{
+    p_rs->count -= len;
+    if (p_rs->count == 0) {
+        // empty: restart at the front so the next read is contiguous
+        p_rs->head = 0;
+    } else {
+        p_rs->head += len;
+        if (p_rs->head >= p_rs->size) {
+            p_rs->head -= p_rs->size;
+        }
+    }
+}
 
-    if (p_end < p_ret) {
-        return NULL;
+// Double the ring, unwrapping the unconsumed bytes. Returns -1 if at maxSize.
+static int grow (RecordStream *p_rs)
+{
+    size_t newSize = p_rs->size * 2;
+    unsigned char *newBuffer;
+
+    if (p_rs->size >= p_rs->maxSize) {
+        return -1;
+    }
+    if (newSize > p_rs->maxSize) {
+        newSize = p_rs->maxSize;
+    }
+
+    newBuffer = (unsigned char *)malloc(newSize);
+    if (newBuffer == NULL) {
+        return -1;
     }
+    copyOut(p_rs, 0, newBuffer, p_rs->count);
 
-    return p_ret;
+    free(p_rs->buffer);
+    p_rs->buffer = newBuffer;
+    p_rs->size = newSize;
+    p_rs->head = 0;
+
+    return 0;
 }
 
-static void *getNextRecord (RecordStream *p_rs, size_t *p_outRecordLen)
+/*
+ * Returns 1 with the record if a full one is buffered, 0 if more bytes
+ * are needed, -1 / errno = EFBIG when starting to discard an oversize record
+ */
+static int getNextRecord (RecordStream *p_rs, void **p_outRecord,
+                            size_t *p_outRecordLen)
 {
-    unsigned char *record_start, *record_end;
+    unsigned char header[HEADER_SIZE];
+    size_t len;
+    size_t start;
+
+    if (p_rs->skip > 0) {
+        len = p_rs->skip < p_rs->count ? p_rs->skip : p_rs->count;
+        consume(p_rs, len);
+        p_rs->skip -= len;
+        if (p_rs->skip > 0) {
+            return 0;
+        }
+    }
 
-    record_end = getEndOfRecord (p_rs->unconsumed, p_rs->read_end);
+    if (p_rs->count < HEADER_SIZE) {
+        return 0;
+    }
+
+    //First four bytes are length
+    copyOut(p_rs, 0, header, HEADER_SIZE);
+    len = ntohl(*((uint32_t *)header));
+
+    if (len > p_rs->maxRecordLen) {
+        consume(p_rs, HEADER_SIZE);
+        p_rs->skip = len;
+        errno = EFBIG;
+        return -1;
+    }
 
-    if (record_end != NULL) {
-        /* one full line in the buffer */
-        record_start = p_rs->unconsumed + HEADER_SIZE;
-        p_rs->unconsumed = record_end;
+    if (p_rs->count < HEADER_SIZE + len) {
+        return 0;
+    }
 
-        *p_outRecordLen = record_end - record_start;
+    start = p_rs->head + HEADER_SIZE;
+    if (start >= p_rs->size) {
+        start -= p_rs->size;
+    }
 
-        return record_start;
+    if (start + len <= p_rs->size) {
+        *p_outRecord = p_rs->buffer + start;
+    } else {
+        if (p_rs->scratch == NULL) {
+            p_rs->scratch = (unsigned char *)malloc(p_rs->maxRecordLen);
+            if (p_rs->scratch == NULL) {
+                errno = ENOMEM;
+                return -1;
+            }
+        }
+        copyOut(p_rs, HEADER_SIZE, p_rs->scratch, len);
+        *p_outRecord = p_rs->scratch;
     }
 
-    return NULL;
+    *p_outRecordLen = len;
+    consume(p_rs, HEADER_SIZE + len);
+
+    return 1;
 }
 
 /**
  * Reads the next record from stream fd
- * Records are prefixed by a 16-bit big endian length value
- * Records may not be larger than maxRecordLen
+ * Records are prefixed by a 32-bit big endian length value
+ * Records may not be larger than maxRecordLen; a larger one is
+ * discarded and reported once with errno = EFBIG, after which
+ * reading may continue with the following record
+ *
+ * Each read takes as much as the socket has and fits in the buffer,
+ * so several records are usually decoded per read()
+ *
+ * The returned record is valid until the next call
  *
  * Doesn't guard against EINTR
  *
@@ -127,43 +237,41 @@ static void *getNextRecord (RecordStream *p_rs, size_t *p_outRecordLen)
 int record_stream_get_next (RecordStream *p_rs, void ** p_outRecord,
                                     size_t *p_outRecordLen)
 {
-    void *ret;
-
+    struct iovec iov[2];
+    size_t tail;
+    int iovcnt;
+    int ret;
     ssize_t countRead;
 
     /* is there one record already in the buffer? */
-    ret = getNextRecord (p_rs, p_outRecordLen);
+    ret = getNextRecord (p_rs, p_outRecord, p_outRecordLen);
 
-    if (ret != NULL) {
-        *p_outRecord = ret;
-        return 0;
+    if (ret != 0) {
+        return ret > 0 ? 0 : -1;
     }
 
-    // if the buffer is full and we don't have a full record
-    if (p_rs->unconsumed == p_rs->buffer
-        && p_rs->read_end == p_rs->buffer_end
-    ) {
-        // this should never happen
-        //ALOGE("max record length exceeded\n");
-        assert (0);
-        errno = EFBIG;
+    if (p_rs->count == p_rs->size && grow(p_rs) < 0) {
+        // cannot happen: maxSize holds a maximum-length record
+        errno = ENOMEM;
         return -1;
     }
 
-    if (p_rs->unconsumed != p_rs->buffer) {
-        // move remainder to the beginning of the buffer
-        size_t toMove;
-
-        toMove = p_rs->read_end - p_rs->unconsumed;
-        if (toMove) {
-            memmove(p_rs->buffer, p_rs->unconsumed, toMove);
-        }
-
-        p_rs->read_end = p_rs->buffer + toMove;
-        p_rs->unconsumed = p_rs->buffer;
+    // read into all the free space, which may wrap around the end
+    tail = p_rs->head + p_rs->count;
+    if (tail >= p_rs->size) {
+        tail -= p_rs->size;
+        iov[0].iov_base = p_rs->buffer + tail;
+        iov[0].iov_len = p_rs->head - tail;
+        iovcnt = 1;
+    } else {
+        iov[0].iov_base = p_rs->buffer + tail;
+        iov[0].iov_len = p_rs->size - tail;
+        iov[1].iov_base = p_rs->buffer;
+        iov[1].iov_len = p_rs->head;
+        iovcnt = p_rs->head > 0 ? 2 : 1;
     }
 
-    countRead = read (p_rs->fd, p_rs->read_end, p_rs->buffer_end - p_rs->read_end);
+    countRead = readv (p_rs->fd, iov, iovcnt);
 
     if (countRead <= 0) {
         /* note: end-of-stream drops through here too */
@@ -171,16 +279,15 @@ int record_stream_get_next (RecordStream *p_rs, void ** p_outRecord,
         return countRead;
     }
 
-    p_rs->read_end += countRead;
+    p_rs->count += countRead;
 
-    ret = getNextRecord (p_rs, p_outRecordLen);
+    ret = getNextRecord (p_rs, p_outRecord, p_outRecordLen);
 
-    if (ret == NULL) {
+    if (ret == 0) {
         /* not enough of a buffer to for a whole command */
         errno = EAGAIN;
         return -1;
     }
 
-    *p_outRecord = ret;
-    return 0;
+    return ret > 0 ? 0 : -1;
 }
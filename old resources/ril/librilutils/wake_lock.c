@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <telephony/librilutils.h>
+#include <pthread.h>
+#include <hardware_legacy/power.h>
+
+/*
+ * One partial wake lock for the whole process. The kernel lock is only
+ * touched when the reference count goes 0 -> 1 or 1 -> 0; a pending
+ * deadline holds a single reference that later holds extend in place.
+ */
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t s_refs;
+static uint64_t s_deadlineNs;   // 0 when no deadline holds a reference
+static uint64_t s_heldSinceNs;
+static struct ril_wake_lock_stats s_stats;
+
+// Called with s_mutex held
+static void addRef(void)
+{
+    if (s_refs++ == 0) {
+        acquire_wake_lock(PARTIAL_WAKE_LOCK, RIL_WAKE_LOCK_NAME);
+        s_heldSinceNs = ril_nano_time();
+        s_stats.acquisitions++;
+    }
+    if (s_refs > s_stats.maxRefs) {
+        s_stats.maxRefs = s_refs;
+    }
+}
+
+// Called with s_mutex held
+static void dropRef(void)
+{
+    uint64_t heldNs;
+
+    if (s_refs == 0) {
+        // unbalanced release; keep the count from wrapping
+        return;
+    }
+    if (--s_refs == 0) {
+        release_wake_lock(RIL_WAKE_LOCK_NAME);
+        heldNs = ril_nano_time() - s_heldSinceNs;
+        s_stats.heldNs += heldNs;
+        if (heldNs > s_stats.maxHeldNs) {
+            s_stats.maxHeldNs = heldNs;
+        }
+    }
+}
+
+void ril_wake_lock_acquire(void)
+{
+    pthread_mutex_lock(&s_mutex);
+    addRef();
+    s_stats.references++;
+    pthread_mutex_unlock(&s_mutex);
+}
+
+void ril_wake_lock_release(void)
+{
+    pthread_mutex_lock(&s_mutex);
+    dropRef();
+    pthread_mutex_unlock(&s_mutex);
+}
+
+int ril_wake_lock_hold(uint32_t ms)
+{
+    uint64_t deadline = ril_nano_time() + (uint64_t)ms * 1000000;
+    int arm = 0;
+
+    pthread_mutex_lock(&s_mutex);
+
+    if (s_deadlineNs == 0) {
+        addRef();
+        arm = 1;
+    }
+    if (deadline > s_deadlineNs) {
+        s_deadlineNs = deadline;
+    }
+    s_stats.holds++;
+
+    pthread_mutex_unlock(&s_mutex);
+
+    return arm;
+}
+
+uint64_t ril_wake_lock_expire(void)
+{
+    uint64_t now = ril_nano_time();
+    uint64_t remaining = 0;
+
+    pthread_mutex_lock(&s_mutex);
+
+    if (s_deadlineNs != 0) {
+        if (now >= s_deadlineNs) {
+            s_deadlineNs = 0;
+            dropRef();
+        } else {
+            remaining = s_deadlineNs - now;
+        }
+    }
+
+    pthread_mutex_unlock(&s_mutex);
+
+    return remaining;
+}
+
+void ril_wake_lock_get_stats(struct ril_wake_lock_stats *stats)
+{
+    pthread_mutex_lock(&s_mutex);
+
+    *stats = s_stats;
+    stats->refs = s_refs;
+    if (s_refs > 0) {
+        // include the hold in progress
+        stats->heldNs += ril_nano_time() - s_heldSinceNs;
+    }
+
+    pthread_mutex_unlock(&s_mutex);
+}
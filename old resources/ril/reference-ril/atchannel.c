@@ -29,6 +29,12 @@
 #include <time.h>
 #include <unistd.h>
 
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #define LOG_NDEBUG 0
 #define LOG_TAG "AT"
 #include <utils/Log.h>
@@ -43,18 +49,13 @@
 #define NUM_ELEMS(x) (sizeof(x)/sizeof(x[0]))
 
 #define MAX_AT_RESPONSE (8 * 1024)
+#define AT_RESPONSE_ARENA_SIZE 1024
+#define AT_RESPONSE_POOL_SIZE (2 * AT_CHANNELS_MAX)
 #define HANDSHAKE_RETRY_COUNT 8
 #define HANDSHAKE_TIMEOUT_MSEC 250
 
-static pthread_t s_tid_reader;
-static int s_fd = -1;    /* fd of the AT channel */
 static ATUnsolHandler s_unsolHandler;
 
-/* for input buffering */
-
-static char s_ATBuffer[MAX_AT_RESPONSE+1];
-static char *s_ATBufferCur = s_ATBuffer;
-
 #if AT_DEBUG
 void  AT_DUMP(const char*  prefix, const char*  buff, int  len)
 {
@@ -65,25 +66,156 @@ void  AT_DUMP(const char*  prefix, const char*  buff, int  len)
 #endif
 
 /*
- * for current pending command
- * these are protected by s_commandmutex
+ * Storage for the lines of a response, appended to an arena that grows by
+ * chunks; a line never moves once added. The ATResponse comes first so
+ * the pointer handed out converts back. Freed responses go back to
+ * s_responsePool with the inline arena, so most commands allocate nothing.
  */
+typedef struct ATArenaChunk {
+    struct ATArenaChunk *p_next;
+} ATArenaChunk;
+
+typedef struct ATResponseStorage {
+    ATResponse response;
+    ATLine *p_lastIntermediate;
+
+    char *p_arena;                  /* the chunk lines are added to */
+    size_t arenaUsed;
+    size_t arenaSize;
+    ATArenaChunk *p_chunks;         /* chunks past the inline one */
+
+    struct ATResponseStorage *p_nextFree;
+    void *inlineArena[AT_RESPONSE_ARENA_SIZE / sizeof(void *)];
+} ATResponseStorage;
 
-static pthread_mutex_t s_commandmutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t s_commandcond = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t s_responsePoolMutex = PTHREAD_MUTEX_INITIALIZER;
+static ATResponseStorage *s_responsePool;
+static int s_responsePoolCount;
 
-static ATCommandType s_type;
-static const char *s_responsePrefix = NULL;
-static const char *s_smsPDU = NULL;
-static ATResponse *sp_response = NULL;
+/*
+ * A command queued with at_send_command_async(), or a run of them queued
+ * with at_send_commands_async(). The commands and the prefix are copied
+ * in after the struct, so each takes one allocation.
+ */
+typedef struct ATAsyncCommand {
+    struct ATAsyncCommand *p_next;
+    const char *command;        /* the one being sent */
+    int remaining;              /* commands of the run after it */
+    const char *responsePrefix;
+    ATCommandType type;
+    long long timeoutMsec;
+    long long deadline;         /* monotonic msec, set once sent */
+    ATResponseCallback callback;
+    void *param;
+
+    /* the outcome, for the completion thread */
+    int err;
+    ATResponse *p_response;
+} ATAsyncCommand;
+
+/*
+ * One AT channel: a tty, or a DLC of a multiplexed one, with its own
+ * reader thread and at most one command in flight.
+ */
+typedef struct {
+    pthread_t tid_reader;
+    int fd;
+
+    /* for input buffering, see readline() */
+    char ATBuffer[MAX_AT_RESPONSE+1];
+    char *ATBufferCur;
+    char *ATBufferScanned;
+    char *ATBufferEnd;
+
+    /*
+     * for current pending command
+     * these are protected by commandmutex
+     */
+    pthread_mutex_t commandmutex;
+    pthread_cond_t commandcond;
+    pthread_cond_t idlecond;    /* signalled when a command completes */
+
+    ATCommandType type;
+    const char *responsePrefix;
+    const char *smsPDU;
+    ATResponse *p_response;
+    int readerClosed;
+
+    /*
+     * p_async is the async command in flight, when p_response is its
+     * own; the queue holds the ones waiting for the channel. Synchronous
+     * callers waiting for the channel go before the queue.
+     */
+    ATAsyncCommand *p_async;
+    ATAsyncCommand *asyncHead;
+    ATAsyncCommand *asyncTail;
+    int syncWaiters;
+} ATChannel;
+
+static ATChannel s_channels[AT_CHANNELS_MAX] = {
+    [0 ... AT_CHANNELS_MAX - 1] = {
+        .fd = -1,
+        .commandmutex = PTHREAD_MUTEX_INITIALIZER,
+        .commandcond = PTHREAD_COND_INITIALIZER,
+        .idlecond = PTHREAD_COND_INITIALIZER,
+    },
+};
+
+/* Channels opened; the primary channel, s_channels[0], is always first */
+static int s_channelCount;
+
+/*
+ * Commands that neither depend on nor change the state other commands
+ * leave behind, so they may run on a secondary channel. Each class keeps
+ * to one channel, which keeps its commands in order. Everything else runs
+ * on the primary channel in the order it was issued.
+ */
+typedef enum {
+    AT_CLASS_PRIMARY,
+    AT_CLASS_SCAN,      /* network scan, which can take minutes */
+    AT_CLASS_SIM,       /* SIM file and status reads */
+    AT_CLASS_STATUS,    /* polled signal and registration state */
+    AT_CLASS_CALL,      /* call list */
+} ATChannelClass;
+
+static const struct {
+    const char *prefix;
+    ATChannelClass channelClass;
+} s_commandClasses[] = {
+    { "AT+CRSM=", AT_CLASS_SIM },
+    { "AT+CSIM=", AT_CLASS_SIM },
+    { "AT+CIMI", AT_CLASS_SIM },
+    { "AT+CPIN?", AT_CLASS_SIM },
+    { "AT+CSQ", AT_CLASS_STATUS },
+    { "AT+CREG?", AT_CLASS_STATUS },
+    { "AT+CGREG?", AT_CLASS_STATUS },
+    { "AT+COPS?", AT_CLASS_STATUS },
+    { "AT+CLCC", AT_CLASS_CALL },
+    { "AT+COPS=?", AT_CLASS_SCAN },
+};
 
 static void (*s_onTimeout)(void) = NULL;
 static void (*s_onReaderClosed)(void) = NULL;
-static int s_readerClosed;
 
-static void onReaderClosed();
-static int writeCtrlZ (const char *s);
-static int writeline (const char *s);
+/*
+ * Async commands that have finished, waiting for the completion thread
+ * to call back. A new deadline bumps s_deadlineGeneration so that the
+ * completion thread looks at the channels again.
+ */
+static pthread_once_t s_completionOnce = PTHREAD_ONCE_INIT;
+static int s_completionStarted;
+static pthread_mutex_t s_completionMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_completionCond = PTHREAD_COND_INITIALIZER;
+static ATAsyncCommand *s_completedHead;
+static ATAsyncCommand *s_completedTail;
+static unsigned s_deadlineGeneration;
+
+static void onReaderClosed(ATChannel *p_channel);
+static void startNextCommand(ATChannel *p_channel);
+static void finishAsyncCommand(ATChannel *p_channel, int err);
+static void failAsyncCommands(ATChannel *p_channel, int err);
+static int writeCtrlZ (ATChannel *p_channel, const char *s);
+static int writeline (ATChannel *p_channel, const char *s);
 
 #ifndef USE_NP
 static void setTimespecRelative(struct timespec *p_ts, long long msec)
@@ -97,6 +229,12 @@ static void setTimespecRelative(struct timespec *p_ts, long long msec)
        a relative time again */
     p_ts->tv_sec = tv.tv_sec + (msec / 1000);
     p_ts->tv_nsec = (tv.tv_usec + (msec % 1000) * 1000L ) * 1000L;
+
+    /* pthread_cond_timedwait rejects tv_nsec past a second with EINVAL */
+    if (p_ts->tv_nsec >= 1000000000L) {
+        p_ts->tv_sec++;
+        p_ts->tv_nsec -= 1000000000L;
+    }
 }
 #endif /*USE_NP*/
 
@@ -115,111 +253,129 @@ static void sleepMsec(long long msec)
 
 
 
-/** add an intermediate response to sp_response*/
-static void addIntermediate(const char *line)
+/**
+ * Returns size bytes from the response's arena, adding a chunk at least
+ * twice the size of the last one if it is full
+ */
+static void *arenaAlloc(ATResponseStorage *p_storage, size_t size)
 {
-    ATLine *p_new;
+    void *p;
 
-    p_new = (ATLine  *) malloc(sizeof(ATLine));
+    /* keep the ATLines carved out of the arena aligned */
+    size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
 
-    p_new->line = strdup(line);
+    if (p_storage->arenaSize - p_storage->arenaUsed < size) {
+        ATArenaChunk *p_chunk;
+        size_t chunkSize = p_storage->arenaSize * 2;
 
-    /* note: this adds to the head of the list, so the list
-       will be in reverse order of lines received. the order is flipped
-       again before passing on to the command issuer */
-    p_new->p_next = sp_response->p_intermediates;
-    sp_response->p_intermediates = p_new;
-}
+        if (chunkSize < size) {
+            chunkSize = size;
+        }
 
+        p_chunk = (ATArenaChunk *) malloc(sizeof(ATArenaChunk) + chunkSize);
+        if (p_chunk == NULL) {
+            return NULL;
+        }
 
-/**
- * returns 1 if line is a final response indicating error
- * See 27.007 annex B
- * WARNING: NO CARRIER and others are sometimes unsolicited
- */
-static const char * s_finalResponsesError[] = {
-    "ERROR",
-    "+CMS ERROR:",
-    "+CME ERROR:",
-    "NO CARRIER", /* sometimes! */
-    "NO ANSWER",
-    "NO DIALTONE",
-};
-static int isFinalResponseError(const char *line)
-{
-    size_t i;
+        p_chunk->p_next = p_storage->p_chunks;
+        p_storage->p_chunks = p_chunk;
 
-    for (i = 0 ; i < NUM_ELEMS(s_finalResponsesError) ; i++) {
-        if (strStartsWith(line, s_finalResponsesError[i])) {
-            return 1;
-        }
+        p_storage->p_arena = (char *)(p_chunk + 1);
+        p_storage->arenaUsed = 0;
+        p_storage->arenaSize = chunkSize;
     }
 
-    return 0;
+    p = p_storage->p_arena + p_storage->arenaUsed;
+    p_storage->arenaUsed += size;
+
+    return p;
 }
 
-/**
- * returns 1 if line is a final response indicating success
- * See 27.007 annex B
- * WARNING: NO CARRIER and others are sometimes unsolicited
- */
-static const char * s_finalResponsesSuccess[] = {
-    "OK",
-    "CONNECT"       /* some stacks start up data on another channel */
-};
-static int isFinalResponseSuccess(const char *line)
+/** copies line into p_response's arena, returns NULL if out of memory */
+static char *responseStrdup(ATResponse *p_response, const char *line)
 {
-    size_t i;
+    size_t len = strlen(line) + 1;
+    char *p;
 
-    for (i = 0 ; i < NUM_ELEMS(s_finalResponsesSuccess) ; i++) {
-        if (strStartsWith(line, s_finalResponsesSuccess[i])) {
-            return 1;
-        }
+    p = (char *) arenaAlloc((ATResponseStorage *) p_response, len);
+    if (p != NULL) {
+        memcpy(p, line, len);
     }
 
-    return 0;
+    return p;
 }
 
-/**
- * returns 1 if line is a final response, either  error or success
- * See 27.007 annex B
- * WARNING: NO CARRIER and others are sometimes unsolicited
- */
-static int isFinalResponse(const char *line)
+/** add an intermediate response to p_channel->p_response */
+static void addIntermediate(ATChannel *p_channel, const char *line)
 {
-    return isFinalResponseSuccess(line) || isFinalResponseError(line);
+    ATResponseStorage *p_storage = (ATResponseStorage *) p_channel->p_response;
+    size_t len = strlen(line) + 1;
+    ATLine *p_new;
+
+    /* the line is stored right after its ATLine */
+    p_new = (ATLine *) arenaAlloc(p_storage, sizeof(ATLine) + len);
+    if (p_new == NULL) {
+        RLOGE("Dropping intermediate response: out of memory\n");
+        return;
+    }
+
+    p_new->line = (char *)(p_new + 1);
+    memcpy(p_new->line, line, len);
+    p_new->p_next = NULL;
+
+    /* kept in the order received */
+    if (p_storage->p_lastIntermediate == NULL) {
+        p_storage->response.p_intermediates = p_new;
+    } else {
+        p_storage->p_lastIntermediate->p_next = p_new;
+    }
+    p_storage->p_lastIntermediate = p_new;
 }
 
 
 /**
- * returns 1 if line is the first line in (what will be) a two-line
- * SMS unsolicited response
+ * What the line reader makes of a line, from its prefix
+ * See 27.007 annex B
+ * WARNING: NO CARRIER and others are sometimes unsolicited
  */
-static const char * s_smsUnsoliciteds[] = {
-    "+CMT:",
-    "+CDS:",
-    "+CBM:"
+typedef enum {
+    AT_LINE_OTHER,
+    AT_LINE_FINAL_SUCCESS,      /* final response indicating success */
+    AT_LINE_FINAL_ERROR,        /* final response indicating error */
+    AT_LINE_SMS_UNSOLICITED,    /* first line in (what will be) a two-line
+                                   SMS unsolicited response */
+} ATLineClass;
+
+static const PrefixEntry s_lineClassEntries[] = {
+    { "OK", AT_LINE_FINAL_SUCCESS },
+    { "CONNECT", AT_LINE_FINAL_SUCCESS }, /* some stacks start up data on
+                                             another channel */
+    { "ERROR", AT_LINE_FINAL_ERROR },
+    { "+CMS ERROR:", AT_LINE_FINAL_ERROR },
+    { "+CME ERROR:", AT_LINE_FINAL_ERROR },
+    { "NO CARRIER", AT_LINE_FINAL_ERROR }, /* sometimes! */
+    { "NO ANSWER", AT_LINE_FINAL_ERROR },
+    { "NO DIALTONE", AT_LINE_FINAL_ERROR },
+    { "+CMT:", AT_LINE_SMS_UNSOLICITED },
+    { "+CDS:", AT_LINE_SMS_UNSOLICITED },
+    { "+CBM:", AT_LINE_SMS_UNSOLICITED },
 };
-static int isSMSUnsolicited(const char *line)
-{
-    size_t i;
 
-    for (i = 0 ; i < NUM_ELEMS(s_smsUnsoliciteds) ; i++) {
-        if (strStartsWith(line, s_smsUnsoliciteds[i])) {
-            return 1;
-        }
-    }
-
-    return 0;
-}
+static PrefixTable s_lineClasses = PREFIX_TABLE_INITIALIZER(s_lineClassEntries);
 
 
-/** assumes s_commandmutex is held */
-static void handleFinalResponse(const char *line)
+/** assumes p_channel->commandmutex is held */
+static void handleFinalResponse(ATChannel *p_channel, const char *line)
 {
-    sp_response->finalResponse = strdup(line);
+    p_channel->p_response->finalResponse =
+            responseStrdup(p_channel->p_response, line);
 
-    pthread_cond_signal(&s_commandcond);
+    if (p_channel->p_async != NULL) {
+        finishAsyncCommand(p_channel, 0);
+        return;
+    }
+
+    pthread_cond_signal(&p_channel->commandcond);
 }
 
 static void handleUnsolicited(const char *line)
@@ -229,33 +385,38 @@ static void handleUnsolicited(const char *line)
     }
 }
 
-static void processLine(const char *line)
+static void processLine(ATChannel *p_channel, const char *line,
+                    ATLineClass lineClass)
 {
-    pthread_mutex_lock(&s_commandmutex);
+    ATResponse *p_response;
+
+    pthread_mutex_lock(&p_channel->commandmutex);
 
-    if (sp_response == NULL) {
+    p_response = p_channel->p_response;
+
+    if (p_response == NULL) {
         /* no command pending */
         handleUnsolicited(line);
-    } else if (isFinalResponseSuccess(line)) {
-        sp_response->success = 1;
-        handleFinalResponse(line);
-    } else if (isFinalResponseError(line)) {
-        sp_response->success = 0;
-        handleFinalResponse(line);
-    } else if (s_smsPDU != NULL && 0 == strcmp(line, "> ")) {
+    } else if (lineClass == AT_LINE_FINAL_SUCCESS) {
+        p_response->success = 1;
+        handleFinalResponse(p_channel, line);
+    } else if (lineClass == AT_LINE_FINAL_ERROR) {
+        p_response->success = 0;
+        handleFinalResponse(p_channel, line);
+    } else if (p_channel->smsPDU != NULL && 0 == strcmp(line, "> ")) {
         // See eg. TS 27.005 4.3
         // Commands like AT+CMGS have a "> " prompt
-        writeCtrlZ(s_smsPDU);
-        s_smsPDU = NULL;
-    } else switch (s_type) {
+        writeCtrlZ(p_channel, p_channel->smsPDU);
+        p_channel->smsPDU = NULL;
+    } else switch (p_channel->type) {
         case NO_RESULT:
             handleUnsolicited(line);
             break;
         case NUMERIC:
-            if (sp_response->p_intermediates == NULL
+            if (p_response->p_intermediates == NULL
                 && isdigit(line[0])
             ) {
-                addIntermediate(line);
+                addIntermediate(p_channel, line);
             } else {
                 /* either we already have an intermediate response or
                    the line doesn't begin with a digit */
@@ -263,50 +424,84 @@ static void processLine(const char *line)
             }
             break;
         case SINGLELINE:
-            if (sp_response->p_intermediates == NULL
-                && strStartsWith (line, s_responsePrefix)
+            if (p_response->p_intermediates == NULL
+                && strStartsWith (line, p_channel->responsePrefix)
             ) {
-                addIntermediate(line);
+                addIntermediate(p_channel, line);
             } else {
                 /* we already have an intermediate response */
                 handleUnsolicited(line);
             }
             break;
         case MULTILINE:
-            if (strStartsWith (line, s_responsePrefix)) {
-                addIntermediate(line);
+            if (strStartsWith (line, p_channel->responsePrefix)) {
+                addIntermediate(p_channel, line);
             } else {
                 handleUnsolicited(line);
             }
         break;
 
         default: /* this should never be reached */
-            RLOGE("Unsupported AT command type %d\n", s_type);
+            RLOGE("Unsupported AT command type %d\n", p_channel->type);
             handleUnsolicited(line);
         break;
     }
 
-    pthread_mutex_unlock(&s_commandmutex);
+    pthread_mutex_unlock(&p_channel->commandmutex);
 }
 
 
 /**
- * Returns a pointer to the end of the next line
- * special-cases the "> " SMS prompt
+ * Returns a pointer to the first \r or \n in [cur, end)
+ *
+ * returns NULL if there is none
  *
- * returns NULL if there is no complete line
+ * Bulk responses (phonebook, SMS lists, cell lists) keep the reader thread
+ * in here, so it compares 16 bytes at a time where the CPU can.
  */
-static char * findNextEOL(char *cur)
+static char * findNextEOL(char *cur, char *end)
 {
-    if (cur[0] == '>' && cur[1] == ' ' && cur[2] == '\0') {
-        /* SMS prompt character...not \r terminated */
-        return cur+2;
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+    const uint8x16_t cr = vdupq_n_u8('\r');
+    const uint8x16_t lf = vdupq_n_u8('\n');
+
+    for (; end - cur >= 16 ; cur += 16) {
+        uint8x16_t v = vld1q_u8((const uint8_t *) cur);
+        uint64x2_t eol = vreinterpretq_u64_u8(
+                vorrq_u8(vceqq_u8(v, cr), vceqq_u8(v, lf)));
+        uint64_t lo = vgetq_lane_u64(eol, 0);
+        uint64_t hi = vgetq_lane_u64(eol, 1);
+
+        /* each matching byte is 0xff; lanes are little endian */
+        if (lo != 0) {
+            return cur + (__builtin_ctzll(lo) >> 3);
+        }
+        if (hi != 0) {
+            return cur + 8 + (__builtin_ctzll(hi) >> 3);
+        }
     }
+#elif defined(__SSE2__)
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
 
-    // Find next newline
-    while (*cur != '\0' && *cur != '\r' && *cur != '\n') cur++;
+    for (; end - cur >= 16 ; cur += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) cur);
+        int eol = _mm_movemask_epi8(
+                _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)));
 
-    return *cur == '\0' ? NULL : cur;
+        if (eol != 0) {
+            return cur + __builtin_ctz(eol);
+        }
+    }
+#endif
+
+    for (; cur < end ; cur++) {
+        if (*cur == '\r' || *cur == '\n') {
+            return cur;
+        }
+    }
+
+    return NULL;
 }
 
 
@@ -318,73 +513,80 @@ static char * findNextEOL(char *cur)
  *
  * This function exists because as of writing, android libc does not
  * have buffered stdio.
+ *
+ * Unconsumed input is [ATBufferCur, ATBufferEnd); ATBufferScanned marks
+ * how far it is known to hold no end of line, so each byte is scanned
+ * once however many reads a long line takes. A partial line is moved to
+ * the start of the buffer only when the room after it runs low.
  */
 
-static const char *readline()
+static const char *readline(ATChannel *p_channel)
 {
     ssize_t count;
+    size_t len;
 
-    char *p_read = NULL;
     char *p_eol = NULL;
+    char *p_limit = p_channel->ATBuffer + MAX_AT_RESPONSE;
     char *ret;
 
-    /* this is a little odd. I use *s_ATBufferCur == 0 to
-     * mean "buffer consumed completely". If it points to a character, than
-     * the buffer continues until a \0
-     */
-    if (*s_ATBufferCur == '\0') {
-        /* empty buffer */
-        s_ATBufferCur = s_ATBuffer;
-        *s_ATBufferCur = '\0';
-        p_read = s_ATBuffer;
-    } else {   /* *s_ATBufferCur != '\0' */
-        /* there's data in the buffer from the last read */
-
+    for (;;) {
         // skip over leading newlines
-        while (*s_ATBufferCur == '\r' || *s_ATBufferCur == '\n')
-            s_ATBufferCur++;
+        while (p_channel->ATBufferCur < p_channel->ATBufferEnd
+                && (*p_channel->ATBufferCur == '\r'
+                    || *p_channel->ATBufferCur == '\n')) {
+            p_channel->ATBufferCur++;
+        }
 
-        p_eol = findNextEOL(s_ATBufferCur);
+        if (p_channel->ATBufferScanned < p_channel->ATBufferCur) {
+            p_channel->ATBufferScanned = p_channel->ATBufferCur;
+        }
 
-        if (p_eol == NULL) {
-            /* a partial line. move it up and prepare to read more */
-            size_t len;
+        len = p_channel->ATBufferEnd - p_channel->ATBufferCur;
 
-            len = strlen(s_ATBufferCur);
+        if (len == 2 && p_channel->ATBufferCur[0] == '>'
+                && p_channel->ATBufferCur[1] == ' ') {
+            /* SMS prompt character...not \r terminated */
+            p_eol = p_channel->ATBufferEnd;
+            break;
+        }
+
+        p_eol = findNextEOL(p_channel->ATBufferScanned, p_channel->ATBufferEnd);
 
-            memmove(s_ATBuffer, s_ATBufferCur, len + 1);
-            p_read = s_ATBuffer + len;
-            s_ATBufferCur = s_ATBuffer;
+        if (p_eol != NULL) {
+            break;
         }
-        /* Otherwise, (p_eol !- NULL) there is a complete line  */
-        /* that will be returned the while () loop below        */
-    }
 
-    while (p_eol == NULL) {
-        if (0 == MAX_AT_RESPONSE - (p_read - s_ATBuffer)) {
+        p_channel->ATBufferScanned = p_channel->ATBufferEnd;
+
+        if (len == 0) {
+            /* empty buffer */
+            p_channel->ATBufferCur = p_channel->ATBuffer;
+            p_channel->ATBufferScanned = p_channel->ATBuffer;
+            p_channel->ATBufferEnd = p_channel->ATBuffer;
+        } else if (p_limit - p_channel->ATBufferEnd < MAX_AT_RESPONSE / 4
+                && p_channel->ATBufferCur != p_channel->ATBuffer) {
+            /* a partial line. move it up and prepare to read more */
+            memmove(p_channel->ATBuffer, p_channel->ATBufferCur, len);
+            p_channel->ATBufferCur = p_channel->ATBuffer;
+            p_channel->ATBufferScanned = p_channel->ATBuffer + len;
+            p_channel->ATBufferEnd = p_channel->ATBuffer + len;
+        } else if (p_channel->ATBufferEnd == p_limit) {
             RLOGE("ERROR: Input line exceeded buffer\n");
             /* ditch buffer and start over again */
-            s_ATBufferCur = s_ATBuffer;
-            *s_ATBufferCur = '\0';
-            p_read = s_ATBuffer;
+            p_channel->ATBufferCur = p_channel->ATBuffer;
+            p_channel->ATBufferScanned = p_channel->ATBuffer;
+            p_channel->ATBufferEnd = p_channel->ATBuffer;
         }
 
         do {
-            count = read(s_fd, p_read,
-                            MAX_AT_RESPONSE - (p_read - s_ATBuffer));
+            count = read(p_channel->fd, p_channel->ATBufferEnd,
+                            p_limit - p_channel->ATBufferEnd);
         } while (count < 0 && errno == EINTR);
 
         if (count > 0) {
-            AT_DUMP( "<< ", p_read, count );
+            AT_DUMP( "<< ", p_channel->ATBufferEnd, count );
 
-            p_read[count] = '\0';
-
-            // skip over leading newlines
-            while (*s_ATBufferCur == '\r' || *s_ATBufferCur == '\n')
-                s_ATBufferCur++;
-
-            p_eol = findNextEOL(s_ATBufferCur);
-            p_read += count;
+            p_channel->ATBufferEnd += count;
         } else if (count <= 0) {
             /* read error encountered or EOF reached */
             if(count == 0) {
@@ -398,27 +600,32 @@ static const char *readline()
 
     /* a full line in the buffer. Place a \0 over the \r and return */
 
-    ret = s_ATBufferCur;
-    *p_eol = '\0';
-    s_ATBufferCur = p_eol + 1; /* this will always be <= p_read,    */
-                              /* and there will be a \0 at *p_read */
+    ret = p_channel->ATBufferCur;
+    *p_eol = '\0';   /* the buffer has room for this after ATBufferEnd */
+    p_channel->ATBufferCur = p_eol < p_channel->ATBufferEnd
+            ? p_eol + 1 : p_eol;
+    p_channel->ATBufferScanned = p_channel->ATBufferCur;
 
     RLOGD("AT< %s\n", ret);
     return ret;
 }
 
 
-static void onReaderClosed()
+static void onReaderClosed(ATChannel *p_channel)
 {
-    if (s_onReaderClosed != NULL && s_readerClosed == 0) {
+    pthread_mutex_lock(&p_channel->commandmutex);
+    failAsyncCommands(p_channel, AT_ERROR_CHANNEL_CLOSED);
+    pthread_mutex_unlock(&p_channel->commandmutex);
+
+    if (s_onReaderClosed != NULL && p_channel->readerClosed == 0) {
 
-        pthread_mutex_lock(&s_commandmutex);
+        pthread_mutex_lock(&p_channel->commandmutex);
 
-        s_readerClosed = 1;
+        p_channel->readerClosed = 1;
 
-        pthread_cond_signal(&s_commandcond);
+        pthread_cond_signal(&p_channel->commandcond);
 
-        pthread_mutex_unlock(&s_commandmutex);
+        pthread_mutex_unlock(&p_channel->commandmutex);
 
         s_onReaderClosed();
     }
@@ -427,16 +634,22 @@ static void onReaderClosed()
 
 static void *readerLoop(void *arg)
 {
+    ATChannel *p_channel = (ATChannel *) arg;
+
     for (;;) {
         const char * line;
+        ATLineClass lineClass;
 
-        line = readline();
+        line = readline(p_channel);
 
         if (line == NULL) {
             break;
         }
 
-        if(isSMSUnsolicited(line)) {
+        lineClass = (ATLineClass) prefixTableLookup(&s_lineClasses, line,
+                        AT_LINE_OTHER);
+
+        if(lineClass == AT_LINE_SMS_UNSOLICITED) {
             char *line1;
             const char *line2;
 
@@ -444,7 +657,7 @@ static void *readerLoop(void *arg)
             // till next call to 'readline()' hence making a copy of line
             // before calling readline again.
             line1 = strdup(line);
-            line2 = readline();
+            line2 = readline(p_channel);
 
             if (line2 == NULL) {
                 break;
@@ -455,11 +668,11 @@ static void *readerLoop(void *arg)
             }
             free(line1);
         } else {
-            processLine(line);
+            processLine(p_channel, line, lineClass);
         }
     }
 
-    onReaderClosed();
+    onReaderClosed(p_channel);
 
     return NULL;
 }
@@ -471,13 +684,13 @@ static void *readerLoop(void *arg)
  * This function exists because as of writing, android libc does not
  * have buffered stdio.
  */
-static int writeline (const char *s)
+static int writeline (ATChannel *p_channel, const char *s)
 {
     size_t cur = 0;
     size_t len = strlen(s);
     ssize_t written;
 
-    if (s_fd < 0 || s_readerClosed > 0) {
+    if (p_channel->fd < 0 || p_channel->readerClosed > 0) {
         return AT_ERROR_CHANNEL_CLOSED;
     }
 
@@ -488,7 +701,7 @@ static int writeline (const char *s)
     /* the main string */
     while (cur < len) {
         do {
-            written = write (s_fd, s + cur, len - cur);
+            written = write (p_channel->fd, s + cur, len - cur);
         } while (written < 0 && errno == EINTR);
 
         if (written < 0) {
@@ -501,7 +714,7 @@ static int writeline (const char *s)
     /* the \r  */
 
     do {
-        written = write (s_fd, "\r" , 1);
+        written = write (p_channel->fd, "\r" , 1);
     } while ((written < 0 && errno == EINTR) || (written == 0));
 
     if (written < 0) {
@@ -510,13 +723,13 @@ static int writeline (const char *s)
 
     return 0;
 }
-static int writeCtrlZ (const char *s)
+static int writeCtrlZ (ATChannel *p_channel, const char *s)
 {
     size_t cur = 0;
     size_t len = strlen(s);
     ssize_t written;
 
-    if (s_fd < 0 || s_readerClosed > 0) {
+    if (p_channel->fd < 0 || p_channel->readerClosed > 0) {
         return AT_ERROR_CHANNEL_CLOSED;
     }
 
@@ -527,7 +740,7 @@ static int writeCtrlZ (const char *s)
     /* the main string */
     while (cur < len) {
         do {
-            written = write (s_fd, s + cur, len - cur);
+            written = write (p_channel->fd, s + cur, len - cur);
         } while (written < 0 && errno == EINTR);
 
         if (written < 0) {
@@ -540,7 +753,7 @@ static int writeCtrlZ (const char *s)
     /* the ^Z  */
 
     do {
-        written = write (s_fd, "\032" , 1);
+        written = write (p_channel->fd, "\032" , 1);
     } while ((written < 0 && errno == EINTR) || (written == 0));
 
     if (written < 0) {
@@ -550,43 +763,44 @@ static int writeCtrlZ (const char *s)
     return 0;
 }
 
-static void clearPendingCommand()
+static void clearPendingCommand(ATChannel *p_channel)
 {
-    if (sp_response != NULL) {
-        at_response_free(sp_response);
+    if (p_channel->p_response != NULL) {
+        at_response_free(p_channel->p_response);
     }
 
-    sp_response = NULL;
-    s_responsePrefix = NULL;
-    s_smsPDU = NULL;
+    p_channel->p_response = NULL;
+    p_channel->responsePrefix = NULL;
+    p_channel->smsPDU = NULL;
+
+    startNextCommand(p_channel);
 }
 
 
-/**
- * Starts AT handler on stream "fd'
- * returns 0 on success, -1 on error
- */
-int at_open(int fd, ATUnsolHandler h)
+/** Starts the reader of channel index on stream "fd" */
+static int openChannel(int index, int fd)
 {
+    ATChannel *p_channel = &s_channels[index];
     int ret;
-    pthread_t tid;
     pthread_attr_t attr;
 
-    s_fd = fd;
-    s_unsolHandler = h;
-    s_readerClosed = 0;
+    p_channel->fd = fd;
+    p_channel->readerClosed = 0;
+    p_channel->ATBufferCur = p_channel->ATBuffer;
+    p_channel->ATBufferScanned = p_channel->ATBuffer;
+    p_channel->ATBufferEnd = p_channel->ATBuffer;
 
-    s_responsePrefix = NULL;
-    s_smsPDU = NULL;
-    sp_response = NULL;
+    p_channel->responsePrefix = NULL;
+    p_channel->smsPDU = NULL;
+    p_channel->p_response = NULL;
 
     pthread_attr_init (&attr);
     pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
 
-    ret = pthread_create(&s_tid_reader, &attr, readerLoop, &attr);
+    ret = pthread_create(&p_channel->tid_reader, &attr, readerLoop, p_channel);
 
-    if (ret < 0) {
-        perror ("pthread_create");
+    if (ret != 0) {
+        RLOGE("pthread_create: %s", strerror(ret));
         return -1;
     }
 
@@ -594,69 +808,414 @@ int at_open(int fd, ATUnsolHandler h)
     return 0;
 }
 
+/**
+ * Starts AT handler on stream "fd'
+ * returns 0 on success, -1 on error
+ */
+int at_open(int fd, ATUnsolHandler h)
+{
+    s_unsolHandler = h;
+
+    if (openChannel(0, fd) < 0) {
+        return -1;
+    }
+
+    __atomic_store_n(&s_channelCount, 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/**
+ * Adds a secondary channel on stream "fd", after at_open()
+ * returns the channel index on success, -1 on error
+ */
+int at_open_channel(int fd)
+{
+    int index = s_channelCount;
+
+    if (index == 0 || index >= AT_CHANNELS_MAX) {
+        return -1;
+    }
+
+    if (openChannel(index, fd) < 0) {
+        return -1;
+    }
+
+    /* published only once the channel is ready for commands */
+    __atomic_store_n(&s_channelCount, index + 1, __ATOMIC_RELEASE);
+
+    return index;
+}
+
 /* FIXME is it ok to call this from the reader and the command thread? */
 void at_close()
 {
-    if (s_fd >= 0) {
-        close(s_fd);
-    }
-    s_fd = -1;
+    int i;
+
+    for (i = 0 ; i < AT_CHANNELS_MAX ; i++) {
+        ATChannel *p_channel = &s_channels[i];
 
-    pthread_mutex_lock(&s_commandmutex);
+        if (p_channel->fd >= 0) {
+            close(p_channel->fd);
+        }
+        p_channel->fd = -1;
 
-    s_readerClosed = 1;
+        pthread_mutex_lock(&p_channel->commandmutex);
 
-    pthread_cond_signal(&s_commandcond);
+        p_channel->readerClosed = 1;
+        failAsyncCommands(p_channel, AT_ERROR_CHANNEL_CLOSED);
 
-    pthread_mutex_unlock(&s_commandmutex);
+        pthread_cond_signal(&p_channel->commandcond);
+        pthread_cond_broadcast(&p_channel->idlecond);
 
-    /* the reader thread should eventually die */
+        pthread_mutex_unlock(&p_channel->commandmutex);
+    }
+
+    /* the reader threads should eventually die */
 }
 
 static ATResponse * at_response_new()
 {
-    return (ATResponse *) calloc(1, sizeof(ATResponse));
+    ATResponseStorage *p_storage;
+
+    pthread_mutex_lock(&s_responsePoolMutex);
+
+    p_storage = s_responsePool;
+    if (p_storage != NULL) {
+        s_responsePool = p_storage->p_nextFree;
+        s_responsePoolCount--;
+    }
+
+    pthread_mutex_unlock(&s_responsePoolMutex);
+
+    if (p_storage == NULL) {
+        p_storage = (ATResponseStorage *) malloc(sizeof(ATResponseStorage));
+        if (p_storage == NULL) {
+            return NULL;
+        }
+    }
+
+    memset(&p_storage->response, 0, sizeof(ATResponse));
+    p_storage->p_lastIntermediate = NULL;
+    p_storage->p_arena = (char *) p_storage->inlineArena;
+    p_storage->arenaUsed = 0;
+    p_storage->arenaSize = sizeof(p_storage->inlineArena);
+    p_storage->p_chunks = NULL;
+
+    return &p_storage->response;
 }
 
 void at_response_free(ATResponse *p_response)
 {
-    ATLine *p_line;
+    ATResponseStorage *p_storage = (ATResponseStorage *) p_response;
+    ATArenaChunk *p_chunk;
 
     if (p_response == NULL) return;
 
-    p_line = p_response->p_intermediates;
+    while (p_storage->p_chunks != NULL) {
+        p_chunk = p_storage->p_chunks;
+        p_storage->p_chunks = p_chunk->p_next;
+        free(p_chunk);
+    }
+
+    pthread_mutex_lock(&s_responsePoolMutex);
+
+    if (s_responsePoolCount < AT_RESPONSE_POOL_SIZE) {
+        p_storage->p_nextFree = s_responsePool;
+        s_responsePool = p_storage;
+        s_responsePoolCount++;
+        p_storage = NULL;
+    }
+
+    pthread_mutex_unlock(&s_responsePoolMutex);
+
+    free(p_storage);
+}
+
+static long long monotonicMsec()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+/** hands p_command to the completion thread */
+static void queueCompletion(ATAsyncCommand *p_command, int err,
+                    ATResponse *p_response)
+{
+    p_command->err = err;
+    p_command->p_response = p_response;
+    p_command->p_next = NULL;
+
+    pthread_mutex_lock(&s_completionMutex);
+
+    if (s_completedTail == NULL) {
+        s_completedHead = p_command;
+    } else {
+        s_completedTail->p_next = p_command;
+    }
+    s_completedTail = p_command;
+
+    pthread_cond_signal(&s_completionCond);
+
+    pthread_mutex_unlock(&s_completionMutex);
+}
+
+/**
+ * Writes p_command->command and makes it the command in flight. Commands
+ * of a run before the last expect no result
+ * returns 0, or -1 if the write failed
+ * assumes p_channel->commandmutex is held and the channel is idle
+ */
+static int sendAsyncCommand(ATChannel *p_channel, ATAsyncCommand *p_command)
+{
+    if (writeline(p_channel, p_command->command) < 0) {
+        return -1;
+    }
+
+    if (p_command->remaining > 0) {
+        p_channel->type = NO_RESULT;
+        p_channel->responsePrefix = NULL;
+    } else {
+        p_channel->type = p_command->type;
+        p_channel->responsePrefix = p_command->responsePrefix;
+    }
+    p_channel->smsPDU = NULL;
+    p_channel->p_response = at_response_new();
+    p_channel->p_async = p_command;
+
+    if (p_command->timeoutMsec != 0) {
+        p_command->deadline = monotonicMsec() + p_command->timeoutMsec;
+
+        pthread_mutex_lock(&s_completionMutex);
+        s_deadlineGeneration++;
+        pthread_cond_signal(&s_completionCond);
+        pthread_mutex_unlock(&s_completionMutex);
+    }
+
+    return 0;
+}
+
+/**
+ * Gives the idle channel to a waiting synchronous caller, or else sends
+ * the next queued async command
+ * assumes p_channel->commandmutex is held
+ */
+static void startNextCommand(ATChannel *p_channel)
+{
+    ATAsyncCommand *p_command;
+
+    if (p_channel->syncWaiters > 0) {
+        pthread_cond_signal(&p_channel->idlecond);
+        return;
+    }
+
+    while (p_channel->p_response == NULL && p_channel->asyncHead != NULL) {
+        p_command = p_channel->asyncHead;
+        p_channel->asyncHead = p_command->p_next;
+        if (p_channel->asyncHead == NULL) {
+            p_channel->asyncTail = NULL;
+        }
+
+        if (sendAsyncCommand(p_channel, p_command) < 0) {
+            queueCompletion(p_command, AT_ERROR_GENERIC, NULL);
+        }
+    }
+}
+
+/**
+ * Ends the async command in flight with err, passing on its response
+ * when err is 0, and moves on to the next command. The next command of
+ * a run goes out at once, before the channel is given to anyone else
+ * assumes p_channel->commandmutex is held
+ */
+static void finishAsyncCommand(ATChannel *p_channel, int err)
+{
+    ATAsyncCommand *p_command = p_channel->p_async;
+    ATResponse *p_response = p_channel->p_response;
+
+    p_channel->p_async = NULL;
+    p_channel->p_response = NULL;
 
-    while (p_line != NULL) {
-        ATLine *p_toFree;
+    if (err == 0 && p_command->remaining > 0) {
+        at_response_free(p_response);
+        p_response = NULL;
+
+        p_command->command += strlen(p_command->command) + 1;
+        p_command->remaining--;
+
+        if (sendAsyncCommand(p_channel, p_command) == 0) {
+            return;
+        }
+        err = AT_ERROR_GENERIC;
+    }
 
-        p_toFree = p_line;
-        p_line = p_line->p_next;
+    if (err == 0) {
+        if ((p_command->type == SINGLELINE || p_command->type == NUMERIC)
+            && p_response->success > 0
+            && p_response->p_intermediates == NULL
+        ) {
+            /* successful command must have an intermediate response */
+            err = AT_ERROR_INVALID_RESPONSE;
+        }
+    }
 
-        free(p_toFree->line);
-        free(p_toFree);
+    if (err != 0) {
+        at_response_free(p_response);
+        p_response = NULL;
     }
 
-    free (p_response->finalResponse);
-    free (p_response);
+    queueCompletion(p_command, err, p_response);
+
+    clearPendingCommand(p_channel);
 }
 
 /**
- * The line reader places the intermediate responses in reverse order
- * here we flip them back
+ * Ends the async command in flight and the queued ones with err
+ * assumes p_channel->commandmutex is held
  */
-static void reverseIntermediates(ATResponse *p_response)
+static void failAsyncCommands(ATChannel *p_channel, int err)
 {
-    ATLine *pcur,*pnext;
+    ATAsyncCommand *p_command;
+
+    if (p_channel->p_async != NULL) {
+        p_command = p_channel->p_async;
+        p_channel->p_async = NULL;
 
-    pcur = p_response->p_intermediates;
-    p_response->p_intermediates = NULL;
+        at_response_free(p_channel->p_response);
+        p_channel->p_response = NULL;
+        p_channel->responsePrefix = NULL;
 
-    while (pcur != NULL) {
-        pnext = pcur->p_next;
-        pcur->p_next = p_response->p_intermediates;
-        p_response->p_intermediates = pcur;
-        pcur = pnext;
+        queueCompletion(p_command, err, NULL);
     }
+
+    while (p_channel->asyncHead != NULL) {
+        p_command = p_channel->asyncHead;
+        p_channel->asyncHead = p_command->p_next;
+
+        queueCompletion(p_command, err, NULL);
+    }
+    p_channel->asyncTail = NULL;
+
+    pthread_cond_broadcast(&p_channel->idlecond);
+}
+
+/**
+ * Times out the async commands past their deadline
+ * returns the msec until the next deadline, or -1 if there is none
+ */
+static long long expireAsyncCommands()
+{
+    int count = __atomic_load_n(&s_channelCount, __ATOMIC_ACQUIRE);
+    long long now = monotonicMsec();
+    long long next = -1;
+    int i;
+
+    for (i = 0 ; i < count ; i++) {
+        ATChannel *p_channel = &s_channels[i];
+        ATAsyncCommand *p_command;
+
+        pthread_mutex_lock(&p_channel->commandmutex);
+
+        p_command = p_channel->p_async;
+
+        if (p_command != NULL && p_command->timeoutMsec != 0) {
+            if (p_command->deadline <= now) {
+                /* the next command, if any, bumps s_deadlineGeneration */
+                finishAsyncCommand(p_channel, AT_ERROR_TIMEOUT);
+            } else if (next < 0 || p_command->deadline - now < next) {
+                next = p_command->deadline - now;
+            }
+        }
+
+        pthread_mutex_unlock(&p_channel->commandmutex);
+    }
+
+    return next;
+}
+
+/**
+ * Calls back for async commands, one at a time in the order they
+ * finished, and ends the ones that run past their timeout
+ */
+static void *completionLoop(void *arg)
+{
+    ATAsyncCommand *p_command;
+    unsigned generation;
+    long long next;
+#ifndef USE_NP
+    struct timespec ts;
+#endif /*USE_NP*/
+
+    pthread_mutex_lock(&s_completionMutex);
+
+    for (;;) {
+        while (s_completedHead != NULL) {
+            p_command = s_completedHead;
+            s_completedHead = p_command->p_next;
+            if (s_completedHead == NULL) {
+                s_completedTail = NULL;
+            }
+
+            pthread_mutex_unlock(&s_completionMutex);
+
+            p_command->callback(p_command->err, p_command->p_response,
+                    p_command->param);
+
+            if (p_command->err == AT_ERROR_TIMEOUT && s_onTimeout != NULL) {
+                s_onTimeout();
+            }
+
+            free(p_command);
+
+            pthread_mutex_lock(&s_completionMutex);
+        }
+
+        generation = s_deadlineGeneration;
+
+        pthread_mutex_unlock(&s_completionMutex);
+
+        next = expireAsyncCommands();
+
+        pthread_mutex_lock(&s_completionMutex);
+
+        if (s_completedHead != NULL || generation != s_deadlineGeneration) {
+            continue;
+        }
+
+        if (next < 0) {
+            pthread_cond_wait(&s_completionCond, &s_completionMutex);
+        } else {
+#ifdef USE_NP
+            pthread_cond_timeout_np(&s_completionCond,
+                    &s_completionMutex, next);
+#else
+            setTimespecRelative(&ts, next);
+            pthread_cond_timedwait(&s_completionCond,
+                    &s_completionMutex, &ts);
+#endif /*USE_NP*/
+        }
+    }
+
+    return NULL;
+}
+
+static void startCompletionThread()
+{
+    pthread_t tid;
+    pthread_attr_t attr;
+
+    pthread_attr_init (&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    if (pthread_create(&tid, &attr, completionLoop, NULL) < 0) {
+        perror ("pthread_create");
+        return;
+    }
+
+    s_completionStarted = 1;
 }
 
 /**
@@ -666,7 +1225,8 @@ static void reverseIntermediates(ATResponse *p_response)
  * timeoutMsec == 0 means infinite timeout
  */
 
-static int at_send_command_full_nolock (const char *command, ATCommandType type,
+static int at_send_command_full_nolock (ATChannel *p_channel,
+                    const char *command, ATCommandType type,
                     const char *responsePrefix, const char *smspdu,
                     long long timeoutMsec, ATResponse **pp_outResponse)
 {
@@ -675,21 +1235,21 @@ static int at_send_command_full_nolock (const char *command, ATCommandType type,
     struct timespec ts;
 #endif /*USE_NP*/
 
-    if(sp_response != NULL) {
-        err = AT_ERROR_COMMAND_PENDING;
-        goto error;
+    if(p_channel->p_response != NULL) {
+        /* not ours to clear */
+        return AT_ERROR_COMMAND_PENDING;
     }
 
-    err = writeline (command);
+    err = writeline (p_channel, command);
 
     if (err < 0) {
         goto error;
     }
 
-    s_type = type;
-    s_responsePrefix = responsePrefix;
-    s_smsPDU = smspdu;
-    sp_response = at_response_new();
+    p_channel->type = type;
+    p_channel->responsePrefix = responsePrefix;
+    p_channel->smsPDU = smspdu;
+    p_channel->p_response = at_response_new();
 
 #ifndef USE_NP
     if (timeoutMsec != 0) {
@@ -697,15 +1257,19 @@ static int at_send_command_full_nolock (const char *command, ATCommandType type,
     }
 #endif /*USE_NP*/
 
-    while (sp_response->finalResponse == NULL && s_readerClosed == 0) {
+    while (p_channel->p_response->finalResponse == NULL
+            && p_channel->readerClosed == 0) {
         if (timeoutMsec != 0) {
 #ifdef USE_NP
-            err = pthread_cond_timeout_np(&s_commandcond, &s_commandmutex, timeoutMsec);
+            err = pthread_cond_timeout_np(&p_channel->commandcond,
+                    &p_channel->commandmutex, timeoutMsec);
 #else
-            err = pthread_cond_timedwait(&s_commandcond, &s_commandmutex, &ts);
+            err = pthread_cond_timedwait(&p_channel->commandcond,
+                    &p_channel->commandmutex, &ts);
 #endif /*USE_NP*/
         } else {
-            err = pthread_cond_wait(&s_commandcond, &s_commandmutex);
+            err = pthread_cond_wait(&p_channel->commandcond,
+                    &p_channel->commandmutex);
         }
 
         if (err == ETIMEDOUT) {
@@ -715,27 +1279,85 @@ static int at_send_command_full_nolock (const char *command, ATCommandType type,
     }
 
     if (pp_outResponse == NULL) {
-        at_response_free(sp_response);
+        at_response_free(p_channel->p_response);
     } else {
-        /* line reader stores intermediate responses in reverse order */
-        reverseIntermediates(sp_response);
-        *pp_outResponse = sp_response;
+        *pp_outResponse = p_channel->p_response;
     }
 
-    sp_response = NULL;
+    p_channel->p_response = NULL;
 
-    if(s_readerClosed > 0) {
+    if(p_channel->readerClosed > 0) {
         err = AT_ERROR_CHANNEL_CLOSED;
         goto error;
     }
 
     err = 0;
 error:
-    clearPendingCommand();
+    clearPendingCommand(p_channel);
 
     return err;
 }
 
+/** returns 1 if called from the reader thread of any channel */
+static int isReaderThread()
+{
+    int count = __atomic_load_n(&s_channelCount, __ATOMIC_ACQUIRE);
+    int i;
+
+    for (i = 0 ; i < count ; i++) {
+        if (0 != pthread_equal(s_channels[i].tid_reader, pthread_self())) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Locks p_channel once it has no command in flight, or has closed.
+ * Callers on other threads, and async commands, may share the channel
+ */
+static void lockIdleChannel(ATChannel *p_channel)
+{
+    pthread_mutex_lock(&p_channel->commandmutex);
+
+    p_channel->syncWaiters++;
+
+    while (p_channel->p_response != NULL && p_channel->readerClosed == 0) {
+        pthread_cond_wait(&p_channel->idlecond, &p_channel->commandmutex);
+    }
+
+    p_channel->syncWaiters--;
+}
+
+/**
+ * Picks the channel for command. A network scan gets the first secondary
+ * channel to itself when there are two or more; the other classes share
+ * the rest.
+ */
+static ATChannel *channelForCommand(const char *command)
+{
+    int secondaries = __atomic_load_n(&s_channelCount, __ATOMIC_ACQUIRE) - 1;
+    ATChannelClass channelClass = AT_CLASS_PRIMARY;
+    size_t i;
+
+    for (i = 0 ; i < NUM_ELEMS(s_commandClasses) ; i++) {
+        if (strStartsWith(command, s_commandClasses[i].prefix)) {
+            channelClass = s_commandClasses[i].channelClass;
+            break;
+        }
+    }
+
+    if (channelClass == AT_CLASS_PRIMARY || secondaries <= 0) {
+        return &s_channels[0];
+    }
+    if (secondaries == 1 || channelClass == AT_CLASS_SCAN) {
+        return &s_channels[1];
+    }
+
+    return &s_channels[2 + (channelClass - AT_CLASS_SIM) % (secondaries - 1)];
+}
+
 /**
  * Internal send_command implementation
  *
@@ -745,20 +1367,23 @@ static int at_send_command_full (const char *command, ATCommandType type,
                     const char *responsePrefix, const char *smspdu,
                     long long timeoutMsec, ATResponse **pp_outResponse)
 {
+    ATChannel *p_channel;
     int err;
 
-    if (0 != pthread_equal(s_tid_reader, pthread_self())) {
+    if (isReaderThread()) {
         /* cannot be called from reader thread */
         return AT_ERROR_INVALID_THREAD;
     }
 
-    pthread_mutex_lock(&s_commandmutex);
+    p_channel = channelForCommand(command);
 
-    err = at_send_command_full_nolock(command, type,
+    lockIdleChannel(p_channel);
+
+    err = at_send_command_full_nolock(p_channel, command, type,
                     responsePrefix, smspdu,
                     timeoutMsec, pp_outResponse);
 
-    pthread_mutex_unlock(&s_commandmutex);
+    pthread_mutex_unlock(&p_channel->commandmutex);
 
     if (err == AT_ERROR_TIMEOUT && s_onTimeout != NULL) {
         s_onTimeout();
@@ -787,6 +1412,146 @@ int at_send_command (const char *command, ATResponse **pp_outResponse)
     return err;
 }
 
+/**
+ * Copies count commands and responsePrefix into a new ATAsyncCommand
+ * returns NULL if out of memory
+ */
+static ATAsyncCommand *newAsyncCommand(const char * const *commands,
+                    int count, ATCommandType type,
+                    const char *responsePrefix, long long timeoutMsec,
+                    ATResponseCallback callback, void *param)
+{
+    ATAsyncCommand *p_command;
+    size_t commandsLen = 0;
+    size_t prefixLen;
+    char *p;
+    int i;
+
+    for (i = 0 ; i < count ; i++) {
+        commandsLen += strlen(commands[i]) + 1;
+    }
+    prefixLen = responsePrefix == NULL ? 0 : strlen(responsePrefix) + 1;
+
+    p_command = (ATAsyncCommand *) calloc(1,
+            sizeof(ATAsyncCommand) + commandsLen + prefixLen);
+    if (p_command == NULL) {
+        return NULL;
+    }
+
+    p = (char *)(p_command + 1);
+    p_command->command = p;
+    for (i = 0 ; i < count ; i++) {
+        p = stpcpy(p, commands[i]) + 1;
+    }
+    p_command->remaining = count - 1;
+    if (responsePrefix != NULL) {
+        p_command->responsePrefix = memcpy(p, responsePrefix, prefixLen);
+    }
+    p_command->type = type;
+    p_command->timeoutMsec = timeoutMsec;
+    p_command->callback = callback;
+    p_command->param = param;
+
+    return p_command;
+}
+
+/**
+ * Queues p_command on p_channel, or frees it if the channel is closed
+ * returns 0 if its callback will be called, or an error if it will not
+ */
+static int queueAsyncCommand(ATChannel *p_channel, ATAsyncCommand *p_command)
+{
+    int err = 0;
+
+    pthread_mutex_lock(&p_channel->commandmutex);
+
+    if (p_channel->readerClosed > 0) {
+        err = AT_ERROR_CHANNEL_CLOSED;
+        free(p_command);
+    } else {
+        if (p_channel->asyncTail == NULL) {
+            p_channel->asyncHead = p_command;
+        } else {
+            p_channel->asyncTail->p_next = p_command;
+        }
+        p_channel->asyncTail = p_command;
+
+        startNextCommand(p_channel);
+    }
+
+    pthread_mutex_unlock(&p_channel->commandmutex);
+
+    return err;
+}
+
+/**
+ * Queue an AT command and return without waiting for its response
+ *
+ * "command" should not include \r
+ * callback is called on the completion thread once the command finishes,
+ * and owns the ATResponse it is given. Every other callback and timeout
+ * waits on it, so it must not block: work that sends blocking commands
+ * is handed off, eg with RIL_requestTimedCallback() as SETUP_DATA_CALL does
+ *
+ * returns 0 if callback will be called, or an error if it will not
+ */
+int at_send_command_async (const char *command, ATCommandType type,
+                    const char *responsePrefix, long long timeoutMsec,
+                    ATResponseCallback callback, void *param)
+{
+    ATAsyncCommand *p_command;
+
+    pthread_once(&s_completionOnce, startCompletionThread);
+
+    if (!s_completionStarted) {
+        return AT_ERROR_GENERIC;
+    }
+
+    p_command = newAsyncCommand(&command, 1, type, responsePrefix,
+            timeoutMsec, callback, param);
+    if (p_command == NULL) {
+        return AT_ERROR_GENERIC;
+    }
+
+    return queueAsyncCommand(channelForCommand(command), p_command);
+}
+
+/**
+ * Queue a run of AT commands that must not be split, and return without
+ * waiting for their responses
+ *
+ * They go out one after the other on the primary channel, with no other
+ * command in between; each but the last is sent as soon as the one
+ * before has its final response. callback is called as for
+ * at_send_command_async(), once, with the last command's response
+ *
+ * returns 0 if callback will be called, or an error if it will not
+ */
+int at_send_commands_async (const char * const *commands, int count,
+                    long long timeoutMsec,
+                    ATResponseCallback callback, void *param)
+{
+    ATAsyncCommand *p_command;
+
+    if (count <= 0) {
+        return AT_ERROR_GENERIC;
+    }
+
+    pthread_once(&s_completionOnce, startCompletionThread);
+
+    if (!s_completionStarted) {
+        return AT_ERROR_GENERIC;
+    }
+
+    p_command = newAsyncCommand(commands, count, NO_RESULT, NULL,
+            timeoutMsec, callback, param);
+    if (p_command == NULL) {
+        return AT_ERROR_GENERIC;
+    }
+
+    return queueAsyncCommand(&s_channels[0], p_command);
+}
+
 
 int at_send_command_singleline (const char *command,
                                 const char *responsePrefix,
@@ -889,6 +1654,45 @@ void at_set_on_reader_closed(void (*onClose)(void))
 }
 
 
+/**
+ * Issue a command on every open channel, for settings each channel keeps
+ * on its own (eg AT+CMEE=1). Returns the first error.
+ */
+int at_send_command_all (const char *command)
+{
+    int count = __atomic_load_n(&s_channelCount, __ATOMIC_ACQUIRE);
+    int i;
+    int err;
+    int ret = 0;
+
+    if (isReaderThread()) {
+        /* cannot be called from reader thread */
+        return AT_ERROR_INVALID_THREAD;
+    }
+
+    for (i = 0 ; i < count ; i++) {
+        ATChannel *p_channel = &s_channels[i];
+
+        lockIdleChannel(p_channel);
+
+        err = at_send_command_full_nolock(p_channel, command, NO_RESULT,
+                        NULL, NULL, 0, NULL);
+
+        pthread_mutex_unlock(&p_channel->commandmutex);
+
+        if (err == AT_ERROR_TIMEOUT && s_onTimeout != NULL) {
+            s_onTimeout();
+        }
+
+        if (err < 0 && ret == 0) {
+            ret = err;
+        }
+    }
+
+    return ret;
+}
+
+
 /**
  * Periodically issue an AT command and wait for a response.
  * Used to ensure channel has start up and is active
@@ -896,34 +1700,47 @@ void at_set_on_reader_closed(void (*onClose)(void))
 
 int at_handshake()
 {
+    int count = __atomic_load_n(&s_channelCount, __ATOMIC_ACQUIRE);
     int i;
+    int channel;
     int err = 0;
 
-    if (0 != pthread_equal(s_tid_reader, pthread_self())) {
+    if (isReaderThread()) {
         /* cannot be called from reader thread */
         return AT_ERROR_INVALID_THREAD;
     }
 
-    pthread_mutex_lock(&s_commandmutex);
+    /* one channel at a time, so the others stay usable meanwhile */
+    for (channel = 0 ; channel < count && err == 0 ; channel++) {
+        ATChannel *p_channel = &s_channels[channel];
 
-    for (i = 0 ; i < HANDSHAKE_RETRY_COUNT ; i++) {
-        /* some stacks start with verbose off */
-        err = at_send_command_full_nolock ("ATE0Q0V1", NO_RESULT,
-                    NULL, NULL, HANDSHAKE_TIMEOUT_MSEC, NULL);
+        lockIdleChannel(p_channel);
+        /* keep queued async commands off the channel until we are done */
+        p_channel->syncWaiters++;
 
-        if (err == 0) {
-            break;
+        for (i = 0 ; i < HANDSHAKE_RETRY_COUNT ; i++) {
+            /* some stacks start with verbose off */
+            err = at_send_command_full_nolock (p_channel,
+                        "ATE0Q0V1", NO_RESULT,
+                        NULL, NULL, HANDSHAKE_TIMEOUT_MSEC, NULL);
+
+            if (err == 0) {
+                break;
+            }
         }
-    }
 
-    if (err == 0) {
-        /* pause for a bit to let the input buffer drain any unmatched OK's
-           (they will appear as extraneous unsolicited responses) */
+        if (err == 0 && i > 0) {
+            /* pause for a bit to let the input buffer drain any unmatched
+               OK's of the attempts that timed out (they will appear as
+               extraneous unsolicited responses) */
 
-        sleepMsec(HANDSHAKE_TIMEOUT_MSEC);
-    }
+            sleepMsec(HANDSHAKE_TIMEOUT_MSEC);
+        }
 
-    pthread_mutex_unlock(&s_commandmutex);
+        p_channel->syncWaiters--;
+        startNextCommand(p_channel);
+        pthread_mutex_unlock(&p_channel->commandmutex);
+    }
 
     return err;
 }
@@ -31,6 +31,10 @@ extern void  AT_DUMP(const char* prefix, const char*  buff, int  len);
 #define  AT_DUMP(prefix,buff,len)  do{}while(0)
 #endif
 
+/* Max AT channels, the primary one included. Modems with a multiplexed
+   tty can take independent commands on their other DLCs concurrently */
+#define AT_CHANNELS_MAX 4
+
 #define AT_ERROR_GENERIC -1
 #define AT_ERROR_COMMAND_PENDING -2
 #define AT_ERROR_CHANNEL_CLOSED -3
@@ -74,9 +78,13 @@ typedef struct {
 typedef void (*ATUnsolHandler)(const char *s, const char *sms_pdu);
 
 int at_open(int fd, ATUnsolHandler h);
+/* Adds a secondary channel after at_open(); returns its index or -1.
+   Unsolicited responses on it go to the handler given to at_open() */
+int at_open_channel(int fd);
 void at_close();
 
-/* This callback is invoked on the command thread.
+/* This callback is invoked on the command thread, or on the completion
+   thread after the callback of an async command that timed out.
    You should reset or handshake here to avoid getting out of sync */
 void at_set_on_timeout(void (*onTimeout)(void));
 /* This callback is invoked on the reader thread (like ATUnsolHandler)
@@ -103,6 +111,34 @@ int at_handshake();
 
 int at_send_command (const char *command, ATResponse **pp_outResponse);
 
+/* Called once an at_send_command_async() command finishes, on a thread
+   of atchannel's own that serves every such command in the order they
+   finished. p_response is NULL unless err is 0, and must be freed with
+   at_response_free. The callback may queue further async commands; it
+   must not block, since every other callback and timeout waits on it.
+   Hand blocking work off, eg with RIL_requestTimedCallback() */
+typedef void (*ATResponseCallback)(int err, ATResponse *p_response,
+                                    void *param);
+
+/* Queues command and returns at once: 0 if callback will be called, or
+   an error if it will not. Unlike the blocking calls this may be used
+   from the reader thread. timeoutMsec == 0 means infinite timeout */
+int at_send_command_async (const char *command, ATCommandType type,
+                            const char *responsePrefix, long long timeoutMsec,
+                            ATResponseCallback callback, void *param);
+
+/* Queues count NO_RESULT commands that go out back to back on the
+   primary channel, with no other command in between. callback gets the
+   last one's response; the others' are dropped whatever they were. A
+   command that times out or cannot be sent ends the run with that error.
+   timeoutMsec applies to each command */
+int at_send_commands_async (const char * const *commands, int count,
+                            long long timeoutMsec,
+                            ATResponseCallback callback, void *param);
+
+/* Sends command on every channel, for per-channel settings */
+int at_send_command_all (const char *command);
+
 int at_send_command_sms (const char *command, const char *pdu,
                             const char *responsePrefix,
                             ATResponse **pp_outResponse);
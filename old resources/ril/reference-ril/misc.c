@@ -15,6 +15,11 @@
 ** limitations under the License.
 */
 
+#include <stdlib.h>
+#include <string.h>
+
+#include "misc.h"
+
 /** returns 1 if line starts with prefix, 0 if it does not */
 int strStartsWith(const char *line, const char *prefix)
 {
@@ -27,3 +32,135 @@ int strStartsWith(const char *line, const char *prefix)
     return *prefix == '\0';
 }
 
+/*
+ * A trie node for the byte c; its children are a list through
+ * nextSibling. Node 0 is the root, so 0 also means no node.
+ */
+struct PrefixTrieNode {
+    char c;
+    int entry;          /* index of the prefix ending here, or -1 */
+    int firstChild;
+    int nextSibling;
+};
+
+static PrefixTrieNode *buildTrie(const PrefixTable *table)
+{
+    PrefixTrieNode *nodes;
+    size_t maxNodes = 1;
+    size_t i;
+    int count = 1;
+
+    for (i = 0 ; i < table->count ; i++) {
+        maxNodes += strlen(table->entries[i].prefix);
+    }
+
+    nodes = (PrefixTrieNode *) calloc(maxNodes, sizeof(PrefixTrieNode));
+    if (nodes == NULL) {
+        return NULL;
+    }
+    nodes[0].entry = -1;
+
+    for (i = 0 ; i < table->count ; i++) {
+        const char *p;
+        int node = 0;
+
+        for (p = table->entries[i].prefix ; *p != '\0' ; p++) {
+            int child = nodes[node].firstChild;
+
+            while (child != 0 && nodes[child].c != *p) {
+                child = nodes[child].nextSibling;
+            }
+
+            if (child == 0) {
+                child = count++;
+                nodes[child].c = *p;
+                nodes[child].entry = -1;
+                nodes[child].nextSibling = nodes[node].firstChild;
+                nodes[node].firstChild = child;
+            }
+
+            node = child;
+        }
+
+        /* the first of duplicate prefixes wins */
+        if (nodes[node].entry < 0) {
+            nodes[node].entry = i;
+        }
+    }
+
+    return nodes;
+}
+
+/* for when the trie could not be allocated */
+static int scanTable(const PrefixTable *table, const char *line,
+        int defaultValue)
+{
+    size_t bestLen = 0;
+    int found = 0;
+    int value = defaultValue;
+    size_t i;
+
+    for (i = 0 ; i < table->count ; i++) {
+        size_t len = strlen(table->entries[i].prefix);
+
+        if ((!found || len > bestLen)
+            && strStartsWith(line, table->entries[i].prefix)
+        ) {
+            found = 1;
+            bestLen = len;
+            value = table->entries[i].value;
+        }
+    }
+
+    return value;
+}
+
+int prefixTableLookup(PrefixTable *table, const char *line, int defaultValue)
+{
+    PrefixTrieNode *nodes;
+    PrefixTrieNode *expected = NULL;
+    int value = defaultValue;
+    int node = 0;
+
+    nodes = __atomic_load_n(&table->nodes, __ATOMIC_ACQUIRE);
+
+    if (nodes == NULL) {
+        nodes = buildTrie(table);
+        if (nodes == NULL) {
+            return scanTable(table, line, defaultValue);
+        }
+
+        /* another thread may have built it first */
+        if (!__atomic_compare_exchange_n(&table->nodes, &expected, nodes,
+                0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            free(nodes);
+            nodes = expected;
+        }
+    }
+
+    for (;;) {
+        int child;
+
+        if (nodes[node].entry >= 0) {
+            value = table->entries[nodes[node].entry].value;
+        }
+
+        if (*line == '\0') {
+            break;
+        }
+
+        child = nodes[node].firstChild;
+        while (child != 0 && nodes[child].c != *line) {
+            child = nodes[child].nextSibling;
+        }
+
+        if (child == 0) {
+            break;
+        }
+
+        node = child;
+        line++;
+    }
+
+    return value;
+}
@@ -15,5 +15,40 @@
 ** limitations under the License.
 */
 
+#ifndef MISC_H
+#define MISC_H 1
+
+#include <stddef.h>
+
 /** returns 1 if line starts with prefix, 0 if it does not */
 int strStartsWith(const char *line, const char *prefix);
+
+/**
+ * A table of line prefixes, each with a value. The first lookup turns it
+ * into a trie, so a line is classified in one pass however many prefixes
+ * there are, where a chain of strStartsWith() goes over it once for each.
+ */
+typedef struct {
+    const char *prefix;
+    int value;
+} PrefixEntry;
+
+typedef struct PrefixTrieNode PrefixTrieNode;
+
+typedef struct {
+    const PrefixEntry *entries;
+    size_t count;
+    PrefixTrieNode *nodes;      /* built on first lookup */
+} PrefixTable;
+
+#define PREFIX_TABLE_INITIALIZER(entries) \
+    { (entries), sizeof(entries) / sizeof((entries)[0]), NULL }
+
+/**
+ * returns the value of the longest prefix in table that line starts with,
+ * defaultValue if there is none
+ * Safe to call from any thread
+ */
+int prefixTableLookup(PrefixTable *table, const char *line, int defaultValue);
+
+#endif /*MISC_H*/
@@ -204,6 +204,10 @@ static int s_port = -1;
 static const char * s_device_path = NULL;
 static int          s_device_socket = 0;
 
+/* ttys of the secondary AT channels, eg the other DLCs of a mux (-a) */
+static const char * s_channel_paths[AT_CHANNELS_MAX - 1];
+static int          s_channel_path_count = 0;
+
 /* trigger change to this with s_state_cond */
 static int s_closed = 0;
 
@@ -1636,6 +1640,43 @@ error2:
     RIL_onRequestComplete(t, RIL_E_SMS_SEND_FAIL_RETRY, &response, sizeof(response));
 }
 
+/*
+ * A data call being set up over AT. Its commands go out as one run with
+ * at_send_commands_async, so no thread waits out the dial and no other
+ * command, such as another setup's AT+CGDCONT, gets in between.
+ */
+typedef struct {
+    RIL_Token t;
+    int success;
+} SetupDataCall;
+
+/* Completes the setup on the event loop, where AT commands may block */
+static void finishSetupDataCall(void *param)
+{
+    SetupDataCall *p_setup = (SetupDataCall *)param;
+
+    if (p_setup->success) {
+        requestOrSendDataCallList(&p_setup->t);
+    } else {
+        RIL_onRequestComplete(p_setup->t, RIL_E_GENERIC_FAILURE, NULL, 0);
+    }
+
+    free(p_setup);
+}
+
+static void onSetupDataCallDialed(int err, ATResponse *p_response, void *param)
+{
+    SetupDataCall *p_setup = (SetupDataCall *)param;
+
+    //FIXME check for error here; only the dial is checked
+    p_setup->success = err >= 0 && p_response->success != 0;
+
+    at_response_free(p_response);
+
+    // not from atchannel's completion thread, which serves every channel
+    RIL_requestTimedCallback(finishSetupDataCall, p_setup, NULL);
+}
+
 static void requestSetupDataCall(void *data, size_t datalen, RIL_Token t)
 {
     const char *apn;
@@ -1716,6 +1757,8 @@ static void requestSetupDataCall(void *data, size_t datalen, RIL_Token t)
         if (qmistatus < 0) goto error;
 
     } else {
+        SetupDataCall *p_setup;
+        const char *steps[6];
 
         if (datalen > 6 * sizeof(char *)) {
             pdp_type = ((const char **)data)[6];
@@ -1723,29 +1766,35 @@ static void requestSetupDataCall(void *data, size_t datalen, RIL_Token t)
             pdp_type = "IP";
         }
 
-        asprintf(&cmd, "AT+CGDCONT=1,\"%s\",\"%s\",,0,0", pdp_type, apn);
-        //FIXME check for error here
-        err = at_send_command(cmd, NULL);
-        free(cmd);
+        p_setup = (SetupDataCall *)calloc(1, sizeof(SetupDataCall));
+        if (p_setup == NULL) {
+            goto error;
+        }
 
+        p_setup->t = t;
+        asprintf(&cmd, "AT+CGDCONT=1,\"%s\",\"%s\",,0,0", pdp_type, apn);
+        steps[0] = cmd;
         // Set required QoS params to default
-        err = at_send_command("AT+CGQREQ=1", NULL);
-
+        steps[1] = "AT+CGQREQ=1";
         // Set minimum QoS params to default
-        err = at_send_command("AT+CGQMIN=1", NULL);
-
+        steps[2] = "AT+CGQMIN=1";
         // packet-domain event reporting
-        err = at_send_command("AT+CGEREP=1,0", NULL);
-
+        steps[3] = "AT+CGEREP=1,0";
         // Hangup anything that's happening there now
-        err = at_send_command("AT+CGACT=1,0", NULL);
-
+        steps[4] = "AT+CGACT=1,0";
         // Start data on PDP context 1
-        err = at_send_command("ATD*99***1#", &p_response);
+        steps[5] = "ATD*99***1#";
+
+        // completes the request once the dial is answered
+        err = at_send_commands_async(steps, sizeof(steps) / sizeof(steps[0]), 0,
+                onSetupDataCallDialed, p_setup);
+        free(cmd);
 
-        if (err < 0 || p_response->success == 0) {
+        if (err < 0) {
+            free(p_setup);
             goto error;
         }
+        return;
     }
 
     requestOrSendDataCallList(&t);
@@ -2992,26 +3041,29 @@ static void initializeCallback(void *param __unused)
 
     /*  atchannel is tolerant of echo but it must */
     /*  have verbose result codes */
-    at_send_command("ATE0Q0V1", NULL);
+    at_send_command_all("ATE0Q0V1");
 
     /*  No auto-answer */
     at_send_command("ATS0=0", NULL);
 
-    /*  Extended errors */
-    at_send_command("AT+CMEE=1", NULL);
+    /*  Extended errors, on every channel at_get_cme_error() may see */
+    at_send_command_all("AT+CMEE=1");
 
-    /*  Network registration events */
+    /*  Network registration events, on every channel since CREG? and
+        CGREG? go out on the status channel */
     err = at_send_command("AT+CREG=2", &p_response);
 
     /* some handsets -- in tethered mode -- don't support CREG=2 */
     if (err < 0 || p_response->success == 0) {
-        at_send_command("AT+CREG=1", NULL);
+        at_send_command_all("AT+CREG=1");
+    } else {
+        at_send_command_all("AT+CREG=2");
     }
 
     at_response_free(p_response);
 
     /*  GPRS registration events */
-    at_send_command("AT+CGREG=1", NULL);
+    at_send_command_all("AT+CGREG=1");
 
     /*  Call Waiting notifications */
     at_send_command("AT+CCWA=1", NULL);
@@ -3079,6 +3131,46 @@ static void sendUnsolImsNetworkStateChanged()
             NULL, 0);
 }
 
+/* The unsolicited responses onUnsolicited() handles, by prefix */
+typedef enum {
+    UNSOL_IGNORED,
+    UNSOL_NITZ,
+    UNSOL_CALL_STATE,
+    UNSOL_NETWORK_STATE,
+    UNSOL_NEW_SMS,
+    UNSOL_SMS_STATUS_REPORT,
+    UNSOL_DATA_CALL_LIST,
+    UNSOL_TECHNOLOGY,
+    UNSOL_SUBSCRIPTION_SOURCE,
+    UNSOL_EMERGENCY_CALLBACK_MODE,
+    UNSOL_PRL,
+    UNSOL_RADIO_OFF,
+} UnsolicitedType;
+
+static const PrefixEntry s_unsolicitedEntries[] = {
+    { "%CTZV:", UNSOL_NITZ },
+    { "+CRING:", UNSOL_CALL_STATE },
+    { "RING", UNSOL_CALL_STATE },
+    { "NO CARRIER", UNSOL_CALL_STATE },
+    { "+CCWA", UNSOL_CALL_STATE },
+    { "+CREG:", UNSOL_NETWORK_STATE },
+    { "+CGREG:", UNSOL_NETWORK_STATE },
+    { "+CMT:", UNSOL_NEW_SMS },
+    { "+CDS:", UNSOL_SMS_STATUS_REPORT },
+    { "+CGEV:", UNSOL_DATA_CALL_LIST },
+#ifdef WORKAROUND_FAKE_CGEV
+    { "+CME ERROR: 150", UNSOL_DATA_CALL_LIST },
+#endif /* WORKAROUND_FAKE_CGEV */
+    { "+CTEC: ", UNSOL_TECHNOLOGY },
+    { "+CCSS: ", UNSOL_SUBSCRIPTION_SOURCE },
+    { "+WSOS: ", UNSOL_EMERGENCY_CALLBACK_MODE },
+    { "+WPRL: ", UNSOL_PRL },
+    { "+CFUN: 0", UNSOL_RADIO_OFF },
+};
+
+static PrefixTable s_unsolicitedTypes =
+        PREFIX_TABLE_INITIALIZER(s_unsolicitedEntries);
+
 /**
  * Called by atchannel when an unsolicited line appears
  * This is called on atchannel's reader thread. AT commands may
@@ -3096,144 +3188,150 @@ static void onUnsolicited (const char *s, const char *sms_pdu)
         return;
     }
 
-    if (strStartsWith(s, "%CTZV:")) {
-        /* TI specific -- NITZ time */
-        char *response;
+    switch (prefixTableLookup(&s_unsolicitedTypes, s, UNSOL_IGNORED)) {
+        case UNSOL_NITZ: {
+            /* TI specific -- NITZ time */
+            char *response;
 
-        line = p = strdup(s);
-        at_tok_start(&p);
+            line = p = strdup(s);
+            at_tok_start(&p);
 
-        err = at_tok_nextstr(&p, &response);
+            err = at_tok_nextstr(&p, &response);
 
-        free(line);
-        if (err != 0) {
-            RLOGE("invalid NITZ line %s\n", s);
-        } else {
-            RIL_onUnsolicitedResponse (
-                RIL_UNSOL_NITZ_TIME_RECEIVED,
-                response, strlen(response));
+            free(line);
+            if (err != 0) {
+                RLOGE("invalid NITZ line %s\n", s);
+            } else {
+                RIL_onUnsolicitedResponse (
+                    RIL_UNSOL_NITZ_TIME_RECEIVED,
+                    response, strlen(response));
+            }
+            break;
         }
-    } else if (strStartsWith(s,"+CRING:")
-                || strStartsWith(s,"RING")
-                || strStartsWith(s,"NO CARRIER")
-                || strStartsWith(s,"+CCWA")
-    ) {
-        RIL_onUnsolicitedResponse (
-            RIL_UNSOL_RESPONSE_CALL_STATE_CHANGED,
-            NULL, 0);
-#ifdef WORKAROUND_FAKE_CGEV
-        RIL_requestTimedCallback (onDataCallListChanged, NULL, NULL); //TODO use new function
-#endif /* WORKAROUND_FAKE_CGEV */
-    } else if (strStartsWith(s,"+CREG:")
-                || strStartsWith(s,"+CGREG:")
-    ) {
-        RIL_onUnsolicitedResponse (
-            RIL_UNSOL_RESPONSE_VOICE_NETWORK_STATE_CHANGED,
-            NULL, 0);
+        case UNSOL_CALL_STATE:
+            RIL_onUnsolicitedResponse (
+                RIL_UNSOL_RESPONSE_CALL_STATE_CHANGED,
+                NULL, 0);
 #ifdef WORKAROUND_FAKE_CGEV
-        RIL_requestTimedCallback (onDataCallListChanged, NULL, NULL);
+            RIL_requestTimedCallback (onDataCallListChanged, NULL, NULL); //TODO use new function
 #endif /* WORKAROUND_FAKE_CGEV */
-    } else if (strStartsWith(s, "+CMT:")) {
-        RIL_onUnsolicitedResponse (
-            RIL_UNSOL_RESPONSE_NEW_SMS,
-            sms_pdu, strlen(sms_pdu));
-    } else if (strStartsWith(s, "+CDS:")) {
-        RIL_onUnsolicitedResponse (
-            RIL_UNSOL_RESPONSE_NEW_SMS_STATUS_REPORT,
-            sms_pdu, strlen(sms_pdu));
-    } else if (strStartsWith(s, "+CGEV:")) {
-        /* Really, we can ignore NW CLASS and ME CLASS events here,
-         * but right now we don't since extranous
-         * RIL_UNSOL_DATA_CALL_LIST_CHANGED calls are tolerated
-         */
-        /* can't issue AT commands here -- call on main thread */
-        RIL_requestTimedCallback (onDataCallListChanged, NULL, NULL);
+            break;
+        case UNSOL_NETWORK_STATE:
+            RIL_onUnsolicitedResponse (
+                RIL_UNSOL_RESPONSE_VOICE_NETWORK_STATE_CHANGED,
+                NULL, 0);
 #ifdef WORKAROUND_FAKE_CGEV
-    } else if (strStartsWith(s, "+CME ERROR: 150")) {
-        RIL_requestTimedCallback (onDataCallListChanged, NULL, NULL);
+            RIL_requestTimedCallback (onDataCallListChanged, NULL, NULL);
 #endif /* WORKAROUND_FAKE_CGEV */
-    } else if (strStartsWith(s, "+CTEC: ")) {
-        int tech, mask;
-        switch (parse_technology_response(s, &tech, NULL))
-        {
-            case -1: // no argument could be parsed.
-                RLOGE("invalid CTEC line %s\n", s);
-                break;
-            case 1: // current mode correctly parsed
-            case 0: // preferred mode correctly parsed
-                mask = 1 << tech;
-                if (mask != MDM_GSM && mask != MDM_CDMA &&
-                     mask != MDM_WCDMA && mask != MDM_LTE) {
-                    RLOGE("Unknown technology %d\n", tech);
-                } else {
-                    setRadioTechnology(sMdmInfo, tech);
-                }
-                break;
-        }
-    } else if (strStartsWith(s, "+CCSS: ")) {
-        int source = 0;
-        line = p = strdup(s);
-        if (!line) {
-            RLOGE("+CCSS: Unable to allocate memory");
-            return;
-        }
-        if (at_tok_start(&p) < 0) {
-            free(line);
-            return;
-        }
-        if (at_tok_nextint(&p, &source) < 0) {
-            RLOGE("invalid +CCSS response: %s", line);
-            free(line);
-            return;
-        }
-        SSOURCE(sMdmInfo) = source;
-        RIL_onUnsolicitedResponse(RIL_UNSOL_CDMA_SUBSCRIPTION_SOURCE_CHANGED,
-                                  &source, sizeof(source));
-    } else if (strStartsWith(s, "+WSOS: ")) {
-        char state = 0;
-        int unsol;
-        line = p = strdup(s);
-        if (!line) {
-            RLOGE("+WSOS: Unable to allocate memory");
-            return;
+            break;
+        case UNSOL_NEW_SMS:
+            RIL_onUnsolicitedResponse (
+                RIL_UNSOL_RESPONSE_NEW_SMS,
+                sms_pdu, strlen(sms_pdu));
+            break;
+        case UNSOL_SMS_STATUS_REPORT:
+            RIL_onUnsolicitedResponse (
+                RIL_UNSOL_RESPONSE_NEW_SMS_STATUS_REPORT,
+                sms_pdu, strlen(sms_pdu));
+            break;
+        case UNSOL_DATA_CALL_LIST:
+            /* +CGEV: Really, we can ignore NW CLASS and ME CLASS events here,
+             * but right now we don't since extranous
+             * RIL_UNSOL_DATA_CALL_LIST_CHANGED calls are tolerated
+             */
+            /* can't issue AT commands here -- call on main thread */
+            RIL_requestTimedCallback (onDataCallListChanged, NULL, NULL);
+            break;
+        case UNSOL_TECHNOLOGY: {
+            int tech, mask;
+            switch (parse_technology_response(s, &tech, NULL))
+            {
+                case -1: // no argument could be parsed.
+                    RLOGE("invalid CTEC line %s\n", s);
+                    break;
+                case 1: // current mode correctly parsed
+                case 0: // preferred mode correctly parsed
+                    mask = 1 << tech;
+                    if (mask != MDM_GSM && mask != MDM_CDMA &&
+                         mask != MDM_WCDMA && mask != MDM_LTE) {
+                        RLOGE("Unknown technology %d\n", tech);
+                    } else {
+                        setRadioTechnology(sMdmInfo, tech);
+                    }
+                    break;
+            }
+            break;
         }
-        if (at_tok_start(&p) < 0) {
-            free(line);
-            return;
+        case UNSOL_SUBSCRIPTION_SOURCE: {
+            int source = 0;
+            line = p = strdup(s);
+            if (!line) {
+                RLOGE("+CCSS: Unable to allocate memory");
+                return;
+            }
+            if (at_tok_start(&p) < 0) {
+                free(line);
+                return;
+            }
+            if (at_tok_nextint(&p, &source) < 0) {
+                RLOGE("invalid +CCSS response: %s", line);
+                free(line);
+                return;
+            }
+            SSOURCE(sMdmInfo) = source;
+            RIL_onUnsolicitedResponse(RIL_UNSOL_CDMA_SUBSCRIPTION_SOURCE_CHANGED,
+                                      &source, sizeof(source));
+            break;
         }
-        if (at_tok_nextbool(&p, &state) < 0) {
-            RLOGE("invalid +WSOS response: %s", line);
+        case UNSOL_EMERGENCY_CALLBACK_MODE: {
+            char state = 0;
+            int unsol;
+            line = p = strdup(s);
+            if (!line) {
+                RLOGE("+WSOS: Unable to allocate memory");
+                return;
+            }
+            if (at_tok_start(&p) < 0) {
+                free(line);
+                return;
+            }
+            if (at_tok_nextbool(&p, &state) < 0) {
+                RLOGE("invalid +WSOS response: %s", line);
+                free(line);
+                return;
+            }
             free(line);
-            return;
-        }
-        free(line);
 
-        unsol = state ?
-                RIL_UNSOL_ENTER_EMERGENCY_CALLBACK_MODE : RIL_UNSOL_EXIT_EMERGENCY_CALLBACK_MODE;
+            unsol = state ?
+                    RIL_UNSOL_ENTER_EMERGENCY_CALLBACK_MODE : RIL_UNSOL_EXIT_EMERGENCY_CALLBACK_MODE;
 
-        RIL_onUnsolicitedResponse(unsol, NULL, 0);
-
-    } else if (strStartsWith(s, "+WPRL: ")) {
-        int version = -1;
-        line = p = strdup(s);
-        if (!line) {
-            RLOGE("+WPRL: Unable to allocate memory");
-            return;
-        }
-        if (at_tok_start(&p) < 0) {
-            RLOGE("invalid +WPRL response: %s", s);
-            free(line);
-            return;
+            RIL_onUnsolicitedResponse(unsol, NULL, 0);
+            break;
         }
-        if (at_tok_nextint(&p, &version) < 0) {
-            RLOGE("invalid +WPRL response: %s", s);
+        case UNSOL_PRL: {
+            int version = -1;
+            line = p = strdup(s);
+            if (!line) {
+                RLOGE("+WPRL: Unable to allocate memory");
+                return;
+            }
+            if (at_tok_start(&p) < 0) {
+                RLOGE("invalid +WPRL response: %s", s);
+                free(line);
+                return;
+            }
+            if (at_tok_nextint(&p, &version) < 0) {
+                RLOGE("invalid +WPRL response: %s", s);
+                free(line);
+                return;
+            }
             free(line);
-            return;
+            RIL_onUnsolicitedResponse(RIL_UNSOL_CDMA_PRL_CHANGED, &version, sizeof(version));
+            break;
         }
-        free(line);
-        RIL_onUnsolicitedResponse(RIL_UNSOL_CDMA_PRL_CHANGED, &version, sizeof(version));
-    } else if (strStartsWith(s, "+CFUN: 0")) {
-        setRadioState(RADIO_STATE_OFF);
+        case UNSOL_RADIO_OFF:
+            setRadioState(RADIO_STATE_OFF);
+            break;
     }
 }
 
@@ -3271,13 +3369,62 @@ static void setHardwareConfiguration(int num, RIL_HardwareConfig *cfg)
 static void usage(char *s)
 {
 #ifdef RIL_SHLIB
-    fprintf(stderr, "reference-ril requires: -p <tcp port> or -d /dev/tty_device\n");
+    fprintf(stderr, "reference-ril requires: -p <tcp port> or -d /dev/tty_device\n"
+                    "  and takes -a /dev/tty_device for each extra AT channel\n");
 #else
-    fprintf(stderr, "usage: %s [-p <tcp port>] [-d /dev/tty_device]\n", s);
+    fprintf(stderr, "usage: %s [-p <tcp port>] [-d /dev/tty_device]"
+                    " [-a /dev/tty_device]...\n", s);
     exit(-1);
 #endif
 }
 
+/* Remembers the tty of a secondary AT channel; returns -1 if there are too many */
+static int addChannelPath(const char *path)
+{
+    if (s_channel_path_count >= AT_CHANNELS_MAX - 1) {
+        RLOGE("Ignoring AT channel %s, at most %d channels\n",
+                path, AT_CHANNELS_MAX);
+        return -1;
+    }
+
+    s_channel_paths[s_channel_path_count++] = path;
+    RLOGI("Opening AT channel %s\n", path);
+
+    return 0;
+}
+
+/**
+ * Opens the secondary AT channels after the primary one. A channel that
+ * fails to open is left out; its commands then run on the primary.
+ */
+static void openSecondaryChannels()
+{
+    int i;
+    int fd;
+
+    for (i = 0 ; i < s_channel_path_count ; i++) {
+        fd = open(s_channel_paths[i], O_RDWR);
+        if (fd < 0) {
+            RLOGE("Could not open AT channel %s: %s\n",
+                    s_channel_paths[i], strerror(errno));
+            continue;
+        }
+
+        if (!memcmp(s_channel_paths[i], "/dev/ttyS", 9)) {
+            /* disable echo on serial ports */
+            struct termios  ios;
+            tcgetattr( fd, &ios );
+            ios.c_lflag = 0;  /* disable ECHO, ICANON, etc... */
+            tcsetattr( fd, TCSANOW, &ios );
+        }
+
+        if (at_open_channel(fd) < 0) {
+            RLOGE("AT error on at_open_channel %s\n", s_channel_paths[i]);
+            close(fd);
+        }
+    }
+}
+
 static void *
 mainLoop(void *param __unused)
 {
@@ -3348,6 +3495,8 @@ mainLoop(void *param __unused)
             return 0;
         }
 
+        openSecondaryChannels();
+
         RIL_requestTimedCallback(initializeCallback, NULL, &TIMEVAL_0);
 
         // Give initializeCallback a chance to dispatched, since
@@ -3372,7 +3521,7 @@ const RIL_RadioFunctions *RIL_Init(const struct RIL_Env *env, int argc, char **a
 
     s_rilenv = env;
 
-    while ( -1 != (opt = getopt(argc, argv, "p:d:s:c:"))) {
+    while ( -1 != (opt = getopt(argc, argv, "p:d:s:c:a:"))) {
         switch (opt) {
             case 'p':
                 s_port = atoi(optarg);
@@ -3398,6 +3547,10 @@ const RIL_RadioFunctions *RIL_Init(const struct RIL_Env *env, int argc, char **a
                 RLOGI("Client id received %s\n", optarg);
             break;
 
+            case 'a':
+                addChannelPath(optarg);
+            break;
+
             default:
                 usage(argv[0]);
                 return NULL;
@@ -3427,7 +3580,7 @@ int main (int argc, char **argv)
     int fd = -1;
     int opt;
 
-    while ( -1 != (opt = getopt(argc, argv, "p:d:"))) {
+    while ( -1 != (opt = getopt(argc, argv, "p:d:s:a:"))) {
         switch (opt) {
             case 'p':
                 s_port = atoi(optarg);
@@ -3448,6 +3601,10 @@ int main (int argc, char **argv)
                 RLOGI("Opening socket %s\n", s_device_path);
             break;
 
+            case 'a':
+                addChannelPath(optarg);
+            break;
+
             default:
                 usage(argv[0]);
         }
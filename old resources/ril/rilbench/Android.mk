@@ -0,0 +1,99 @@
+# Copyright 2026 The Android Open Source Project
+
+# Host benchmark for libril, see rilbench.cpp:
+#   rilbench [-n requests] [-p depth] [-d delay_us] [-r radio.log] [-s]
+# and for reference-ril's AT reader, see atbench.c:
+#   atbench [-f capture] [-n passes] [-v] [-c]
+ifeq ($(HOST_OS),linux)
+
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    rilbench.cpp \
+    loopback_ril.cpp \
+    host_shim.cpp \
+    ../libril/ril.cpp \
+    ../libril/ril_event.cpp \
+    ../libril/ril_pool.cpp \
+    ../libril/ril_trace.cpp \
+    ../libril/ril_histogram.cpp \
+    ../librilutils/librilutils.c \
+    ../librilutils/record_stream.c \
+    ../librilutils/wake_lock.c
+
+# include/ stands in for libbinder's Parcel and bionic's <sys/limits.h>
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/include \
+    $(LOCAL_PATH)/../include \
+    $(LOCAL_PATH)/../libril
+
+LOCAL_STATIC_LIBRARIES := \
+    libcutils \
+    libutils \
+    liblog
+
+LOCAL_CFLAGS :=
+
+ifeq ($(SIM_COUNT), 2)
+    LOCAL_CFLAGS += -DANDROID_SIM_COUNT_2
+endif
+
+ifeq ($(BOARD_USES_LEGACY_RIL),true)
+LOCAL_CFLAGS += -DLEGACY_RIL
+endif
+
+# Build libril the way the board does, so its changes can be measured
+ifneq ($(BOARD_RIL_EVENT_USES_SELECT),true)
+LOCAL_CFLAGS += -DRIL_EVENT_USE_EPOLL
+ifeq ($(BOARD_RIL_EVENT_EPOLL_EDGE_TRIGGERED),true)
+LOCAL_CFLAGS += -DRIL_EVENT_EPOLL_EDGE_TRIGGERED
+endif
+endif
+
+ifneq ($(BOARD_RIL_REQUEST_WORKERS),)
+LOCAL_CFLAGS += -DRIL_REQUEST_WORKERS=$(BOARD_RIL_REQUEST_WORKERS)
+endif
+
+ifneq ($(BOARD_RIL_REQUEST_DEADLINE_MS),)
+LOCAL_CFLAGS += -DRIL_REQUEST_DEADLINE_MS=$(BOARD_RIL_REQUEST_DEADLINE_MS)
+endif
+
+# Allocations and I/O syscalls go through host_shim.cpp to be counted
+RILBENCH_WRAPPED := \
+    malloc calloc realloc \
+    read readv write writev recv accept select \
+    epoll_wait epoll_ctl timerfd_settime
+
+LOCAL_LDFLAGS := $(foreach f,$(RILBENCH_WRAPPED),-Wl,--wrap=$(f))
+LOCAL_LDLIBS := -lpthread -lrt
+
+LOCAL_MODULE:= rilbench
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    atbench.c \
+    ../reference-ril/atchannel.c \
+    ../reference-ril/at_tok.c \
+    ../reference-ril/misc.c
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/../reference-ril
+
+LOCAL_STATIC_LIBRARIES := \
+    liblog
+
+LOCAL_CFLAGS := -D_GNU_SOURCE
+
+LOCAL_LDLIBS := -lpthread -lrt
+
+LOCAL_MODULE:= atbench
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+endif # HOST_OS == linux
@@ -0,0 +1,484 @@
+/* //device/libs/telephony/rilbench/atbench.c
+**
+** Copyright 2026, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+/*
+ * Host micro-benchmark for atchannel's reader thread. Modem output is
+ * written into a socket that atchannel reads with no command pending, so
+ * every line goes through readline() and comes out as an unsolicited
+ * response. The output is a capture of what a modem sent (-f), or bulk
+ * responses made up here: a phonebook dump, an SMS list, PDP contexts and
+ * a network list, between the usual unsolicited responses. Reports MB/s
+ * and lines/s.
+ *
+ * With -c the same lines are only classified, the way the reader thread
+ * and reference-ril's onUnsolicited() sort them by prefix: once through
+ * prefixTableLookup() and once through a chain of strStartsWith() calls,
+ * as they were sorted before.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include "atchannel.h"
+#include "misc.h"
+
+/* Written after the last pass; the clock stops when it comes out */
+#define END_LINE "ATBENCH-END"
+
+struct traffic {
+    char *data;
+    size_t len;
+    size_t cap;
+};
+
+static int s_fd;
+static struct traffic s_traffic;
+static uint32_t s_passes = 5000;
+
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_cond = PTHREAD_COND_INITIALIZER;
+static uint64_t s_lines;
+static int s_done;
+
+/*
+ * atchannel's line classes followed by reference-ril's unsolicited
+ * responses, in the order they used to be tested. Each prefix's value is
+ * its index, or that of its first copy.
+ */
+static const PrefixEntry s_prefixEntries[] = {
+    { "+CMT:", 0 },
+    { "+CDS:", 1 },
+    { "+CBM:", 2 },
+    { "OK", 3 },
+    { "CONNECT", 4 },
+    { "ERROR", 5 },
+    { "+CMS ERROR:", 6 },
+    { "+CME ERROR:", 7 },
+    { "NO CARRIER", 8 },
+    { "NO ANSWER", 9 },
+    { "NO DIALTONE", 10 },
+    { "%CTZV:", 11 },
+    { "+CRING:", 12 },
+    { "RING", 13 },
+    { "NO CARRIER", 8 },
+    { "+CCWA", 15 },
+    { "+CREG:", 16 },
+    { "+CGREG:", 17 },
+    { "+CMT:", 0 },
+    { "+CDS:", 1 },
+    { "+CGEV:", 20 },
+    { "+CTEC: ", 21 },
+    { "+CCSS: ", 22 },
+    { "+WSOS: ", 23 },
+    { "+WPRL: ", 24 },
+    { "+CFUN: 0", 25 },
+};
+
+static PrefixTable s_prefixes = PREFIX_TABLE_INITIALIZER(s_prefixEntries);
+
+#define NUM_PREFIX_ENTRIES \
+    ((int)(sizeof(s_prefixEntries) / sizeof(s_prefixEntries[0])))
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [-f capture] [-n passes] [-v] [-c]\n"
+            "  -f  raw modem output to replay, as read from its tty\n"
+            "  -n  times the output is sent (default 5000)\n"
+            "  -v  keep atchannel's log of every line\n"
+            "  -c  only classify the lines, by trie and by strStartsWith()\n",
+            argv0);
+    exit(-1);
+}
+
+static uint64_t nanoTime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void addLine(struct traffic *t, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/* Appends one line as a verbose modem sends it, \r\n before and after */
+static void addLine(struct traffic *t, const char *fmt, ...)
+{
+    va_list ap;
+    int len;
+
+    for (;;) {
+        va_start(ap, fmt);
+        len = vsnprintf(t->data + t->len, t->cap - t->len, fmt, ap);
+        va_end(ap);
+
+        if (len >= 0 && t->len + len + 4 < t->cap) {
+            break;
+        }
+        t->cap = t->cap ? t->cap * 2 : 64 * 1024;
+        t->data = realloc(t->data, t->cap);
+        if (t->data == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            exit(-1);
+        }
+    }
+
+    /* move the line up past its leading \r\n */
+    memmove(t->data + t->len + 2, t->data + t->len, len);
+    memcpy(t->data + t->len, "\r\n", 2);
+    memcpy(t->data + t->len + 2 + len, "\r\n", 2);
+    t->len += len + 4;
+}
+
+static void makeTraffic(struct traffic *t)
+{
+    int i;
+
+    addLine(t, "+CREG: 1,\"00C3\",\"0000A2F1\",7");
+    addLine(t, "+CSQ: 20,99");
+
+    /* AT+CPBR=1,250 */
+    for (i = 1 ; i <= 250 ; i++) {
+        addLine(t, "+CPBR: %d,\"+1555%07d\",145,\"Contact %d\"",
+                i, i * 7919, i);
+    }
+    addLine(t, "OK");
+
+    /* AT+CMGL=4, PDU mode */
+    for (i = 0 ; i < 50 ; i++) {
+        addLine(t, "+CMGL: %d,1,,%d", i, 140);
+        addLine(t, "07919730071111F1040B919730%08dF100009921%06d2100"
+                "8CC8329BFD065DDF72363904A296E5A0B4F9BD4FCBD3E4B21D5D06"
+                "A5DDE674591E96BF41E432E88E2E83DA6F50D06D4F97E979D8FD76"
+                "83A6CD29A8A5DE04", i * 13, i);
+    }
+    addLine(t, "OK");
+
+    addLine(t, "+CGREG: 1,\"00C3\",\"0000A2F1\",7");
+
+    /* AT+CGDCONT? */
+    for (i = 1 ; i <= 8 ; i++) {
+        addLine(t, "+CGDCONT: %d,\"IPV4V6\",\"internet%d.example.com\","
+                "\"10.%d.0.%d\",0,0", i, i, i, i * 3);
+    }
+    addLine(t, "OK");
+
+    /* AT+COPS=? */
+    addLine(t, "+COPS: (2,\"Operator A\",\"OpA\",\"310260\",7),"
+            "(1,\"Operator B\",\"OpB\",\"310410\",7),"
+            "(1,\"Operator B\",\"OpB\",\"310410\",2),"
+            "(3,\"Operator C\",\"OpC\",\"311480\",7),"
+            "(1,\"Operator D\",\"OpD\",\"310120\",0),"
+            ",(0,1,2,3,4),(0,1,2)");
+    addLine(t, "OK");
+
+    addLine(t, "+CSQ: 21,99");
+}
+
+static int loadCapture(struct traffic *t, const char *path)
+{
+    FILE *f;
+    long size;
+
+    f = fopen(path, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "Could not open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    t->data = malloc(size > 0 ? size : 1);
+    t->len = t->data != NULL ? fread(t->data, 1, size, f) : 0;
+    fclose(f);
+
+    if (t->len == 0) {
+        fprintf(stderr, "Nothing to replay in %s\n", path);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int classifyByChain(const char *line)
+{
+    int i;
+
+    for (i = 0 ; i < NUM_PREFIX_ENTRIES ; i++) {
+        if (strStartsWith(line, s_prefixEntries[i].prefix)) {
+            return s_prefixEntries[i].value;
+        }
+    }
+
+    return -1;
+}
+
+static void printRate(const char *name, uint64_t elapsedNs, uint64_t lines)
+{
+    double seconds = elapsedNs / 1e9;
+
+    printf("  %-16s %llu lines in %.3f s, %.1f ns/line, %.0f lines/s\n",
+            name, (unsigned long long)lines, seconds,
+            lines > 0 ? (double)elapsedNs / lines : 0,
+            seconds > 0 ? lines / seconds : 0);
+}
+
+/* Splits the output into its lines, as readline() would, and times -c */
+static int classifyLines(void)
+{
+    char *text;
+    char **lines = NULL;
+    size_t count = 0;
+    size_t cap = 0;
+    size_t i;
+    char *p;
+    char *eol;
+    uint32_t pass;
+    uint64_t start;
+    uint64_t chainNs;
+    uint64_t trieNs;
+    uint64_t sum;
+    uint64_t check;
+
+    text = malloc(s_traffic.len + 1);
+    if (text == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+    memcpy(text, s_traffic.data, s_traffic.len);
+    text[s_traffic.len] = '\0';
+
+    for (p = text ; *p != '\0' ; p = eol) {
+        eol = p + strcspn(p, "\r\n");
+        if (*eol != '\0') {
+            *eol++ = '\0';
+        }
+        if (*p == '\0') {
+            continue;
+        }
+        if (count == cap) {
+            cap = cap ? cap * 2 : 1024;
+            lines = realloc(lines, cap * sizeof(char *));
+            if (lines == NULL) {
+                fprintf(stderr, "Out of memory\n");
+                return -1;
+            }
+        }
+        lines[count++] = p;
+    }
+
+    /* builds the trie, and makes sure both agree before timing them */
+    for (i = 0 ; i < count ; i++) {
+        if (prefixTableLookup(&s_prefixes, lines[i], -1)
+                != classifyByChain(lines[i])) {
+            fprintf(stderr, "Classified differently: %s\n", lines[i]);
+            return -1;
+        }
+    }
+
+    start = nanoTime();
+    sum = 0;
+    for (pass = 0 ; pass < s_passes ; pass++) {
+        for (i = 0 ; i < count ; i++) {
+            sum += classifyByChain(lines[i]);
+        }
+    }
+    chainNs = nanoTime() - start;
+    check = sum;
+
+    start = nanoTime();
+    sum = 0;
+    for (pass = 0 ; pass < s_passes ; pass++) {
+        for (i = 0 ; i < count ; i++) {
+            sum += prefixTableLookup(&s_prefixes, lines[i], -1);
+        }
+    }
+    trieNs = nanoTime() - start;
+
+    if (sum != check) {
+        fprintf(stderr, "Classified differently while timing\n");
+        return -1;
+    }
+
+    printRate("strStartsWith()", chainNs, (uint64_t)count * s_passes);
+    printRate("prefix trie", trieNs, (uint64_t)count * s_passes);
+
+    free(lines);
+    free(text);
+
+    return 0;
+}
+
+static int writeAll(int fd, const void *buf, size_t len)
+{
+    const char *p = (const char *)buf;
+    ssize_t written;
+
+    while (len > 0) {
+        written = write(fd, p, len);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += written;
+        len -= written;
+    }
+
+    return 0;
+}
+
+static void *writerLoop(void *arg)
+{
+    static const char end[] = "\r\n" END_LINE "\r\n";
+    uint32_t i;
+
+    for (i = 0 ; i < s_passes ; i++) {
+        if (writeAll(s_fd, s_traffic.data, s_traffic.len) < 0) {
+            fprintf(stderr, "Error writing: %s\n", strerror(errno));
+            exit(-1);
+        }
+    }
+    writeAll(s_fd, end, sizeof(end) - 1);
+
+    return NULL;
+}
+
+static void onUnsolicited(const char *s, const char *sms_pdu)
+{
+    if (strcmp(s, END_LINE) == 0) {
+        pthread_mutex_lock(&s_mutex);
+        s_done = 1;
+        pthread_cond_signal(&s_cond);
+        pthread_mutex_unlock(&s_mutex);
+        return;
+    }
+
+    /* only the reader thread counts */
+    s_lines += sms_pdu != NULL ? 2 : 1;
+}
+
+static void onReaderClosed(void)
+{
+    fprintf(stderr, "atchannel closed before the end of the output\n");
+    exit(-1);
+}
+
+int main(int argc, char **argv)
+{
+    const char *capture = NULL;
+    int verbose = 0;
+    int classify = 0;
+    pthread_t writer;
+    uint64_t start;
+    uint64_t elapsedNs;
+    double seconds;
+    double bytes;
+    int sv[2];
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:n:vc")) != -1) {
+        switch (opt) {
+            case 'f': capture = optarg; break;
+            case 'n': s_passes = strtoul(optarg, NULL, 0); break;
+            case 'v': verbose = 1; break;
+            case 'c': classify = 1; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (s_passes == 0) {
+        usage(argv[0]);
+    }
+
+    /*
+     * atchannel logs every line it reads at debug level; unless asked for,
+     * keep that out of what is measured
+     */
+    if (!verbose) {
+        setenv("ANDROID_LOG_TAGS", "*:i", 0);
+    }
+
+    if (capture != NULL) {
+        if (loadCapture(&s_traffic, capture) < 0) {
+            return -1;
+        }
+    } else {
+        makeTraffic(&s_traffic);
+    }
+
+    if (classify) {
+        printf("atbench -c: %s (%zu bytes), %u passes\n",
+                capture != NULL ? capture : "bulk responses", s_traffic.len,
+                s_passes);
+        return classifyLines() < 0 ? -1 : 0;
+    }
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+        fprintf(stderr, "Could not create socket pair: %s\n", strerror(errno));
+        return -1;
+    }
+    s_fd = sv[1];
+
+    at_set_on_reader_closed(onReaderClosed);
+    if (at_open(sv[0], onUnsolicited) < 0) {
+        fprintf(stderr, "Could not open the AT channel\n");
+        return -1;
+    }
+
+    printf("atbench: %s (%zu bytes), %u passes\n",
+            capture != NULL ? capture : "bulk responses", s_traffic.len,
+            s_passes);
+
+    start = nanoTime();
+    if (pthread_create(&writer, NULL, writerLoop, NULL) != 0) {
+        fprintf(stderr, "Could not start the writer\n");
+        return -1;
+    }
+
+    pthread_mutex_lock(&s_mutex);
+    while (!s_done) {
+        pthread_cond_wait(&s_cond, &s_mutex);
+    }
+    pthread_mutex_unlock(&s_mutex);
+
+    elapsedNs = nanoTime() - start;
+    pthread_join(writer, NULL);
+
+    seconds = elapsedNs / 1e9;
+    bytes = (double)s_traffic.len * s_passes;
+    printf("  %llu lines in %.3f s, %.1f MB/s, %.0f lines/s\n",
+            (unsigned long long)s_lines, seconds,
+            seconds > 0 ? bytes / seconds / 1e6 : 0,
+            seconds > 0 ? s_lines / seconds : 0);
+
+    at_set_on_reader_closed(NULL);
+    at_close();
+    close(s_fd);
+
+    return 0;
+}
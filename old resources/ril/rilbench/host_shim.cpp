@@ -0,0 +1,216 @@
+/* //device/libs/telephony/rilbench/host_shim.cpp
+**
+** Copyright 2026, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+/*
+ * Device-only pieces libril needs on the host, and the counters behind
+ * rilbench's allocations and syscalls per request. The counted calls are
+ * routed here with the linker's --wrap, see Android.mk; futexes taken by
+ * contended mutexes are not libc calls and are not counted.
+ */
+
+#include <new>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pwd.h>
+#include <sys/epoll.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#include <hardware_legacy/power.h>
+#include "rilbench.h"
+
+static struct rilbench_counters s_counters;
+static __thread bool s_excluded;
+
+static inline void countAlloc()
+{
+    if (!s_excluded) {
+        __atomic_add_fetch(&s_counters.allocs, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static inline void countSyscall()
+{
+    if (!s_excluded) {
+        __atomic_add_fetch(&s_counters.syscalls, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void rilbench_exclude_thread(void)
+{
+    s_excluded = true;
+}
+
+void rilbench_get_counters(struct rilbench_counters * counters)
+{
+    counters->allocs = __atomic_load_n(&s_counters.allocs, __ATOMIC_RELAXED);
+    counters->syscalls = __atomic_load_n(&s_counters.syscalls, __ATOMIC_RELAXED);
+}
+
+extern "C" {
+
+void * __real_malloc(size_t size);
+void * __real_calloc(size_t count, size_t size);
+void * __real_realloc(void * ptr, size_t size);
+ssize_t __real_read(int fd, void * buf, size_t count);
+ssize_t __real_readv(int fd, const struct iovec * iov, int iovcnt);
+ssize_t __real_write(int fd, const void * buf, size_t count);
+ssize_t __real_writev(int fd, const struct iovec * iov, int iovcnt);
+ssize_t __real_recv(int fd, void * buf, size_t len, int flags);
+int __real_accept(int fd, struct sockaddr * addr, socklen_t * addrlen);
+int __real_select(int nfds, fd_set * readfds, fd_set * writefds,
+        fd_set * exceptfds, struct timeval * timeout);
+int __real_epoll_wait(int epfd, struct epoll_event * events, int maxevents,
+        int timeout);
+int __real_epoll_ctl(int epfd, int op, int fd, struct epoll_event * event);
+int __real_timerfd_settime(int fd, int flags,
+        const struct itimerspec * new_value, struct itimerspec * old_value);
+
+void * __wrap_malloc(size_t size)
+{
+    countAlloc();
+    return __real_malloc(size);
+}
+
+void * __wrap_calloc(size_t count, size_t size)
+{
+    countAlloc();
+    return __real_calloc(count, size);
+}
+
+void * __wrap_realloc(void * ptr, size_t size)
+{
+    countAlloc();
+    return __real_realloc(ptr, size);
+}
+
+ssize_t __wrap_read(int fd, void * buf, size_t count)
+{
+    countSyscall();
+    return __real_read(fd, buf, count);
+}
+
+ssize_t __wrap_readv(int fd, const struct iovec * iov, int iovcnt)
+{
+    countSyscall();
+    return __real_readv(fd, iov, iovcnt);
+}
+
+ssize_t __wrap_write(int fd, const void * buf, size_t count)
+{
+    countSyscall();
+    return __real_write(fd, buf, count);
+}
+
+ssize_t __wrap_writev(int fd, const struct iovec * iov, int iovcnt)
+{
+    countSyscall();
+    return __real_writev(fd, iov, iovcnt);
+}
+
+ssize_t __wrap_recv(int fd, void * buf, size_t len, int flags)
+{
+    countSyscall();
+    return __real_recv(fd, buf, len, flags);
+}
+
+int __wrap_accept(int fd, struct sockaddr * addr, socklen_t * addrlen)
+{
+    countSyscall();
+    return __real_accept(fd, addr, addrlen);
+}
+
+int __wrap_select(int nfds, fd_set * readfds, fd_set * writefds,
+        fd_set * exceptfds, struct timeval * timeout)
+{
+    countSyscall();
+    return __real_select(nfds, readfds, writefds, exceptfds, timeout);
+}
+
+int __wrap_epoll_wait(int epfd, struct epoll_event * events, int maxevents,
+        int timeout)
+{
+    countSyscall();
+    return __real_epoll_wait(epfd, events, maxevents, timeout);
+}
+
+int __wrap_epoll_ctl(int epfd, int op, int fd, struct epoll_event * event)
+{
+    countSyscall();
+    return __real_epoll_ctl(epfd, op, fd, event);
+}
+
+int __wrap_timerfd_settime(int fd, int flags,
+        const struct itimerspec * new_value, struct itimerspec * old_value)
+{
+    countSyscall();
+    return __real_timerfd_settime(fd, flags, new_value, old_value);
+}
+
+// libhardware_legacy is device-only; there is nothing to keep awake here
+int acquire_wake_lock(int lock, const char * id)
+{
+    return 0;
+}
+
+int release_wake_lock(const char * id)
+{
+    return 0;
+}
+
+/*
+ * libril only accepts a command socket whose peer runs as the radio user.
+ * The peer here is rilbench itself, so report every uid as that user.
+ */
+struct passwd * getpwuid(uid_t uid)
+{
+    static char name[] = "radio";
+    static struct passwd pwd;
+
+    pwd.pw_name = name;
+    pwd.pw_uid = uid;
+    return &pwd;
+}
+
+} // extern "C"
+
+// libril allocates its Parcels with new; count those as well
+void * operator new(size_t size)
+{
+    void * p = malloc(size);
+
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void * operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void * p) throw()
+{
+    free(p);
+}
+
+void operator delete[](void * p) throw()
+{
+    free(p);
+}
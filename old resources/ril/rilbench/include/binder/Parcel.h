@@ -0,0 +1,247 @@
+/* //device/libs/telephony/rilbench/include/binder/Parcel.h
+**
+** Copyright 2026, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+/*
+ * Host stand-in for libbinder's Parcel, which is not built for the host.
+ * Only the calls made by libril are provided. Buffers are owned, grown and
+ * kept the way libbinder does it (setData() copies, growth is 3/2, shrinking
+ * keeps the buffer), so the allocations rilbench counts match the device.
+ */
+
+#ifndef RILBENCH_PARCEL_H
+#define RILBENCH_PARCEL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <utils/Errors.h>
+#include <utils/String16.h>
+
+namespace android {
+
+class Parcel {
+public:
+    Parcel() : mData(NULL), mDataSize(0), mDataCapacity(0), mDataPos(0) {}
+    ~Parcel() { free(mData); }
+
+    const uint8_t* data() const { return mData; }
+    size_t dataSize() const { return mDataSize; }
+    size_t dataPosition() const { return mDataPos; }
+    size_t dataCapacity() const { return mDataCapacity; }
+
+    void setDataPosition(size_t pos) const { mDataPos = pos; }
+
+    status_t setDataSize(size_t size) {
+        status_t err = continueWrite(size);
+        if (err == NO_ERROR) {
+            mDataSize = size;
+        }
+        return err;
+    }
+
+    status_t setDataCapacity(size_t size) {
+        return size > mDataCapacity ? continueWrite(size) : NO_ERROR;
+    }
+
+    status_t setData(const uint8_t* buffer, size_t len) {
+        status_t err = restartWrite(len);
+        if (err == NO_ERROR) {
+            memcpy(mData, buffer, len);
+            mDataSize = len;
+        }
+        return err;
+    }
+
+    status_t appendFrom(const Parcel *parcel, size_t start, size_t len) {
+        if (start > parcel->mDataSize || len > parcel->mDataSize - start) {
+            return BAD_VALUE;
+        }
+        return write(parcel->mData + start, len);
+    }
+
+    status_t write(const void* data, size_t len) {
+        void* d = writeInplace(len);
+        if (d == NULL) {
+            return NO_MEMORY;
+        }
+        memcpy(d, data, len);
+        return NO_ERROR;
+    }
+
+    void* writeInplace(size_t len) {
+        size_t padded = padSize(len);
+
+        if (padded < len) {
+            return NULL;
+        }
+        if (mDataPos + padded > mDataCapacity
+                && growData(padded) != NO_ERROR) {
+            return NULL;
+        }
+
+        uint8_t* data = mData + mDataPos;
+        if (padded != len) {
+            memset(data + len, 0, padded - len);
+        }
+        finishWrite(padded);
+        return data;
+    }
+
+    status_t writeInt32(int32_t val) { return writeAligned(val); }
+    status_t writeInt64(int64_t val) { return writeAligned(val); }
+
+    status_t writeString16(const char16_t* str, size_t len) {
+        if (str == NULL) {
+            return writeInt32(-1);
+        }
+
+        status_t err = writeInt32(len);
+        if (err != NO_ERROR) {
+            return err;
+        }
+        len *= sizeof(char16_t);
+        uint8_t* data = (uint8_t*)writeInplace(len + sizeof(char16_t));
+        if (data == NULL) {
+            return NO_MEMORY;
+        }
+        memcpy(data, str, len);
+        *reinterpret_cast<char16_t*>(data + len) = 0;
+        return NO_ERROR;
+    }
+
+    status_t writeString16(const String16& str) {
+        return writeString16(str.string(), str.size());
+    }
+
+    status_t read(void* outData, size_t len) const {
+        const void* data = readInplace(len);
+        if (data == NULL) {
+            return NOT_ENOUGH_DATA;
+        }
+        memcpy(outData, data, len);
+        return NO_ERROR;
+    }
+
+    const void* readInplace(size_t len) const {
+        size_t padded = padSize(len);
+
+        if (padded < len || mDataPos + padded > mDataSize) {
+            return NULL;
+        }
+        const void* data = mData + mDataPos;
+        mDataPos += padded;
+        return data;
+    }
+
+    status_t readInt32(int32_t* pArg) const { return read(pArg, sizeof(*pArg)); }
+
+    int32_t readInt32() const {
+        int32_t val = 0;
+        read(&val, sizeof(val));
+        return val;
+    }
+
+    const char16_t* readString16Inplace(size_t* outLen) const {
+        int32_t size = readInt32();
+
+        if (size >= 0 && size < INT32_MAX) {
+            const char16_t* str = (const char16_t*)readInplace(
+                    (size + 1) * sizeof(char16_t));
+            if (str != NULL) {
+                *outLen = size;
+                return str;
+            }
+        }
+        *outLen = 0;
+        return NULL;
+    }
+
+    String16 readString16() const {
+        size_t len;
+        const char16_t* str = readString16Inplace(&len);
+        return str != NULL ? String16(str, len) : String16();
+    }
+
+private:
+    Parcel(const Parcel&);
+    Parcel& operator=(const Parcel&);
+
+    static size_t padSize(size_t len) { return (len + 3) & ~(size_t)3; }
+
+    template<class T>
+    status_t writeAligned(T val) {
+        if (mDataPos + sizeof(val) > mDataCapacity
+                && growData(sizeof(val)) != NO_ERROR) {
+            return NO_MEMORY;
+        }
+        memcpy(mData + mDataPos, &val, sizeof(val));
+        finishWrite(sizeof(val));
+        return NO_ERROR;
+    }
+
+    void finishWrite(size_t len) {
+        mDataPos += len;
+        if (mDataPos > mDataSize) {
+            mDataSize = mDataPos;
+        }
+    }
+
+    status_t growData(size_t len) {
+        return continueWrite(((mDataSize + len) * 3) / 2);
+    }
+
+    status_t restartWrite(size_t desired) {
+        uint8_t* data = (uint8_t*)realloc(mData, desired);
+        if (data == NULL && desired > mDataCapacity) {
+            return NO_MEMORY;
+        }
+        if (data != NULL) {
+            mData = data;
+            mDataCapacity = desired;
+        }
+        mDataSize = mDataPos = 0;
+        return NO_ERROR;
+    }
+
+    status_t continueWrite(size_t desired) {
+        if (desired > mDataCapacity) {
+            uint8_t* data = (uint8_t*)realloc(mData, desired);
+            if (data == NULL) {
+                return NO_MEMORY;
+            }
+            mData = data;
+            mDataCapacity = desired;
+        } else {
+            if (mDataSize > desired) {
+                mDataSize = desired;
+            }
+            if (mDataPos > desired) {
+                mDataPos = desired;
+            }
+        }
+        return NO_ERROR;
+    }
+
+    uint8_t* mData;
+    size_t mDataSize;
+    size_t mDataCapacity;
+    mutable size_t mDataPos;
+};
+
+}; // namespace android
+
+#endif // RILBENCH_PARCEL_H
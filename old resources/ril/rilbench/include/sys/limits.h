@@ -0,0 +1,24 @@
+/* //device/libs/telephony/rilbench/include/sys/limits.h
+**
+** Copyright 2026, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef RILBENCH_SYS_LIMITS_H
+#define RILBENCH_SYS_LIMITS_H
+
+// bionic's <sys/limits.h>; glibc keeps the same limits in <limits.h>
+#include <limits.h>
+
+#endif // RILBENCH_SYS_LIMITS_H
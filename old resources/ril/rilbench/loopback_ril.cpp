@@ -0,0 +1,154 @@
+/* //device/libs/telephony/rilbench/loopback_ril.cpp
+**
+** Copyright 2026, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#define LOG_TAG "RILB"
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <utils/Log.h>
+#include <telephony/librilutils.h>
+#include "rilbench.h"
+
+// Completions waiting out their delay; a ring, so queueing never allocates
+#define LOOPBACK_QUEUE_SIZE 4096
+
+struct Completion {
+    RIL_Token t;
+    uint64_t dueNs;
+};
+
+static Completion s_queue[LOOPBACK_QUEUE_SIZE];
+static uint32_t s_head;
+static uint32_t s_count;
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_workCond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t s_spaceCond = PTHREAD_COND_INITIALIZER;
+static uint64_t s_delayNs;
+
+#if defined(ANDROID_MULTI_SIM)
+static void onRequest(int request, void *data, size_t datalen, RIL_Token t,
+        RIL_SOCKET_ID socket_id)
+#else
+static void onRequest(int request, void *data, size_t datalen, RIL_Token t)
+#endif
+{
+    if (s_delayNs == 0) {
+        RIL_onRequestComplete(t, RIL_E_SUCCESS, NULL, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&s_mutex);
+    while (s_count == LOOPBACK_QUEUE_SIZE) {
+        pthread_cond_wait(&s_spaceCond, &s_mutex);
+    }
+    Completion *c = &s_queue[(s_head + s_count) % LOOPBACK_QUEUE_SIZE];
+    c->t = t;
+    c->dueNs = ril_nano_time() + s_delayNs;
+    if (s_count++ == 0) {
+        pthread_cond_signal(&s_workCond);
+    }
+    pthread_mutex_unlock(&s_mutex);
+}
+
+/*
+ * Every completion has the same delay, so the oldest one is always due
+ * first and the queue stays in order.
+ */
+static void *completionLoop(void *param)
+{
+    struct timespec due;
+    Completion c;
+
+    for (;;) {
+        pthread_mutex_lock(&s_mutex);
+        while (s_count == 0) {
+            pthread_cond_wait(&s_workCond, &s_mutex);
+        }
+        c = s_queue[s_head];
+        pthread_mutex_unlock(&s_mutex);
+
+        due.tv_sec = c.dueNs / 1000000000ULL;
+        due.tv_nsec = c.dueNs % 1000000000ULL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) != 0);
+
+        pthread_mutex_lock(&s_mutex);
+        s_head = (s_head + 1) % LOOPBACK_QUEUE_SIZE;
+        if (s_count-- == LOOPBACK_QUEUE_SIZE) {
+            pthread_cond_signal(&s_spaceCond);
+        }
+        pthread_mutex_unlock(&s_mutex);
+
+        RIL_onRequestComplete(c.t, RIL_E_SUCCESS, NULL, 0);
+    }
+
+    return NULL;
+}
+
+#if defined(ANDROID_MULTI_SIM)
+static RIL_RadioState onStateRequest(RIL_SOCKET_ID socket_id)
+#else
+static RIL_RadioState onStateRequest()
+#endif
+{
+    return RADIO_STATE_ON;
+}
+
+static int onSupports(int requestCode)
+{
+    return 1;
+}
+
+static void onCancel(RIL_Token t)
+{
+}
+
+static const char *getVersion(void)
+{
+    return "loopback-ril 1.0";
+}
+
+static const RIL_RadioFunctions s_callbacks = {
+    RIL_VERSION,
+    onRequest,
+    onStateRequest,
+    onSupports,
+    onCancel,
+    getVersion
+};
+
+const RIL_RadioFunctions * loopback_ril_init(uint32_t delayUs)
+{
+    pthread_attr_t attr;
+    pthread_t tid;
+    int ret;
+
+    s_delayNs = (uint64_t)delayUs * 1000;
+    if (s_delayNs == 0) {
+        return &s_callbacks;
+    }
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    ret = pthread_create(&tid, &attr, completionLoop, NULL);
+    if (ret != 0) {
+        RLOGE("Failed to create completion thread: %s", strerror(ret));
+        return NULL;
+    }
+
+    return &s_callbacks;
+}
@@ -0,0 +1,540 @@
+/* //device/libs/telephony/rilbench/rilbench.cpp
+**
+** Copyright 2026, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+/*
+ * Host benchmark for libril. libril is linked in as rild would load it,
+ * registered with the loopback vendor RIL, and driven through its command
+ * socket by a client that keeps a fixed number of requests in flight. The
+ * client replays the default mix of an idle phone, or the requests the
+ * framework sent in a radio.log. Reports requests/s, latency percentiles,
+ * and the allocations and syscalls libril makes per request.
+ */
+
+#define LOG_TAG "RILB"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include <utils/Log.h>
+#include <telephony/ril.h>
+#include <telephony/record_stream.h>
+#include <telephony/librilutils.h>
+#include <ril_histogram.h>
+#include "rilbench.h"
+
+extern "C" void RIL_startEventLoop(void);
+extern "C" const char * requestToString(int request);
+
+#define NUM_ELEMS(a)     (sizeof (a) / sizeof (a)[0])
+
+#define RESPONSE_SOLICITED 0
+
+// Same limit libril applies to a command
+#define MAX_COMMAND_BYTES (8 * 1024)
+
+// Parcel after the request code and token. The leading 1 is a count or
+// length that every dispatch function accepts; the rest parses as zeros
+// and empty strings.
+#define REQUEST_PAYLOAD_BYTES 64
+
+// Give up when libril has not answered anything for this long
+#define RESPONSE_TIMEOUT_MS 5000
+
+#define MAX_SEQUENCE 4096
+
+// dumpStats command of the debug socket
+#define DEBUG_DUMP_STATS "14"
+
+// Requests of a phone sitting idle on the home screen, by relative weight
+static const struct {
+    int request;
+    int weight;
+} s_defaultMix[] = {
+    { RIL_REQUEST_SIGNAL_STRENGTH, 8 },
+    { RIL_REQUEST_VOICE_REGISTRATION_STATE, 4 },
+    { RIL_REQUEST_DATA_REGISTRATION_STATE, 4 },
+    { RIL_REQUEST_OPERATOR, 4 },
+    { RIL_REQUEST_GET_CURRENT_CALLS, 4 },
+    { RIL_REQUEST_QUERY_NETWORK_SELECTION_MODE, 2 },
+    { RIL_REQUEST_GET_SIM_STATUS, 2 },
+    { RIL_REQUEST_DATA_CALL_LIST, 1 },
+    { RIL_REQUEST_SCREEN_STATE, 1 },
+    { RIL_REQUEST_SEND_SMS, 1 },
+    { RIL_REQUEST_GET_IMEI, 1 },
+    { RIL_REQUEST_BASEBAND_VERSION, 1 },
+};
+
+struct Client {
+    int fd;
+    RecordStream *rs;
+    const int *sequence;
+    size_t sequenceLen;
+    size_t next;        // next entry of sequence to send
+    int32_t nextToken;
+    uint32_t depth;     // requests kept in flight
+};
+
+struct RunResult {
+    uint32_t answered;
+    uint32_t errors;    // answered with an error
+    uint64_t elapsedNs;
+    struct ril_histogram latency;
+    struct rilbench_counters counters;
+};
+
+static char s_socketDir[PATH_MAX];
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [-n requests] [-p depth] [-d delay_us] [-w warmup]\n"
+            "          [-r radio.log] [-s]\n"
+            "  -n  requests to measure (default 100000)\n"
+            "  -p  requests kept in flight (default 16)\n"
+            "  -d  vendor RIL completion delay in us, 0 completes inline\n"
+            "  -w  requests sent before measuring (default 1000)\n"
+            "  -r  replay the requests the framework sent in a radio.log\n"
+            "  -s  print libril's request stats afterwards\n", argv0);
+    exit(-1);
+}
+
+static const char *stripRequestPrefix(const char *name)
+{
+    if (strncmp(name, "RIL_REQUEST_", 12) == 0) {
+        return name + 12;
+    }
+    if (strncmp(name, "REQUEST_", 8) == 0) {
+        return name + 8;
+    }
+    return name;
+}
+
+// Request code libril logs as name, or -1
+static int requestFromName(const char *name)
+{
+    static const int ranges[][2] = {
+        { 1, RIL_REQUEST_SHUTDOWN },
+        { SAMSUNG_REQUEST_BASE, RIL_REQUEST_HANGUP_VT },
+    };
+
+    name = stripRequestPrefix(name);
+    for (size_t i = 0; i < NUM_ELEMS(ranges); i++) {
+        for (int request = ranges[i][0]; request <= ranges[i][1]; request++) {
+            if (strcmp(stripRequestPrefix(requestToString(request)), name) == 0) {
+                return request;
+            }
+        }
+    }
+    return -1;
+}
+
+static size_t loadDefaultMix(int *sequence)
+{
+    size_t len = 0;
+    int maxWeight = 0;
+
+    for (size_t i = 0; i < NUM_ELEMS(s_defaultMix); i++) {
+        maxWeight = s_defaultMix[i].weight > maxWeight
+                ? s_defaultMix[i].weight : maxWeight;
+    }
+    // interleave, so heavy requests are spread over the sequence
+    for (int round = 0; round < maxWeight; round++) {
+        for (size_t i = 0; i < NUM_ELEMS(s_defaultMix); i++) {
+            if (s_defaultMix[i].weight > round) {
+                sequence[len++] = s_defaultMix[i].request;
+            }
+        }
+    }
+    return len;
+}
+
+/*
+ * Pick up the requests RILJ logged as "[serial]> NAME ..." in a radio.log.
+ * Names libril does not know are skipped and counted.
+ */
+static size_t loadRadioLog(const char *path, int *sequence)
+{
+    char line[1024];
+    char name[128];
+    size_t len = 0;
+    int unknown = 0;
+    FILE *f;
+
+    f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "Could not open %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+
+    while (len < MAX_SEQUENCE && fgets(line, sizeof(line), f) != NULL) {
+        char *p = strstr(line, "]> ");
+        int request;
+
+        if (p == NULL || sscanf(p + 3, "%127[A-Z0-9_]", name) != 1) {
+            continue;
+        }
+        request = requestFromName(name);
+        if (request < 0) {
+            unknown++;
+            continue;
+        }
+        sequence[len++] = request;
+    }
+    fclose(f);
+
+    if (unknown > 0) {
+        fprintf(stderr, "%s: skipped %d requests libril does not know\n",
+                path, unknown);
+    }
+    return len;
+}
+
+// Bind a socket for libril to pick up with android_get_control_socket()
+static int createControlSocket(const char *name, char *path, size_t pathLen)
+{
+    struct sockaddr_un addr;
+    char env[64];
+    char fdString[16];
+    int fd;
+
+    snprintf(path, pathLen, "%s/%s", s_socketDir, name);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "Could not bind %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    snprintf(env, sizeof(env), "ANDROID_SOCKET_%s", name);
+    snprintf(fdString, sizeof(fdString), "%d", fd);
+    setenv(env, fdString, 1);
+    return fd;
+}
+
+static int connectSocket(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "Could not connect to %s: %s\n", path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+static int writeAll(int fd, const void *buf, size_t len)
+{
+    const char *p = (const char *)buf;
+    struct pollfd pfd = { fd, POLLOUT, 0 };
+
+    while (len > 0) {
+        ssize_t written = write(fd, p, len);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN && poll(&pfd, 1, RESPONSE_TIMEOUT_MS) > 0) continue;
+            return -1;
+        }
+        p += written;
+        len -= written;
+    }
+    return 0;
+}
+
+static int sendRequest(Client *c)
+{
+    uint32_t record[3 + REQUEST_PAYLOAD_BYTES / sizeof(uint32_t)];
+
+    memset(record, 0, sizeof(record));
+    record[0] = htonl(sizeof(record) - sizeof(uint32_t));
+    record[1] = c->sequence[c->next];
+    record[2] = c->nextToken++;
+    record[3] = 1;
+
+    c->next = (c->next + 1) % c->sequenceLen;
+    return writeAll(c->fd, record, sizeof(record));
+}
+
+/*
+ * Wait for the next solicited response and return its token and error.
+ * Unsolicited responses such as RIL_CONNECTED are skipped. Returns -1 on
+ * end of stream or after RESPONSE_TIMEOUT_MS without a response.
+ */
+static int readResponse(Client *c, int32_t *token, int32_t *error)
+{
+    struct pollfd pfd = { c->fd, POLLIN, 0 };
+    void *record;
+    size_t len;
+    int ret;
+
+    for (;;) {
+        ret = record_stream_get_next(c->rs, &record, &len);
+        if (ret == 0 && record == NULL) {
+            fprintf(stderr, "libril closed the command socket\n");
+            return -1;
+        }
+        if (ret < 0) {
+            if (errno != EAGAIN && errno != EINTR) {
+                fprintf(stderr, "Error reading responses: %s\n", strerror(errno));
+                return -1;
+            }
+            if (poll(&pfd, 1, RESPONSE_TIMEOUT_MS) == 0) {
+                fprintf(stderr, "No response for %d ms\n", RESPONSE_TIMEOUT_MS);
+                return -1;
+            }
+            continue;
+        }
+        if (len < 3 * sizeof(int32_t)
+                || ((int32_t *)record)[0] != RESPONSE_SOLICITED) {
+            continue;
+        }
+        *token = ((int32_t *)record)[1];
+        *error = ((int32_t *)record)[2];
+        return 0;
+    }
+}
+
+static int runRequests(Client *c, uint32_t count, RunResult *result)
+{
+    int32_t firstToken = c->nextToken;
+    uint64_t *sentNs;
+    uint64_t startNs;
+    uint32_t sent = 0;
+    int32_t token;
+    int32_t error;
+    int ret = 0;
+
+    memset(result, 0, sizeof(*result));
+    sentNs = (uint64_t *)calloc(count, sizeof(uint64_t));
+    if (sentNs == NULL) {
+        return -1;
+    }
+
+    rilbench_get_counters(&result->counters);
+    startNs = ril_nano_time();
+
+    while (result->answered < count) {
+        while (sent < count && sent - result->answered < c->depth) {
+            sentNs[sent] = ril_nano_time();
+            if (sendRequest(c) < 0) {
+                fprintf(stderr, "Error sending request: %s\n", strerror(errno));
+                ret = -1;
+                goto done;
+            }
+            sent++;
+        }
+
+        if (readResponse(c, &token, &error) < 0) {
+            ret = -1;
+            goto done;
+        }
+        if (token < firstToken || token >= firstToken + (int32_t)sent) {
+            continue;
+        }
+        ril_histogram_add(&result->latency,
+                (ril_nano_time() - sentNs[token - firstToken]) / 1000);
+        result->answered++;
+        if (error != RIL_E_SUCCESS) {
+            result->errors++;
+        }
+    }
+
+done:
+    result->elapsedNs = ril_nano_time() - startNs;
+    struct rilbench_counters end;
+    rilbench_get_counters(&end);
+    result->counters.allocs = end.allocs - result->counters.allocs;
+    result->counters.syscalls = end.syscalls - result->counters.syscalls;
+
+    if (result->answered < sent) {
+        fprintf(stderr, "%u of %u requests were not answered\n",
+                sent - result->answered, sent);
+    }
+    free(sentNs);
+    return ret;
+}
+
+static void printResult(RunResult *r)
+{
+    double seconds = r->elapsedNs / 1e9;
+    double answered = r->answered > 0 ? r->answered : 1;
+
+    printf("  %u requests in %.3f s, %.0f requests/s, %u errors\n",
+            r->answered, seconds,
+            seconds > 0 ? r->answered / seconds : 0, r->errors);
+    printf("  latency us: p50 %llu, p90 %llu, p99 %llu, mean %llu, max %u\n",
+            (unsigned long long)ril_histogram_percentile(&r->latency, 50),
+            (unsigned long long)ril_histogram_percentile(&r->latency, 90),
+            (unsigned long long)ril_histogram_percentile(&r->latency, 99),
+            (unsigned long long)(r->latency.sumUs / answered),
+            r->latency.maxUs);
+    printf("  per request: %.2f allocations, %.2f syscalls\n",
+            r->counters.allocs / answered, r->counters.syscalls / answered);
+}
+
+// Ask libril for dumpStats() over the debug socket and copy it to stdout
+static void printLibrilStats(const char *debugPath)
+{
+    const char *command = DEBUG_DUMP_STATS;
+    int number = 1;
+    int len = strlen(command);
+    char buf[1024];
+    ssize_t n;
+    int fd;
+
+    fd = connectSocket(debugPath);
+    if (fd < 0) {
+        return;
+    }
+    if (writeAll(fd, &number, sizeof(number)) == 0
+            && writeAll(fd, &len, sizeof(len)) == 0
+            && writeAll(fd, command, len) == 0) {
+        while ((n = read(fd, buf, sizeof(buf))) > 0) {
+            fwrite(buf, 1, n, stdout);
+        }
+    }
+    close(fd);
+}
+
+int main(int argc, char **argv)
+{
+    static int sequence[MAX_SEQUENCE];
+    static const char *socketNames[] = {
+        "rild",
+#if (SIM_COUNT >= 2)
+        "rild2",
+#endif
+#if (SIM_COUNT >= 3)
+        "rild3",
+#endif
+#if (SIM_COUNT >= 4)
+        "rild4",
+#endif
+        "rild-debug",
+    };
+    char paths[NUM_ELEMS(socketNames)][PATH_MAX];
+    const RIL_RadioFunctions *funcs;
+    const char *radioLog = NULL;
+    uint32_t count = 100000;
+    uint32_t warmup = 1000;
+    uint32_t delayUs = 0;
+    bool dumpStats = false;
+    Client client;
+    RunResult result;
+    const char *tmp;
+    int ret;
+    int opt;
+
+    // this thread is the client; only libril's own work is counted
+    rilbench_exclude_thread();
+
+    memset(&client, 0, sizeof(client));
+    client.depth = 16;
+    client.nextToken = 1;
+
+    while ((opt = getopt(argc, argv, "n:p:d:w:r:s")) != -1) {
+        switch (opt) {
+            case 'n': count = strtoul(optarg, NULL, 0); break;
+            case 'p': client.depth = strtoul(optarg, NULL, 0); break;
+            case 'd': delayUs = strtoul(optarg, NULL, 0); break;
+            case 'w': warmup = strtoul(optarg, NULL, 0); break;
+            case 'r': radioLog = optarg; break;
+            case 's': dumpStats = true; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (count == 0 || client.depth == 0) {
+        usage(argv[0]);
+    }
+
+    client.sequence = sequence;
+    client.sequenceLen = radioLog != NULL
+            ? loadRadioLog(radioLog, sequence) : loadDefaultMix(sequence);
+    if (client.sequenceLen == 0) {
+        fprintf(stderr, "No requests to send\n");
+        return -1;
+    }
+
+    tmp = getenv("TMPDIR");
+    snprintf(s_socketDir, sizeof(s_socketDir), "%s/rilbench.XXXXXX",
+            tmp != NULL ? tmp : "/tmp");
+    if (mkdtemp(s_socketDir) == NULL) {
+        fprintf(stderr, "Could not create %s: %s\n", s_socketDir, strerror(errno));
+        return -1;
+    }
+    for (size_t i = 0; i < NUM_ELEMS(socketNames); i++) {
+        if (createControlSocket(socketNames[i], paths[i], sizeof(paths[i])) < 0) {
+            return -1;
+        }
+    }
+
+    funcs = loopback_ril_init(delayUs);
+    if (funcs == NULL) {
+        return -1;
+    }
+    RIL_startEventLoop();
+    RIL_register(funcs);
+
+    client.fd = connectSocket(paths[0]);
+    if (client.fd < 0) {
+        return -1;
+    }
+    // non-blocking, so a request libril never answers times out
+    fcntl(client.fd, F_SETFL, O_NONBLOCK);
+    client.rs = record_stream_new(client.fd, MAX_COMMAND_BYTES);
+
+    printf("rilbench: %s (%zu requests), depth %u, vendor delay %u us\n",
+            radioLog != NULL ? radioLog : "default mix", client.sequenceLen,
+            client.depth, delayUs);
+
+    ret = warmup > 0 ? runRequests(&client, warmup, &result) : 0;
+    if (ret == 0) {
+        ret = runRequests(&client, count, &result);
+        printResult(&result);
+    }
+
+    if (dumpStats) {
+        printLibrilStats(paths[NUM_ELEMS(socketNames) - 1]);
+    }
+
+    close(client.fd);
+    for (size_t i = 0; i < NUM_ELEMS(socketNames); i++) {
+        unlink(paths[i]);
+    }
+    rmdir(s_socketDir);
+
+    return ret == 0 ? 0 : 1;
+}
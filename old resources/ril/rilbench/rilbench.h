@@ -0,0 +1,38 @@
+/* //device/libs/telephony/rilbench/rilbench.h
+**
+** Copyright 2026, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#ifndef RILBENCH_H
+#define RILBENCH_H
+
+#include <stdint.h>
+#include <telephony/ril.h>
+
+// Vendor RIL that answers every request with RIL_E_SUCCESS and no payload,
+// from onRequest() when delayUs is 0 or from its own thread after delayUs.
+const RIL_RadioFunctions * loopback_ril_init(uint32_t delayUs);
+
+struct rilbench_counters {
+    uint64_t allocs;    // malloc, calloc, realloc and operator new calls
+    uint64_t syscalls;  // I/O system calls made through libc
+};
+
+// Leave the calling thread out of the counters, for the client side
+void rilbench_exclude_thread(void);
+
+void rilbench_get_counters(struct rilbench_counters * counters);
+
+#endif // RILBENCH_H
@@ -11,9 +11,11 @@ LOCAL_SHARED_LIBRARIES := \
 	liblog \
 	libcutils \
 	libril \
-	libdl
+	libdl \
+	libhardware_legacy
 
 # temporary hack for broken vendor rils
+# wake_lock.c in it needs libhardware_legacy, listed above
 LOCAL_WHOLE_STATIC_LIBRARIES := \
 	librilutils_static
 
@@ -76,6 +76,15 @@ static struct RIL_Env s_rilEnv = {
 
 extern void RIL_startEventLoop();
 
+extern void RIL_bootPhase(const char *phase) __attribute__((weak));
+
+static void bootPhase(const char *phase)
+{
+    if (RIL_bootPhase) {
+        RIL_bootPhase(phase);
+    }
+}
+
 static int make_argv(char * args, char ** argv)
 {
     // Note: reserve argv[0]
@@ -144,6 +153,7 @@ int main(int argc, char **argv)
     const char *clientId = NULL;
     RLOGD("**RIL Daemon Started**");
     RLOGD("**RILd param count=%d**", argc);
+    bootPhase("rild started");
 
     umask(S_IRGRP | S_IWGRP | S_IXGRP | S_IROTH | S_IWOTH | S_IXOTH);
     for (i = 1; i < argc ;) {
@@ -297,14 +307,18 @@ OpenLib:
 #endif
     switchUser();
 
+    // Listen on the RIL sockets before loading and initializing the vendor
+    // RIL, so the framework connects at once instead of retrying; libril
+    // holds its requests until RIL_register()
+    RIL_startEventLoop();
+
     dlHandle = dlopen(rilLibPath, RTLD_NOW);
 
     if (dlHandle == NULL) {
         RLOGE("dlopen failed: %s", dlerror());
         exit(EXIT_FAILURE);
     }
-
-    RIL_startEventLoop();
+    bootPhase("vendor library loaded");
 
     rilInit = (const RIL_RadioFunctions *(*)(const struct RIL_Env *, int, char **))dlsym(dlHandle, "RIL_Init");
 
@@ -335,6 +349,7 @@ OpenLib:
 
     funcs = rilInit(&s_rilEnv, argc, rilArgv);
     RLOGD("RIL_Init rilInit completed");
+    bootPhase("RIL_Init");
 
 #ifdef QCOM_HARDWARE
     if (funcs == NULL) {